@@ -0,0 +1,1081 @@
+/*
+    reliable
+
+    Copyright © 2017 - 2024, Mas Bandwidth LLC
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer 
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived 
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "reliable.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+#include <string.h>
+#include <assert.h>
+#include <inttypes.h>
+
+#if defined( _WIN32 )
+#include <windows.h>
+#else // #if defined( _WIN32 )
+#include <time.h>
+#endif // #if defined( _WIN32 )
+
+#if defined( __linux__ )
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <arpa/inet.h>
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif // #ifndef UDP_SEGMENT
+#endif // #if defined( __linux__ )
+
+static double bench_time()
+{
+#if defined( _WIN32 )
+    static LARGE_INTEGER frequency;
+    if ( frequency.QuadPart == 0 )
+        QueryPerformanceFrequency( &frequency );
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter( &counter );
+    return ( (double) counter.QuadPart ) / ( (double) frequency.QuadPart );
+#else // #if defined( _WIN32 )
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ( (double) ts.tv_nsec ) / 1000000000.0;
+#endif // #if defined( _WIN32 )
+}
+
+static int bench_process_packet( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) id;
+    (void) sequence;
+    (void) packet_data;
+    (void) packet_bytes;
+    uint64_t * num_packets_processed = (uint64_t*) context;
+    if ( num_packets_processed )
+    {
+        (*num_packets_processed)++;
+    }
+    return 1;
+}
+
+static void bench_transmit_packet_null( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) context;
+    (void) id;
+    (void) sequence;
+    (void) packet_data;
+    (void) packet_bytes;
+}
+
+// ---------------------------------------------------------------
+
+#if defined( __linux__ )
+
+#define BENCH_GSO_NUM_FRAGMENTS 16
+#define BENCH_GSO_FRAGMENT_SIZE 1024
+#define BENCH_GSO_NUM_PACKETS 10000
+
+struct bench_gso_context_t
+{
+    int send_socket;
+    uint64_t num_send_syscalls;
+};
+
+static void bench_gso_transmit_packet( void * _context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) id;
+    (void) sequence;
+    struct bench_gso_context_t * context = (struct bench_gso_context_t*) _context;
+    send( context->send_socket, packet_data, packet_bytes, 0 );
+    context->num_send_syscalls++;
+}
+
+static void bench_gso_transmit_packet_gso( void * _context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes, int segment_bytes )
+{
+    (void) id;
+    (void) sequence;
+
+    struct bench_gso_context_t * context = (struct bench_gso_context_t*) _context;
+
+    struct iovec iov;
+    iov.iov_base = packet_data;
+    iov.iov_len = packet_bytes;
+
+    char control[CMSG_SPACE(sizeof(uint16_t))];
+    memset( control, 0, sizeof( control ) );
+
+    struct msghdr msg;
+    memset( &msg, 0, sizeof( msg ) );
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof( control );
+
+    struct cmsghdr * cmsg = CMSG_FIRSTHDR( &msg );
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN( sizeof( uint16_t ) );
+    uint16_t segment_size = (uint16_t) segment_bytes;
+    memcpy( CMSG_DATA( cmsg ), &segment_size, sizeof( segment_size ) );
+
+    sendmsg( context->send_socket, &msg, 0 );
+    context->num_send_syscalls++;
+}
+
+static void bench_gso_drain( int receive_socket, struct reliable_endpoint_t * endpoint )
+{
+    uint8_t packet_data[BENCH_GSO_FRAGMENT_SIZE + RELIABLE_FRAGMENT_HEADER_BYTES + RELIABLE_MAX_PACKET_HEADER_BYTES];
+    while ( 1 )
+    {
+        ssize_t packet_bytes = recv( receive_socket, packet_data, sizeof( packet_data ), MSG_DONTWAIT );
+        if ( packet_bytes <= 0 )
+            break;
+        reliable_endpoint_receive_packet( endpoint, packet_data, (int) packet_bytes );
+    }
+}
+
+static void bench_gso_run( int gso )
+{
+    int receive_socket = socket( AF_INET, SOCK_DGRAM, 0 );
+    int send_socket = socket( AF_INET, SOCK_DGRAM, 0 );
+    assert( receive_socket >= 0 );
+    assert( send_socket >= 0 );
+
+    int buffer_size = 4 * 1024 * 1024;
+    setsockopt( receive_socket, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof( buffer_size ) );
+    setsockopt( send_socket, SOL_SOCKET, SO_SNDBUF, &buffer_size, sizeof( buffer_size ) );
+
+    struct sockaddr_in address;
+    memset( &address, 0, sizeof( address ) );
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    socklen_t address_length = sizeof( address );
+    if ( bind( receive_socket, (struct sockaddr*) &address, sizeof( address ) ) != 0 ||
+         getsockname( receive_socket, (struct sockaddr*) &address, &address_length ) != 0 ||
+         connect( send_socket, (struct sockaddr*) &address, sizeof( address ) ) != 0 )
+    {
+        printf( "    error: could not create loopback sockets (%s)\n", strerror( errno ) );
+        close( receive_socket );
+        close( send_socket );
+        return;
+    }
+
+    struct bench_gso_context_t context;
+    memset( &context, 0, sizeof( context ) );
+    context.send_socket = send_socket;
+
+    uint64_t num_packets_received = 0;
+
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.max_packet_size = BENCH_GSO_NUM_FRAGMENTS * BENCH_GSO_FRAGMENT_SIZE;
+    config.fragment_above = BENCH_GSO_FRAGMENT_SIZE;
+    config.fragment_size = BENCH_GSO_FRAGMENT_SIZE;
+    config.max_fragments = BENCH_GSO_NUM_FRAGMENTS;
+    config.process_packet_function = &bench_process_packet;
+
+    reliable_copy_string( config.name, "sender", sizeof( config.name ) );
+    config.context = &context;
+    config.transmit_packet_function = &bench_gso_transmit_packet;
+    config.transmit_packet_gso_function = gso ? &bench_gso_transmit_packet_gso : NULL;
+    struct reliable_endpoint_t * sender = reliable_endpoint_create( &config, 0.0 );
+
+    reliable_copy_string( config.name, "receiver", sizeof( config.name ) );
+    config.context = &num_packets_received;
+    config.transmit_packet_function = &bench_transmit_packet_null;
+    config.transmit_packet_gso_function = NULL;
+    struct reliable_endpoint_t * receiver = reliable_endpoint_create( &config, 0.0 );
+
+    static uint8_t packet_data[BENCH_GSO_NUM_FRAGMENTS * BENCH_GSO_FRAGMENT_SIZE];
+    memset( packet_data, 0, sizeof( packet_data ) );
+
+    double start_time = bench_time();
+
+    int i;
+    for ( i = 0; i < BENCH_GSO_NUM_PACKETS; ++i )
+    {
+        reliable_endpoint_send_packet( sender, packet_data, sizeof( packet_data ) );
+        bench_gso_drain( receive_socket, receiver );
+    }
+
+    double finish_time = bench_time();
+
+    bench_gso_drain( receive_socket, receiver );
+
+    RELIABLE_CONST uint64_t * counters = reliable_endpoint_counters( sender );
+
+    printf( "    %-8s %d packets, %" PRIu64 " fragments, %" PRIu64 " send syscalls (%.2f per packet), %" PRIu64 " packets received, %.2fus per packet\n",
+        gso ? "gso:" : "regular:",
+        BENCH_GSO_NUM_PACKETS,
+        counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT],
+        context.num_send_syscalls,
+        ( (double) context.num_send_syscalls ) / BENCH_GSO_NUM_PACKETS,
+        num_packets_received,
+        ( finish_time - start_time ) / BENCH_GSO_NUM_PACKETS * 1000000.0 );
+
+    reliable_endpoint_destroy( sender );
+    reliable_endpoint_destroy( receiver );
+
+    close( receive_socket );
+    close( send_socket );
+}
+
+static void bench_gso()
+{
+    bench_gso_run( 0 );
+    bench_gso_run( 1 );
+}
+
+#else // #if defined( __linux__ )
+
+static void bench_gso()
+{
+    printf( "    UDP GSO is only available on linux\n" );
+}
+
+#endif // #if defined( __linux__ )
+
+// ---------------------------------------------------------------
+
+#define BENCH_SEND_NUM_PACKETS 1000000
+#define BENCH_SEND_PACKET_BYTES 100
+
+struct bench_capture_context_t
+{
+    uint8_t packet_data[BENCH_SEND_PACKET_BYTES + RELIABLE_MAX_PACKET_HEADER_BYTES];
+    int packet_bytes;
+};
+
+static void bench_transmit_packet_capture( void * _context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) id;
+    (void) sequence;
+    struct bench_capture_context_t * context = (struct bench_capture_context_t*) _context;
+    memcpy( context->packet_data, packet_data, packet_bytes );
+    context->packet_bytes = packet_bytes;
+}
+
+static void bench_send()
+{
+    struct bench_capture_context_t capture;
+    memset( &capture, 0, sizeof( capture ) );
+
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.process_packet_function = &bench_process_packet;
+
+    reliable_copy_string( config.name, "peer", sizeof( config.name ) );
+    config.context = &capture;
+    config.transmit_packet_function = &bench_transmit_packet_capture;
+    struct reliable_endpoint_t * peer = reliable_endpoint_create( &config, 0.0 );
+
+    reliable_copy_string( config.name, "sender", sizeof( config.name ) );
+    config.context = NULL;
+    config.transmit_packet_function = &bench_transmit_packet_null;
+    struct reliable_endpoint_t * sender = reliable_endpoint_create( &config, 0.0 );
+
+    uint8_t packet_data[BENCH_SEND_PACKET_BYTES];
+    memset( packet_data, 0, sizeof( packet_data ) );
+
+    // fill the sender's received packets so the ack bits are non-trivial
+
+    int i;
+    for ( i = 0; i < 64; ++i )
+    {
+        reliable_endpoint_send_packet( peer, packet_data, sizeof( packet_data ) );
+        reliable_endpoint_receive_packet( sender, capture.packet_data, capture.packet_bytes );
+    }
+
+    // sends with no receives in between. ack and ack bits are generated once and reused
+
+    double start_time = bench_time();
+
+    for ( i = 0; i < BENCH_SEND_NUM_PACKETS; ++i )
+    {
+        reliable_endpoint_send_packet( sender, packet_data, sizeof( packet_data ) );
+    }
+
+    double send_time = bench_time() - start_time;
+
+    // a receive before every send, so ack and ack bits are regenerated for each send
+
+    double receive_time = 0.0;
+    double receive_send_time = 0.0;
+
+    for ( i = 0; i < BENCH_SEND_NUM_PACKETS; ++i )
+    {
+        reliable_endpoint_send_packet( peer, packet_data, sizeof( packet_data ) );
+
+        double t0 = bench_time();
+        reliable_endpoint_receive_packet( sender, capture.packet_data, capture.packet_bytes );
+        double t1 = bench_time();
+        reliable_endpoint_send_packet( sender, packet_data, sizeof( packet_data ) );
+        double t2 = bench_time();
+
+        receive_time += t1 - t0;
+        receive_send_time += t2 - t1;
+    }
+
+    printf( "    send:                %.1fns per send\n", send_time / BENCH_SEND_NUM_PACKETS * 1000000000.0 );
+    printf( "    send after receive:  %.1fns per send (receive %.1fns, includes timer overhead)\n", 
+        receive_send_time / BENCH_SEND_NUM_PACKETS * 1000000000.0, 
+        receive_time / BENCH_SEND_NUM_PACKETS * 1000000000.0 );
+
+    reliable_endpoint_destroy( peer );
+    reliable_endpoint_destroy( sender );
+}
+
+// ---------------------------------------------------------------
+
+#define BENCH_RECEIVE_BATCH_PACKETS 64
+#define BENCH_RECEIVE_NUM_BATCHES 20000
+
+struct bench_batch_capture_context_t
+{
+    int num_packets;
+    uint8_t packet_data[BENCH_RECEIVE_BATCH_PACKETS][BENCH_SEND_PACKET_BYTES + RELIABLE_MAX_PACKET_HEADER_BYTES];
+    uint8_t * packet_pointers[BENCH_RECEIVE_BATCH_PACKETS];
+    int packet_bytes[BENCH_RECEIVE_BATCH_PACKETS];
+};
+
+static void bench_transmit_packet_batch_capture( void * _context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) id;
+    (void) sequence;
+    struct bench_batch_capture_context_t * context = (struct bench_batch_capture_context_t*) _context;
+    assert( context->num_packets < BENCH_RECEIVE_BATCH_PACKETS );
+    memcpy( context->packet_data[context->num_packets], packet_data, packet_bytes );
+    context->packet_pointers[context->num_packets] = context->packet_data[context->num_packets];
+    context->packet_bytes[context->num_packets] = packet_bytes;
+    context->num_packets++;
+}
+
+static void bench_receive_run( int batch )
+{
+    static struct bench_batch_capture_context_t peer_capture;
+    static struct bench_batch_capture_context_t receiver_capture;
+    memset( &peer_capture, 0, sizeof( peer_capture ) );
+    memset( &receiver_capture, 0, sizeof( receiver_capture ) );
+
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.process_packet_function = &bench_process_packet;
+    config.transmit_packet_function = &bench_transmit_packet_batch_capture;
+
+    reliable_copy_string( config.name, "peer", sizeof( config.name ) );
+    config.context = &peer_capture;
+    struct reliable_endpoint_t * peer = reliable_endpoint_create( &config, 0.0 );
+
+    reliable_copy_string( config.name, "receiver", sizeof( config.name ) );
+    config.context = &receiver_capture;
+    struct reliable_endpoint_t * receiver = reliable_endpoint_create( &config, 0.0 );
+
+    uint8_t packet_data[BENCH_SEND_PACKET_BYTES];
+    memset( packet_data, 0, sizeof( packet_data ) );
+
+    double receive_time = 0.0;
+
+    double time = 0.0;
+
+    int i, j;
+    for ( i = 0; i < BENCH_RECEIVE_NUM_BATCHES; ++i )
+    {
+        // the receiver sends a burst to the peer, and the peer replies with a burst that acks it
+
+        receiver_capture.num_packets = 0;
+        for ( j = 0; j < BENCH_RECEIVE_BATCH_PACKETS; ++j )
+        {
+            reliable_endpoint_send_packet( receiver, packet_data, sizeof( packet_data ) );
+        }
+
+        reliable_endpoint_receive_packets( peer, receiver_capture.packet_pointers, receiver_capture.packet_bytes, receiver_capture.num_packets );
+
+        peer_capture.num_packets = 0;
+        for ( j = 0; j < BENCH_RECEIVE_BATCH_PACKETS; ++j )
+        {
+            reliable_endpoint_send_packet( peer, packet_data, sizeof( packet_data ) );
+        }
+
+        time += 0.01;
+        reliable_endpoint_update( receiver, time );
+        reliable_endpoint_update( peer, time );
+
+        double start_time = bench_time();
+
+        if ( batch )
+        {
+            reliable_endpoint_receive_packets( receiver, peer_capture.packet_pointers, peer_capture.packet_bytes, peer_capture.num_packets );
+        }
+        else
+        {
+            for ( j = 0; j < peer_capture.num_packets; ++j )
+            {
+                reliable_endpoint_receive_packet( receiver, peer_capture.packet_pointers[j], peer_capture.packet_bytes[j] );
+            }
+        }
+
+        receive_time += bench_time() - start_time;
+
+        reliable_endpoint_clear_acks( receiver );
+        reliable_endpoint_clear_acks( peer );
+    }
+
+    RELIABLE_CONST uint64_t * counters = reliable_endpoint_counters( receiver );
+
+    printf( "    %-8s %" PRIu64 " packets received, %" PRIu64 " acked, %.1fns per packet\n",
+        batch ? "batch:" : "single:",
+        counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED],
+        counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED],
+        receive_time / ( BENCH_RECEIVE_NUM_BATCHES * BENCH_RECEIVE_BATCH_PACKETS ) * 1000000000.0 );
+
+    reliable_endpoint_destroy( peer );
+    reliable_endpoint_destroy( receiver );
+}
+
+static void bench_receive()
+{
+    bench_receive_run( 0 );
+    bench_receive_run( 1 );
+}
+
+// ---------------------------------------------------------------
+
+#define BENCH_PEEK_NUM_ITERATIONS 200000
+
+static void bench_peek()
+{
+    // a burst of regular packets and fragments, as an io thread would see it before routing to endpoints
+
+    static struct bench_batch_capture_context_t capture;
+    memset( &capture, 0, sizeof( capture ) );
+
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.process_packet_function = &bench_process_packet;
+    config.transmit_packet_function = &bench_transmit_packet_batch_capture;
+    config.context = &capture;
+    config.fragment_above = BENCH_SEND_PACKET_BYTES / 2;
+    config.fragment_size = BENCH_SEND_PACKET_BYTES / 4;
+    struct reliable_endpoint_t * endpoint = reliable_endpoint_create( &config, 0.0 );
+
+    uint8_t packet_data[BENCH_SEND_PACKET_BYTES];
+    memset( packet_data, 0, sizeof( packet_data ) );
+
+    while ( capture.num_packets + 4 <= BENCH_RECEIVE_BATCH_PACKETS )
+    {
+        int packet_bytes = ( capture.num_packets % 3 ) == 0 ? BENCH_SEND_PACKET_BYTES : BENCH_SEND_PACKET_BYTES / 4;
+        reliable_endpoint_send_packet( endpoint, packet_data, packet_bytes );
+    }
+
+    uint64_t num_fragments = 0;
+    uint64_t num_invalid = 0;
+
+    double start_time = bench_time();
+
+    int i, j;
+    for ( i = 0; i < BENCH_PEEK_NUM_ITERATIONS; ++i )
+    {
+        for ( j = 0; j < capture.num_packets; ++j )
+        {
+            struct reliable_datagram_info_t info;
+            if ( reliable_peek_datagram( capture.packet_pointers[j], capture.packet_bytes[j], &info ) != RELIABLE_OK )
+            {
+                num_invalid++;
+                continue;
+            }
+            num_fragments += info.type == RELIABLE_DATAGRAM_FRAGMENT;
+        }
+    }
+
+    double peek_time = bench_time() - start_time;
+
+    uint64_t num_datagrams = (uint64_t) BENCH_PEEK_NUM_ITERATIONS * capture.num_packets;
+
+    printf( "    %" PRIu64 " datagrams peeked (%" PRIu64 " fragments, %" PRIu64 " invalid), %.1fns per datagram\n",
+        num_datagrams, num_fragments, num_invalid, peek_time / num_datagrams * 1000000000.0 );
+
+    reliable_endpoint_destroy( endpoint );
+}
+
+// ---------------------------------------------------------------
+
+#define BENCH_REASSEMBLY_NUM_PACKETS 100000
+#define BENCH_REASSEMBLY_NUM_FRAGMENTS 16
+#define BENCH_REASSEMBLY_FRAGMENT_SIZE 64
+
+struct bench_allocate_context_t
+{
+    uint64_t bytes_allocated;
+};
+
+static void * bench_allocate_function( void * _context, size_t bytes )
+{
+    struct bench_allocate_context_t * context = (struct bench_allocate_context_t*) _context;
+    context->bytes_allocated += bytes;
+    return malloc( bytes );
+}
+
+static void bench_free_function( void * context, void * pointer )
+{
+    (void) context;
+    free( pointer );
+}
+
+static uint64_t bench_endpoint_bytes( int fragment_reassembly_buffer_size )
+{
+    struct bench_allocate_context_t context;
+    memset( &context, 0, sizeof( context ) );
+
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.process_packet_function = &bench_process_packet;
+    config.transmit_packet_function = &bench_transmit_packet_null;
+    config.fragment_reassembly_buffer_size = fragment_reassembly_buffer_size;
+    config.allocator_context = &context;
+    config.allocate_function = &bench_allocate_function;
+    config.free_function = &bench_free_function;
+
+    struct reliable_endpoint_t * endpoint = reliable_endpoint_create( &config, 0.0 );
+    reliable_endpoint_destroy( endpoint );
+
+    return context.bytes_allocated;
+}
+
+static void bench_transmit_packet_receive( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) id;
+    (void) sequence;
+    reliable_endpoint_receive_packet( (struct reliable_endpoint_t*) context, packet_data, packet_bytes );
+}
+
+static void bench_reassembly()
+{
+    // the size of a reassembly entry is the difference in endpoint memory per extra entry in the reassembly buffer
+
+    uint64_t endpoint_bytes = bench_endpoint_bytes( 64 );
+    uint64_t entry_bytes = ( bench_endpoint_bytes( 65 ) - endpoint_bytes );
+
+    printf( "    endpoint: %" PRIu64 " bytes, reassembly entry: %" PRIu64 " bytes, reassembly table: %" PRIu64 " bytes\n",
+        endpoint_bytes, entry_bytes, entry_bytes * 64 );
+
+    uint64_t num_packets_processed = 0;
+
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.max_packet_size = BENCH_REASSEMBLY_NUM_FRAGMENTS * BENCH_REASSEMBLY_FRAGMENT_SIZE;
+    config.fragment_above = BENCH_REASSEMBLY_FRAGMENT_SIZE;
+    config.fragment_size = BENCH_REASSEMBLY_FRAGMENT_SIZE;
+    config.max_fragments = BENCH_REASSEMBLY_NUM_FRAGMENTS;
+    config.process_packet_function = &bench_process_packet;
+
+    reliable_copy_string( config.name, "receiver", sizeof( config.name ) );
+    config.context = &num_packets_processed;
+    config.transmit_packet_function = &bench_transmit_packet_null;
+    struct reliable_endpoint_t * receiver = reliable_endpoint_create( &config, 0.0 );
+
+    reliable_copy_string( config.name, "sender", sizeof( config.name ) );
+    config.context = receiver;
+    config.transmit_packet_function = &bench_transmit_packet_receive;
+    struct reliable_endpoint_t * sender = reliable_endpoint_create( &config, 0.0 );
+
+    uint8_t packet_data[BENCH_REASSEMBLY_NUM_FRAGMENTS * BENCH_REASSEMBLY_FRAGMENT_SIZE];
+    memset( packet_data, 0, sizeof( packet_data ) );
+
+    double start_time = bench_time();
+
+    int i;
+    for ( i = 0; i < BENCH_REASSEMBLY_NUM_PACKETS; ++i )
+    {
+        reliable_endpoint_send_packet( sender, packet_data, sizeof( packet_data ) );
+    }
+
+    double reassembly_time = bench_time() - start_time;
+
+    printf( "    %" PRIu64 " packets reassembled, %.1fns per fragment (includes send)\n",
+        num_packets_processed, reassembly_time / ( (double) BENCH_REASSEMBLY_NUM_PACKETS * BENCH_REASSEMBLY_NUM_FRAGMENTS ) * 1000000000.0 );
+
+    reliable_endpoint_destroy( sender );
+    reliable_endpoint_destroy( receiver );
+}
+
+// ---------------------------------------------------------------
+
+#define BENCH_SEQUENCE_NUM_PACKETS 20000
+#define BENCH_SEQUENCE_NUM_UPDATES 20000
+#define BENCH_SEQUENCE_NUM_REPEATS 9
+#define BENCH_SEQUENCE_NUM_SIZES 4
+
+struct bench_peer_context_t
+{
+    uint64_t num_packets_processed;             // first, so bench_process_packet can count through the same context
+    struct reliable_endpoint_t * peer;
+};
+
+static void bench_transmit_packet_peer( void * _context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) id;
+    (void) sequence;
+    struct bench_peer_context_t * context = (struct bench_peer_context_t*) _context;
+    reliable_endpoint_receive_packet( context->peer, packet_data, packet_bytes );
+}
+
+struct bench_sequence_pair_t
+{
+    struct bench_peer_context_t a_context;
+    struct bench_peer_context_t b_context;
+    struct reliable_endpoint_t * a;
+    struct reliable_endpoint_t * b;
+    double time;
+};
+
+static void bench_sequence_create( struct bench_sequence_pair_t * pair, int buffer_size )
+{
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.process_packet_function = &bench_process_packet;
+    config.transmit_packet_function = &bench_transmit_packet_peer;
+    config.sent_packets_buffer_size = buffer_size;
+    config.received_packets_buffer_size = buffer_size;
+
+    memset( pair, 0, sizeof( *pair ) );
+
+    reliable_copy_string( config.name, "a", sizeof( config.name ) );
+    config.context = &pair->a_context;
+    pair->a = reliable_endpoint_create( &config, 0.0 );
+
+    reliable_copy_string( config.name, "b", sizeof( config.name ) );
+    config.context = &pair->b_context;
+    pair->b = reliable_endpoint_create( &config, 0.0 );
+
+    pair->a_context.peer = pair->b;
+    pair->b_context.peer = pair->a;
+}
+
+static double bench_sequence_round_trips( struct bench_sequence_pair_t * pair, int num_packets )
+{
+    // ping pong between two endpoints with an update per packet, so send, receive, ack and the stats in update all hit the sequence buffers
+
+    uint8_t packet_data[BENCH_SEND_PACKET_BYTES];
+    memset( packet_data, 0, sizeof( packet_data ) );
+
+    double start_time = bench_time();
+
+    int i;
+    for ( i = 0; i < num_packets; ++i )
+    {
+        reliable_endpoint_send_packet( pair->a, packet_data, sizeof( packet_data ) );
+        reliable_endpoint_send_packet( pair->b, packet_data, sizeof( packet_data ) );
+
+        pair->time += 0.01;
+        reliable_endpoint_update( pair->a, pair->time );
+        reliable_endpoint_update( pair->b, pair->time );
+
+        reliable_endpoint_clear_acks( pair->a );
+        reliable_endpoint_clear_acks( pair->b );
+    }
+
+    return bench_time() - start_time;
+}
+
+static double bench_sequence_updates( struct bench_sequence_pair_t * pair )
+{
+    // the packet loss and bandwidth stats in update look up half of the sent and received buffers, so update time is mostly sequence buffer indexing
+
+    double start_time = bench_time();
+
+    int i;
+    for ( i = 0; i < BENCH_SEQUENCE_NUM_UPDATES; ++i )
+    {
+        reliable_endpoint_update( pair->a, pair->time );
+    }
+
+    return bench_time() - start_time;
+}
+
+static void bench_sequence()
+{
+    // power of two sizes index with a mask, the others with a modulo. runs are interleaved across sizes and the 
+    // best of each is reported, so a noisy neighbour or a frequency change doesn't land on one size only
+
+    static const int buffer_sizes[BENCH_SEQUENCE_NUM_SIZES] = { 256, 255, 1024, 1023 };
+
+    struct bench_sequence_pair_t pairs[BENCH_SEQUENCE_NUM_SIZES];
+
+    double best_round_trip_time[BENCH_SEQUENCE_NUM_SIZES];
+    double best_update_time[BENCH_SEQUENCE_NUM_SIZES];
+
+    int i;
+    for ( i = 0; i < BENCH_SEQUENCE_NUM_SIZES; ++i )
+    {
+        bench_sequence_create( &pairs[i], buffer_sizes[i] );
+        bench_sequence_round_trips( &pairs[i], buffer_sizes[i] * 2 );
+        best_round_trip_time[i] = 1.0e10;
+        best_update_time[i] = 1.0e10;
+    }
+
+    int repeat;
+    for ( repeat = 0; repeat < BENCH_SEQUENCE_NUM_REPEATS; ++repeat )
+    {
+        for ( i = 0; i < BENCH_SEQUENCE_NUM_SIZES; ++i )
+        {
+            double round_trip_time = bench_sequence_round_trips( &pairs[i], BENCH_SEQUENCE_NUM_PACKETS );
+            if ( round_trip_time < best_round_trip_time[i] )
+                best_round_trip_time[i] = round_trip_time;
+
+            double update_time = bench_sequence_updates( &pairs[i] );
+            if ( update_time < best_update_time[i] )
+                best_update_time[i] = update_time;
+        }
+    }
+
+    for ( i = 0; i < BENCH_SEQUENCE_NUM_SIZES; ++i )
+    {
+        int buffer_size = buffer_sizes[i];
+
+        // packet loss, sent bandwidth and received bandwidth each look up half a buffer
+
+        int lookups_per_update = 3 * ( buffer_size / 2 );
+
+        printf( "    %4d entries%s %.1fns per round trip, %.2fns per update lookup (best of %d)\n",
+            buffer_size,
+            ( buffer_size & ( buffer_size - 1 ) ) == 0 ? " (mask):  " : " (modulo):",
+            best_round_trip_time[i] / BENCH_SEQUENCE_NUM_PACKETS * 1000000000.0,
+            best_update_time[i] / ( (double) BENCH_SEQUENCE_NUM_UPDATES * lookups_per_update ) * 1000000000.0,
+            BENCH_SEQUENCE_NUM_REPEATS );
+
+        reliable_endpoint_destroy( pairs[i].a );
+        reliable_endpoint_destroy( pairs[i].b );
+    }
+}
+
+// ---------------------------------------------------------------
+
+#define BENCH_LAYOUT_NUM_ENDPOINTS 8192
+#define BENCH_LAYOUT_NUM_ROUNDS 64
+
+#if defined( __linux__ )
+
+static int bench_cache_misses_begin()
+{
+    // counts last level cache misses for this thread. not available in most vms, in which case only time is reported
+
+    struct perf_event_attr attr;
+    memset( &attr, 0, sizeof( attr ) );
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof( attr );
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int fd = (int) syscall( SYS_perf_event_open, &attr, 0, -1, -1, 0 );
+    if ( fd < 0 )
+        return -1;
+    ioctl( fd, PERF_EVENT_IOC_RESET, 0 );
+    ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 );
+    return fd;
+}
+
+static int64_t bench_cache_misses_end( int fd )
+{
+    if ( fd < 0 )
+        return -1;
+    uint64_t cache_misses = 0;
+    ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 );
+    if ( read( fd, &cache_misses, sizeof( cache_misses ) ) != sizeof( cache_misses ) )
+        cache_misses = 0;
+    close( fd );
+    return (int64_t) cache_misses;
+}
+
+#else // #if defined( __linux__ )
+
+static int bench_cache_misses_begin()
+{
+    return -1;
+}
+
+static int64_t bench_cache_misses_end( int fd )
+{
+    (void) fd;
+    return -1;
+}
+
+#endif // #if defined( __linux__ )
+
+static void bench_layout_run( int layout )
+{
+    // thousands of endpoints talking in pairs, round robin, so each packet finds its sent and received entries cold in cache
+
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.max_packet_size = 1024;
+    config.fragment_above = 1024;
+    config.process_packet_function = &bench_process_packet;
+    config.transmit_packet_function = &bench_transmit_packet_peer;
+    config.sent_packets_buffer_layout = layout;
+    config.received_packets_buffer_layout = layout;
+
+    struct bench_peer_context_t * contexts = (struct bench_peer_context_t*) calloc( BENCH_LAYOUT_NUM_ENDPOINTS, sizeof( struct bench_peer_context_t ) );
+    struct reliable_endpoint_t ** endpoints = (struct reliable_endpoint_t**) calloc( BENCH_LAYOUT_NUM_ENDPOINTS, sizeof( struct reliable_endpoint_t* ) );
+
+    int i, j;
+    for ( i = 0; i < BENCH_LAYOUT_NUM_ENDPOINTS; ++i )
+    {
+        config.context = &contexts[i];
+        endpoints[i] = reliable_endpoint_create( &config, 0.0 );
+    }
+
+    for ( i = 0; i < BENCH_LAYOUT_NUM_ENDPOINTS; ++i )
+    {
+        contexts[i].peer = endpoints[i^1];
+    }
+
+    uint8_t packet_data[BENCH_SEND_PACKET_BYTES];
+    memset( packet_data, 0, sizeof( packet_data ) );
+
+    // warm up so the sequence buffers are full
+
+    for ( j = 0; j < 256; ++j )
+    {
+        for ( i = 0; i < BENCH_LAYOUT_NUM_ENDPOINTS; ++i )
+        {
+            reliable_endpoint_send_packet( endpoints[i], packet_data, sizeof( packet_data ) );
+            reliable_endpoint_clear_acks( endpoints[i] );
+        }
+    }
+
+    int cache_misses_fd = bench_cache_misses_begin();
+
+    double start_time = bench_time();
+
+    for ( j = 0; j < BENCH_LAYOUT_NUM_ROUNDS; ++j )
+    {
+        for ( i = 0; i < BENCH_LAYOUT_NUM_ENDPOINTS; ++i )
+        {
+            reliable_endpoint_send_packet( endpoints[i], packet_data, sizeof( packet_data ) );
+            reliable_endpoint_clear_acks( endpoints[i] );
+        }
+    }
+
+    double layout_time = bench_time() - start_time;
+
+    int64_t cache_misses = bench_cache_misses_end( cache_misses_fd );
+
+    const uint64_t num_packets = (uint64_t) BENCH_LAYOUT_NUM_ENDPOINTS * BENCH_LAYOUT_NUM_ROUNDS;
+
+    if ( cache_misses >= 0 )
+    {
+        printf( "    %-12s %d endpoints, %.1fns per packet, %.2f cache misses per packet\n",
+            layout == RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED ? "interleaved:" : "separate:",
+            BENCH_LAYOUT_NUM_ENDPOINTS, layout_time / num_packets * 1000000000.0, (double) cache_misses / num_packets );
+    }
+    else
+    {
+        printf( "    %-12s %d endpoints, %.1fns per packet (cache miss counter not available)\n",
+            layout == RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED ? "interleaved:" : "separate:",
+            BENCH_LAYOUT_NUM_ENDPOINTS, layout_time / num_packets * 1000000000.0 );
+    }
+
+    for ( i = 0; i < BENCH_LAYOUT_NUM_ENDPOINTS; ++i )
+    {
+        reliable_endpoint_destroy( endpoints[i] );
+    }
+
+    free( endpoints );
+    free( contexts );
+}
+
+static void bench_layout()
+{
+    bench_layout_run( RELIABLE_SEQUENCE_BUFFER_LAYOUT_SEPARATE );
+    bench_layout_run( RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED );
+}
+
+// ---------------------------------------------------------------
+
+#define BENCH_ACK_ENCODING_NUM_PACKETS 100000
+
+struct bench_loss_t
+{
+    const char * name;
+    int percent;
+    int burst_length;
+};
+
+static void bench_ack_encoding_run( const char * name, int ack_window_bits, int ack_encoding, const struct bench_loss_t * loss )
+{
+    // the peer sends to the receiver over a lossy link, and the receiver replies to every packet.
+    // the reply is timed to cover encoding the header, and peeking it to cover decoding it. header sizes come from peek
+
+    struct bench_capture_context_t peer_capture;
+    struct bench_capture_context_t receiver_capture;
+    memset( &peer_capture, 0, sizeof( peer_capture ) );
+    memset( &receiver_capture, 0, sizeof( receiver_capture ) );
+
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.process_packet_function = &bench_process_packet;
+    config.transmit_packet_function = &bench_transmit_packet_capture;
+
+    reliable_copy_string( config.name, "peer", sizeof( config.name ) );
+    config.context = &peer_capture;
+    struct reliable_endpoint_t * peer = reliable_endpoint_create( &config, 0.0 );
+
+    reliable_copy_string( config.name, "receiver", sizeof( config.name ) );
+    config.context = &receiver_capture;
+    config.ack_window_bits = ack_window_bits;
+    config.ack_encoding = ack_encoding;
+    struct reliable_endpoint_t * receiver = reliable_endpoint_create( &config, 0.0 );
+
+    uint8_t packet_data[8];
+    memset( packet_data, 0, sizeof( packet_data ) );
+
+    uint64_t histogram[RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES+1];
+    memset( histogram, 0, sizeof( histogram ) );
+
+    uint64_t header_bytes = 0;
+    double send_time = 0.0;
+    double peek_time = 0.0;
+
+    uint32_t seed = 1;
+    int num_dropped = 0;
+
+    int i;
+    for ( i = 0; i < BENCH_ACK_ENCODING_NUM_PACKETS; ++i )
+    {
+        reliable_endpoint_send_packet( peer, packet_data, sizeof( packet_data ) );
+
+        seed = seed * 1664525 + 1013904223;
+        if ( num_dropped == 0 && (int) ( ( seed >> 8 ) % 1000 ) < loss->percent * 10 )
+        {
+            num_dropped = loss->burst_length;
+        }
+
+        if ( num_dropped > 0 )
+        {
+            num_dropped--;
+        }
+        else
+        {
+            reliable_endpoint_receive_packet( receiver, peer_capture.packet_data, peer_capture.packet_bytes );
+        }
+
+        double t0 = bench_time();
+        reliable_endpoint_send_packet( receiver, packet_data, sizeof( packet_data ) );
+        double t1 = bench_time();
+        struct reliable_datagram_info_t info;
+        int result = reliable_peek_datagram( receiver_capture.packet_data, receiver_capture.packet_bytes, &info );
+        double t2 = bench_time();
+
+        assert( result == RELIABLE_OK );
+        (void) result;
+
+        send_time += t1 - t0;
+        peek_time += t2 - t1;
+        header_bytes += info.header_bytes;
+        histogram[info.header_bytes]++;
+    }
+
+    printf( "    %-12s %-10s %5.2f header bytes, %.1fns per send, %.1fns per peek (includes timer overhead)\n",
+        name,
+        loss->name,
+        ( (double) header_bytes ) / BENCH_ACK_ENCODING_NUM_PACKETS,
+        send_time / BENCH_ACK_ENCODING_NUM_PACKETS * 1000000000.0,
+        peek_time / BENCH_ACK_ENCODING_NUM_PACKETS * 1000000000.0 );
+
+    printf( "                 " );
+
+    // header sizes that are at least 0.1% of headers
+
+    for ( i = 0; i <= RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES; ++i )
+    {
+        if ( histogram[i] * 1000 >= BENCH_ACK_ENCODING_NUM_PACKETS )
+        {
+            printf( " %d:%.1f%%", i, histogram[i] * 100.0 / BENCH_ACK_ENCODING_NUM_PACKETS );
+        }
+    }
+    printf( "\n" );
+
+    reliable_endpoint_destroy( peer );
+    reliable_endpoint_destroy( receiver );
+}
+
+static void bench_ack_encoding()
+{
+    static const struct bench_loss_t losses[] =
+    {
+        { "no loss", 0, 1 },
+        { "1% loss", 1, 1 },
+        { "5% loss", 5, 1 },
+        { "20% loss", 20, 1 },
+        { "1% bursts", 1, 20 },
+    };
+
+    int i;
+    for ( i = 0; i < (int) ( sizeof( losses ) / sizeof( losses[0] ) ); ++i )
+    {
+        bench_ack_encoding_run( "bitfield 32", 32, RELIABLE_ACK_ENCODING_BITFIELD, &losses[i] );
+        bench_ack_encoding_run( "bitfield 256", 256, RELIABLE_ACK_ENCODING_BITFIELD, &losses[i] );
+        bench_ack_encoding_run( "ranges 256", 256, RELIABLE_ACK_ENCODING_RANGES, &losses[i] );
+    }
+}
+
+// ---------------------------------------------------------------
+
+#define RUN_BENCH( bench_name, bench_function )                             \
+    do                                                                      \
+    {                                                                       \
+        if ( name == NULL || strcmp( name, bench_name ) == 0 )              \
+        {                                                                   \
+            printf( bench_name "\n" );                                      \
+            bench_function();                                               \
+        }                                                                   \
+    }                                                                       \
+    while (0)
+
+int main( int argc, char ** argv )
+{
+    const char * name = ( argc == 2 ) ? argv[1] : NULL;
+
+    printf( "\n[bench]\n\n" );
+
+    reliable_init();
+
+    RUN_BENCH( "send", bench_send );
+    RUN_BENCH( "receive", bench_receive );
+    RUN_BENCH( "peek", bench_peek );
+    RUN_BENCH( "reassembly", bench_reassembly );
+    RUN_BENCH( "sequence", bench_sequence );
+    RUN_BENCH( "layout", bench_layout );
+    RUN_BENCH( "ack_encoding", bench_ack_encoding );
+    RUN_BENCH( "gso", bench_gso );
+
+    reliable_term();
+
+    printf( "\n" );
+
+    return 0;
+}
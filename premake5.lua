@@ -35,6 +35,14 @@ project "stats"
 project "fuzz"
     files { "fuzz.c", "reliable.c" }
 
+project "bench"
+    files { "bench.c", "reliable.c" }
+
+if os.istarget "linux" then
+    project "socket"
+        files { "socket.c", "reliable_socket.c", "reliable.c" }
+end
+
 newaction
 {
     trigger     = "clean",
@@ -40,6 +40,46 @@
 #define RELIABLE_ENABLE_LOGGING 1
 #endif // #ifndef RELIABLE_ENABLE_LOGGING
 
+#if defined( __GNUC__ )
+#define reliable_prefetch( pointer ) __builtin_prefetch( pointer )
+#else // #if defined( __GNUC__ )
+#define reliable_prefetch( pointer ) ((void)0)
+#endif // #if defined( __GNUC__ )
+
+#if defined( _MSC_VER )
+#define RELIABLE_INLINE __inline
+#else // #if defined( _MSC_VER )
+#define RELIABLE_INLINE inline
+#endif // #if defined( _MSC_VER )
+
+int reliable_popcount64( uint64_t value )
+{
+#if defined( __GNUC__ )
+    return __builtin_popcountll( value );
+#else // #if defined( __GNUC__ )
+    value = value - ( ( value >> 1 ) & 0x5555555555555555ULL );
+    value = ( value & 0x3333333333333333ULL ) + ( ( value >> 2 ) & 0x3333333333333333ULL );
+    value = ( value + ( value >> 4 ) ) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int) ( ( value * 0x0101010101010101ULL ) >> 56 );
+#endif // #if defined( __GNUC__ )
+}
+
+int reliable_ctz64( uint64_t value )
+{
+    reliable_assert( value != 0 );
+#if defined( __GNUC__ )
+    return __builtin_ctzll( value );
+#else // #if defined( __GNUC__ )
+    int count = 0;
+    while ( ( value & 1 ) == 0 )
+    {
+        value >>= 1;
+        count++;
+    }
+    return count;
+#endif // #if defined( __GNUC__ )
+}
+
 // ------------------------------------------------------------------
 
 static void default_assert_handler( RELIABLE_CONST char * condition, RELIABLE_CONST char * function, RELIABLE_CONST char * file, int line )
@@ -143,18 +183,73 @@ struct reliable_sequence_buffer_t
     uint16_t sequence;
     int num_entries;
     int entry_stride;
+    int sequence_stride;
+    int layout;
+    uint32_t index_mask;
     uint32_t * entry_sequence;
     uint8_t * entry_data;
+    uint64_t * entry_occupied;
 };
 
+// interleaved entries are an 8 byte sequence tag followed by the entry data, padded to 8 bytes
+
+#define RELIABLE_SEQUENCE_BUFFER_TAG_BYTES 8
+
+#define RELIABLE_SEQUENCE_BUFFER_SLOT_BYTES( entry_bytes ) ( RELIABLE_SEQUENCE_BUFFER_TAG_BYTES + ( ( (entry_bytes) + 7 ) & ~7 ) )
+
+static RELIABLE_INLINE int reliable_sequence_buffer_index( struct reliable_sequence_buffer_t * sequence_buffer, uint16_t sequence )
+{
+    // power of two sizes index with a mask. other sizes fall back to modulo
+
+    return sequence_buffer->index_mask ? (int) ( sequence & sequence_buffer->index_mask ) : sequence % sequence_buffer->num_entries;
+}
+
+static RELIABLE_INLINE uint32_t * reliable_sequence_buffer_entry_sequence( struct reliable_sequence_buffer_t * sequence_buffer, int index )
+{
+    return (uint32_t*) ( ( (uint8_t*) sequence_buffer->entry_sequence ) + index * sequence_buffer->sequence_stride );
+}
+
+// the occupancy bitmap mirrors which entries hold a sequence, so cleanup only visits entries that need it
+
+static RELIABLE_INLINE void reliable_sequence_buffer_set_occupied( struct reliable_sequence_buffer_t * sequence_buffer, int index )
+{
+    sequence_buffer->entry_occupied[index >> 6] |= 1ULL << ( index & 63 );
+}
+
+static RELIABLE_INLINE void reliable_sequence_buffer_clear_occupied( struct reliable_sequence_buffer_t * sequence_buffer, int index )
+{
+    sequence_buffer->entry_occupied[index >> 6] &= ~( 1ULL << ( index & 63 ) );
+}
+
+void reliable_sequence_buffer_reset( struct reliable_sequence_buffer_t * sequence_buffer )
+{
+    reliable_assert( sequence_buffer );
+    sequence_buffer->sequence = 0;
+    memset( sequence_buffer->entry_occupied, 0, ( ( sequence_buffer->num_entries + 63 ) >> 6 ) * sizeof( uint64_t ) );
+    if ( sequence_buffer->layout == RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED )
+    {
+        int i;
+        for ( i = 0; i < sequence_buffer->num_entries; ++i )
+        {
+            *reliable_sequence_buffer_entry_sequence( sequence_buffer, i ) = 0xFFFFFFFF;
+        }
+    }
+    else
+    {
+        memset( sequence_buffer->entry_sequence, 0xFF, sizeof( uint32_t) * sequence_buffer->num_entries );
+    }
+}
+
 struct reliable_sequence_buffer_t * reliable_sequence_buffer_create( int num_entries, 
                                                                      int entry_stride, 
+                                                                     int layout, 
                                                                      void * allocator_context, 
                                                                      void * (*allocate_function)(void*,size_t), 
                                                                      void (*free_function)(void*,void*) )
 {
     reliable_assert( num_entries > 0 );
     reliable_assert( entry_stride > 0 );
+    reliable_assert( layout == RELIABLE_SEQUENCE_BUFFER_LAYOUT_SEPARATE || layout == RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED );
 
     if ( allocate_function == NULL )
     {
@@ -174,13 +269,37 @@ struct reliable_sequence_buffer_t * reliable_sequence_buffer_create( int num_ent
     sequence_buffer->free_function = free_function;
     sequence_buffer->sequence = 0;
     sequence_buffer->num_entries = num_entries;
-    sequence_buffer->entry_stride = entry_stride;
-    sequence_buffer->entry_sequence = (uint32_t*) allocate_function( allocator_context, num_entries * sizeof( uint32_t ) );
-    sequence_buffer->entry_data = (uint8_t*) allocate_function( allocator_context, num_entries * entry_stride );
-    reliable_assert( sequence_buffer->entry_sequence );
-    reliable_assert( sequence_buffer->entry_data );
-    memset( sequence_buffer->entry_sequence, 0xFF, sizeof( uint32_t) * sequence_buffer->num_entries );
-    memset( sequence_buffer->entry_data, 0, num_entries * entry_stride );
+    sequence_buffer->layout = layout;
+    sequence_buffer->index_mask = ( num_entries <= 65536 && ( num_entries & ( num_entries - 1 ) ) == 0 ) ? (uint32_t) ( num_entries - 1 ) : 0;
+
+    if ( layout == RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED )
+    {
+        // one array of slots, so finding an entry touches the tag and the data in the same cache line
+
+        int slot_bytes = RELIABLE_SEQUENCE_BUFFER_SLOT_BYTES( entry_stride );
+        uint8_t * slots = (uint8_t*) allocate_function( allocator_context, num_entries * slot_bytes );
+        reliable_assert( slots );
+        memset( slots, 0, num_entries * slot_bytes );
+        sequence_buffer->entry_stride = slot_bytes;
+        sequence_buffer->sequence_stride = slot_bytes;
+        sequence_buffer->entry_sequence = (uint32_t*) slots;
+        sequence_buffer->entry_data = slots + RELIABLE_SEQUENCE_BUFFER_TAG_BYTES;
+    }
+    else
+    {
+        sequence_buffer->entry_stride = entry_stride;
+        sequence_buffer->sequence_stride = sizeof( uint32_t );
+        sequence_buffer->entry_sequence = (uint32_t*) allocate_function( allocator_context, num_entries * sizeof( uint32_t ) );
+        sequence_buffer->entry_data = (uint8_t*) allocate_function( allocator_context, num_entries * entry_stride );
+        reliable_assert( sequence_buffer->entry_sequence );
+        reliable_assert( sequence_buffer->entry_data );
+        memset( sequence_buffer->entry_data, 0, num_entries * entry_stride );
+    }
+
+    sequence_buffer->entry_occupied = (uint64_t*) allocate_function( allocator_context, ( ( num_entries + 63 ) >> 6 ) * sizeof( uint64_t ) );
+    reliable_assert( sequence_buffer->entry_occupied );
+
+    reliable_sequence_buffer_reset( sequence_buffer );
 
     return sequence_buffer;
 }
@@ -189,15 +308,70 @@ void reliable_sequence_buffer_destroy( struct reliable_sequence_buffer_t * seque
 {
     reliable_assert( sequence_buffer );
     sequence_buffer->free_function( sequence_buffer->allocator_context, sequence_buffer->entry_sequence );
-    sequence_buffer->free_function( sequence_buffer->allocator_context, sequence_buffer->entry_data );
+    if ( sequence_buffer->layout != RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED )
+    {
+        sequence_buffer->free_function( sequence_buffer->allocator_context, sequence_buffer->entry_data );
+    }
+    sequence_buffer->free_function( sequence_buffer->allocator_context, sequence_buffer->entry_occupied );
     sequence_buffer->free_function( sequence_buffer->allocator_context, sequence_buffer );
 }
 
-void reliable_sequence_buffer_reset( struct reliable_sequence_buffer_t * sequence_buffer )
+void reliable_sequence_buffer_remove_range( struct reliable_sequence_buffer_t * sequence_buffer, 
+                                            int first_index, 
+                                            int num_indices, 
+                                            void (*cleanup_function)(void*,void*,void(*free_function)(void*,void*)) )
 {
     reliable_assert( sequence_buffer );
-    sequence_buffer->sequence = 0;
-    memset( sequence_buffer->entry_sequence, 0xFF, sizeof( uint32_t) * sequence_buffer->num_entries );
+    reliable_assert( first_index >= 0 );
+    reliable_assert( num_indices > 0 );
+    reliable_assert( first_index + num_indices <= sequence_buffer->num_entries );
+
+    int finish_index = first_index + num_indices - 1;
+    int first_word = first_index >> 6;
+    int finish_word = finish_index >> 6;
+
+    int word;
+    for ( word = first_word; word <= finish_word; ++word )
+    {
+        uint64_t mask = ~0ULL;
+        if ( word == first_word )
+        {
+            mask &= ~0ULL << ( first_index & 63 );
+        }
+        if ( word == finish_word )
+        {
+            mask &= ~0ULL >> ( 63 - ( finish_index & 63 ) );
+        }
+
+        uint64_t occupied = sequence_buffer->entry_occupied[word] & mask;
+
+        sequence_buffer->entry_occupied[word] &= ~mask;
+
+        if ( !cleanup_function )
+            continue;
+
+        while ( occupied )
+        {
+            int index = ( word << 6 ) + reliable_ctz64( occupied );
+            cleanup_function( sequence_buffer->entry_data + sequence_buffer->entry_stride * index, 
+                              sequence_buffer->allocator_context, 
+                              sequence_buffer->free_function );
+            occupied &= occupied - 1;
+        }
+    }
+
+    if ( sequence_buffer->layout == RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED )
+    {
+        int i;
+        for ( i = first_index; i <= finish_index; ++i )
+        {
+            *reliable_sequence_buffer_entry_sequence( sequence_buffer, i ) = 0xFFFFFFFF;
+        }
+    }
+    else
+    {
+        memset( sequence_buffer->entry_sequence + first_index, 0xFF, num_indices * sizeof( uint32_t ) );
+    }
 }
 
 void reliable_sequence_buffer_remove_entries( struct reliable_sequence_buffer_t * sequence_buffer, 
@@ -210,32 +384,36 @@ void reliable_sequence_buffer_remove_entries( struct reliable_sequence_buffer_t
     {
         finish_sequence += 65536;
     }
-    if ( finish_sequence - start_sequence < sequence_buffer->num_entries )
+    int num_sequences = finish_sequence - start_sequence + 1;
+    if ( num_sequences >= sequence_buffer->num_entries )
     {
-        int sequence;
-        for ( sequence = start_sequence; sequence <= finish_sequence; ++sequence )
+        reliable_sequence_buffer_remove_range( sequence_buffer, 0, sequence_buffer->num_entries, cleanup_function );
+    }
+    else if ( sequence_buffer->index_mask )
+    {
+        // with a power of two size the sequences map to at most two contiguous ranges of entries
+
+        int first_index = reliable_sequence_buffer_index( sequence_buffer, (uint16_t) start_sequence );
+        if ( first_index + num_sequences <= sequence_buffer->num_entries )
         {
-            if ( cleanup_function )
-            {
-                cleanup_function( sequence_buffer->entry_data + sequence_buffer->entry_stride * ( sequence % sequence_buffer->num_entries ), 
-                                  sequence_buffer->allocator_context, 
-                                  sequence_buffer->free_function );
-            }
-            sequence_buffer->entry_sequence[ sequence % sequence_buffer->num_entries ] = 0xFFFFFFFF;
+            reliable_sequence_buffer_remove_range( sequence_buffer, first_index, num_sequences, cleanup_function );
+        }
+        else
+        {
+            int num_head = sequence_buffer->num_entries - first_index;
+            reliable_sequence_buffer_remove_range( sequence_buffer, first_index, num_head, cleanup_function );
+            reliable_sequence_buffer_remove_range( sequence_buffer, 0, num_sequences - num_head, cleanup_function );
         }
     }
     else
     {
-        int i;
-        for ( i = 0; i < sequence_buffer->num_entries; ++i )
+        // other sizes don't wrap evenly at 65536, so remove one sequence at a time
+
+        int sequence;
+        for ( sequence = start_sequence; sequence <= finish_sequence; ++sequence )
         {
-            if ( cleanup_function )
-            {
-                cleanup_function( sequence_buffer->entry_data + sequence_buffer->entry_stride * i, 
-                                  sequence_buffer->allocator_context, 
-                                  sequence_buffer->free_function );
-            }
-            sequence_buffer->entry_sequence[i] = 0xFFFFFFFF;
+            int index = reliable_sequence_buffer_index( sequence_buffer, (uint16_t) sequence );
+            reliable_sequence_buffer_remove_range( sequence_buffer, index, 1, cleanup_function );
         }
     }
 }
@@ -257,8 +435,9 @@ void * reliable_sequence_buffer_insert( struct reliable_sequence_buffer_t * sequ
         reliable_sequence_buffer_remove_entries( sequence_buffer, sequence_buffer->sequence, sequence, NULL );
         sequence_buffer->sequence = sequence + 1;
     }
-    int index = sequence % sequence_buffer->num_entries;
-    sequence_buffer->entry_sequence[index] = sequence;
+    int index = reliable_sequence_buffer_index( sequence_buffer, sequence );
+    *reliable_sequence_buffer_entry_sequence( sequence_buffer, index ) = sequence;
+    reliable_sequence_buffer_set_occupied( sequence_buffer, index );
     return sequence_buffer->entry_data + index * sequence_buffer->entry_stride;
 }
 
@@ -286,14 +465,15 @@ void * reliable_sequence_buffer_insert_with_cleanup( struct reliable_sequence_bu
     {
         return NULL;
     }
-    int index = sequence % sequence_buffer->num_entries;
-    if ( sequence_buffer->entry_sequence[index] != 0xFFFFFFFF )
+    int index = reliable_sequence_buffer_index( sequence_buffer, sequence );
+    if ( *reliable_sequence_buffer_entry_sequence( sequence_buffer, index ) != 0xFFFFFFFF )
     {
-        cleanup_function( sequence_buffer->entry_data + sequence_buffer->entry_stride * ( sequence % sequence_buffer->num_entries ), 
+        cleanup_function( sequence_buffer->entry_data + sequence_buffer->entry_stride * index, 
                           sequence_buffer->allocator_context, 
                           sequence_buffer->free_function );
     }
-    sequence_buffer->entry_sequence[index] = sequence;
+    *reliable_sequence_buffer_entry_sequence( sequence_buffer, index ) = sequence;
+    reliable_sequence_buffer_set_occupied( sequence_buffer, index );
     return sequence_buffer->entry_data + index * sequence_buffer->entry_stride;
 }
 
@@ -312,7 +492,9 @@ void reliable_sequence_buffer_advance_with_cleanup( struct reliable_sequence_buf
 void reliable_sequence_buffer_remove( struct reliable_sequence_buffer_t * sequence_buffer, uint16_t sequence )
 {
     reliable_assert( sequence_buffer );
-    sequence_buffer->entry_sequence[ sequence % sequence_buffer->num_entries ] = 0xFFFFFFFF;
+    int index = reliable_sequence_buffer_index( sequence_buffer, sequence );
+    *reliable_sequence_buffer_entry_sequence( sequence_buffer, index ) = 0xFFFFFFFF;
+    reliable_sequence_buffer_clear_occupied( sequence_buffer, index );
 }
 
 void reliable_sequence_buffer_remove_with_cleanup( struct reliable_sequence_buffer_t * sequence_buffer, 
@@ -320,10 +502,11 @@ void reliable_sequence_buffer_remove_with_cleanup( struct reliable_sequence_buff
                                                    void (*cleanup_function)(void*,void*,void(*free_function)(void*,void*)) )
 {
     reliable_assert( sequence_buffer );
-    int index = sequence % sequence_buffer->num_entries;
-    if ( sequence_buffer->entry_sequence[index] != 0xFFFFFFFF )
+    int index = reliable_sequence_buffer_index( sequence_buffer, sequence );
+    if ( *reliable_sequence_buffer_entry_sequence( sequence_buffer, index ) != 0xFFFFFFFF )
     {
-        sequence_buffer->entry_sequence[index] = 0xFFFFFFFF;
+        *reliable_sequence_buffer_entry_sequence( sequence_buffer, index ) = 0xFFFFFFFF;
+        reliable_sequence_buffer_clear_occupied( sequence_buffer, index );
         cleanup_function( sequence_buffer->entry_data + sequence_buffer->entry_stride * index, sequence_buffer->allocator_context, sequence_buffer->free_function );
     }
 }
@@ -331,20 +514,20 @@ void reliable_sequence_buffer_remove_with_cleanup( struct reliable_sequence_buff
 int reliable_sequence_buffer_available( struct reliable_sequence_buffer_t * sequence_buffer, uint16_t sequence )
 {
     reliable_assert( sequence_buffer );
-    return sequence_buffer->entry_sequence[ sequence % sequence_buffer->num_entries ] == 0xFFFFFFFF;
+    return *reliable_sequence_buffer_entry_sequence( sequence_buffer, reliable_sequence_buffer_index( sequence_buffer, sequence ) ) == 0xFFFFFFFF;
 }
 
 int reliable_sequence_buffer_exists( struct reliable_sequence_buffer_t * sequence_buffer, uint16_t sequence )
 {
     reliable_assert( sequence_buffer );
-    return sequence_buffer->entry_sequence[ sequence % sequence_buffer->num_entries ] == (uint32_t) sequence;
+    return *reliable_sequence_buffer_entry_sequence( sequence_buffer, reliable_sequence_buffer_index( sequence_buffer, sequence ) ) == (uint32_t) sequence;
 }
 
 void * reliable_sequence_buffer_find( struct reliable_sequence_buffer_t * sequence_buffer, uint16_t sequence )
 {
     reliable_assert( sequence_buffer );
-    int index = sequence % sequence_buffer->num_entries;
-    return ( ( sequence_buffer->entry_sequence[index] == (uint32_t) sequence ) ) ? ( sequence_buffer->entry_data + index * sequence_buffer->entry_stride ) : NULL;
+    int index = reliable_sequence_buffer_index( sequence_buffer, sequence );
+    return ( ( *reliable_sequence_buffer_entry_sequence( sequence_buffer, index ) == (uint32_t) sequence ) ) ? ( sequence_buffer->entry_data + index * sequence_buffer->entry_stride ) : NULL;
 
 }
 
@@ -353,25 +536,7 @@ void * reliable_sequence_buffer_at_index( struct reliable_sequence_buffer_t * se
     reliable_assert( sequence_buffer );
     reliable_assert( index >= 0 );
     reliable_assert( index < sequence_buffer->num_entries );
-    return sequence_buffer->entry_sequence[index] != 0xFFFFFFFF ? ( sequence_buffer->entry_data + index * sequence_buffer->entry_stride ) : NULL;
-}
-
-void reliable_sequence_buffer_generate_ack_bits( struct reliable_sequence_buffer_t * sequence_buffer, uint16_t * ack, uint32_t * ack_bits )
-{
-    reliable_assert( sequence_buffer );
-    reliable_assert( ack );
-    reliable_assert( ack_bits );
-    *ack = sequence_buffer->sequence - 1;
-    *ack_bits = 0;
-    uint32_t mask = 1;
-    int i;
-    for ( i = 0; i < 32; ++i )
-    {
-        uint16_t sequence = *ack - ((uint16_t)i);
-        if ( reliable_sequence_buffer_exists( sequence_buffer, sequence ) )
-            *ack_bits |= mask;
-        mask <<= 1;
-    }
+    return *reliable_sequence_buffer_entry_sequence( sequence_buffer, index ) != 0xFFFFFFFF ? ( sequence_buffer->entry_data + index * sequence_buffer->entry_stride ) : NULL;
 }
 
 // ---------------------------------------------------------------
@@ -471,35 +636,215 @@ void reliable_read_bytes( uint8_t ** p, uint8_t * byte_array, int num_bytes )
     }
 }
 
+// varints are 7 bits per byte, low bits first, with the top bit set on every byte except the last
+
+int reliable_varint_bytes( uint32_t value )
+{
+    int bytes = 1;
+    while ( value >= 0x80 )
+    {
+        value >>= 7;
+        bytes++;
+    }
+    return bytes;
+}
+
+void reliable_write_varint( uint8_t ** p, uint32_t value )
+{
+    while ( value >= 0x80 )
+    {
+        reliable_write_uint8( p, (uint8_t) ( value | 0x80 ) );
+        value >>= 7;
+    }
+    reliable_write_uint8( p, (uint8_t) value );
+}
+
+int reliable_read_varint( uint8_t ** p, uint8_t * end, uint32_t * value )
+{
+    // returns 0 if the varint runs past the end of the buffer or doesn't fit in 32 bits
+
+    *value = 0;
+    int shift;
+    for ( shift = 0; shift < 32; shift += 7 )
+    {
+        if ( *p >= end )
+            return 0;
+        uint8_t byte = reliable_read_uint8( p );
+        *value |= ( (uint32_t) ( byte & 0x7F ) ) << shift;
+        if ( ( byte & 0x80 ) == 0 )
+            return 1;
+    }
+    return 0;
+}
+
 // ---------------------------------------------------------------
 
+struct reliable_fragment_pool_t
+{
+    void * allocator_context;
+    void * (*allocate_function)(void*,size_t);
+    void (*free_function)(void*,void*);
+    int buffer_bytes;
+    int max_bytes;
+    int bytes_in_use;
+    int max_free_buffers;
+    int num_free_buffers;
+    uint8_t ** free_buffers;
+};
+
+void reliable_fragment_pool_create( struct reliable_fragment_pool_t * pool, 
+                                    int buffer_bytes, 
+                                    int max_bytes, 
+                                    int max_free_buffers, 
+                                    void * allocator_context, 
+                                    void * (*allocate_function)(void*,size_t), 
+                                    void (*free_function)(void*,void*) )
+{
+    reliable_assert( pool );
+    reliable_assert( buffer_bytes > 0 );
+    reliable_assert( max_free_buffers >= 0 );
+
+    memset( pool, 0, sizeof( struct reliable_fragment_pool_t ) );
+
+    pool->allocator_context = allocator_context;
+    pool->allocate_function = allocate_function;
+    pool->free_function = free_function;
+    pool->buffer_bytes = buffer_bytes;
+    pool->max_bytes = max_bytes;
+    pool->max_free_buffers = max_free_buffers;
+
+    if ( max_free_buffers > 0 )
+    {
+        pool->free_buffers = (uint8_t**) allocate_function( allocator_context, max_free_buffers * sizeof( uint8_t* ) );
+    }
+}
+
+void reliable_fragment_pool_destroy( struct reliable_fragment_pool_t * pool )
+{
+    reliable_assert( pool );
+    reliable_assert( pool->bytes_in_use == 0 );
+
+    int i;
+    for ( i = 0; i < pool->num_free_buffers; ++i )
+    {
+        pool->free_function( pool->allocator_context, pool->free_buffers[i] );
+    }
+
+    if ( pool->free_buffers )
+    {
+        pool->free_function( pool->allocator_context, pool->free_buffers );
+    }
+
+    memset( pool, 0, sizeof( struct reliable_fragment_pool_t ) );
+}
+
+uint8_t * reliable_fragment_pool_allocate( struct reliable_fragment_pool_t * pool )
+{
+    // returns NULL if the buffer would take the pool over its byte cap
+
+    reliable_assert( pool );
+
+    if ( pool->max_bytes > 0 && pool->bytes_in_use + pool->buffer_bytes > pool->max_bytes )
+        return NULL;
+
+    uint8_t * buffer;
+    if ( pool->num_free_buffers > 0 )
+    {
+        buffer = pool->free_buffers[--pool->num_free_buffers];
+    }
+    else
+    {
+        buffer = (uint8_t*) pool->allocate_function( pool->allocator_context, pool->buffer_bytes );
+    }
+
+    pool->bytes_in_use += pool->buffer_bytes;
+
+    return buffer;
+}
+
+void reliable_fragment_pool_free( struct reliable_fragment_pool_t * pool, uint8_t * buffer )
+{
+    reliable_assert( pool );
+    reliable_assert( buffer );
+    reliable_assert( pool->bytes_in_use >= pool->buffer_bytes );
+
+    pool->bytes_in_use -= pool->buffer_bytes;
+
+    if ( pool->num_free_buffers < pool->max_free_buffers )
+    {
+        pool->free_buffers[pool->num_free_buffers++] = buffer;
+    }
+    else
+    {
+        pool->free_function( pool->allocator_context, buffer );
+    }
+}
+
+void reliable_fragment_pool_release( struct reliable_fragment_pool_t * pool, uint8_t * buffer )
+{
+    // the buffer leaves the pool. it was allocated with the pool allocator, so the owner frees it with the free function
+
+    reliable_assert( pool );
+    reliable_assert( buffer );
+    reliable_assert( pool->bytes_in_use >= pool->buffer_bytes );
+
+    (void) buffer;
+
+    pool->bytes_in_use -= pool->buffer_bytes;
+}
+
+#define RELIABLE_ACK_WINDOW_WORDS ( RELIABLE_MAX_ACK_WINDOW_BITS / 64 )
+
 struct reliable_fragment_reassembly_data_t
 {
-    uint16_t sequence;
-    uint16_t ack;
-    uint32_t ack_bits;
-    int num_fragments_received;
-    int num_fragments_total;
+    double time;
     uint8_t * packet_data;
+    struct reliable_fragment_pool_t * pool;
+    uint64_t fragment_received[4];
+    uint64_t ack_bits[RELIABLE_ACK_WINDOW_WORDS];
     int packet_bytes;
-    int packet_header_bytes;
-    uint8_t fragment_received[256];
+    uint16_t sequence;
+    uint16_t ack;
+    uint16_t num_fragments_total;
+    uint8_t packet_header_bytes;
 };
 
-void reliable_fragment_reassembly_data_cleanup( void * data, void * allocator_context, void (*free_function)(void*,void*) )
+int reliable_fragment_reassembly_num_fragments_received( struct reliable_fragment_reassembly_data_t * reassembly_data )
+{
+    // only the words that can hold fragments of this packet are counted
+
+    int num_words = ( reassembly_data->num_fragments_total + 63 ) >> 6;
+    int num_fragments_received = 0;
+    int i;
+    for ( i = 0; i < num_words; ++i )
+    {
+        num_fragments_received += reliable_popcount64( reassembly_data->fragment_received[i] );
+    }
+    return num_fragments_received;
+}
 
+void reliable_fragment_reassembly_data_cleanup( void * data, void * allocator_context, void (*free_function)(void*,void*) )
 {
-    reliable_assert( free_function );
+    // reassembly buffers go back to the endpoint's fragment pool, not to the sequence buffer allocator
+
+    (void) allocator_context;
+    (void) free_function;
     struct reliable_fragment_reassembly_data_t * reassembly_data = (struct reliable_fragment_reassembly_data_t*) data;
     if ( reassembly_data->packet_data )
     {
-        free_function( allocator_context, reassembly_data->packet_data );
+        reliable_fragment_pool_free( reassembly_data->pool, reassembly_data->packet_data );
         reassembly_data->packet_data = NULL;
     }
 }
 
 // ---------------------------------------------------------------
 
+struct reliable_queued_fragment_t
+{
+    uint16_t sequence;
+    int fragment_bytes;
+};
+
 struct reliable_endpoint_t
 {
     void * allocator_context;
@@ -518,6 +863,22 @@ struct reliable_endpoint_t
     struct reliable_sequence_buffer_t * sent_packets;
     struct reliable_sequence_buffer_t * received_packets;
     struct reliable_sequence_buffer_t * fragment_reassembly;
+    struct reliable_sequence_buffer_t * deferred_packets;
+    struct reliable_fragment_pool_t fragment_pool;
+    uint16_t ack;
+    uint64_t received_bits[RELIABLE_ACK_WINDOW_WORDS];
+    uint16_t applied_ack;
+    uint64_t applied_ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+    int max_packet_header_bytes;
+    uint8_t * gso_packet_data;
+    uint8_t * transmit_packet_data;
+    int transmit_packet_max_bytes;
+    struct reliable_queued_fragment_t * fragment_queue;
+    uint8_t * fragment_queue_data;
+    int fragment_queue_stride;
+    int fragment_queue_head;
+    int num_queued_fragments;
+    double fragment_pacing_budget;
     uint64_t counters[RELIABLE_ENDPOINT_NUM_COUNTERS];
 };
 
@@ -534,6 +895,46 @@ struct reliable_received_packet_data_t
     uint32_t packet_bytes;
 };
 
+struct reliable_deferred_packet_data_t
+{
+    double time;
+    uint16_t ack;
+    uint64_t ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+    int packet_bytes;
+};
+
+// typed finds for the endpoint's sequence buffers. only the entry size is a compile time constant here.
+// the index is still a runtime mask or modulo, and the layout is checked at runtime too. insert, exists
+// and remove stay on the generic path
+
+static RELIABLE_INLINE void * reliable_sequence_buffer_find_typed( struct reliable_sequence_buffer_t * sequence_buffer, uint16_t sequence, const int entry_bytes )
+{
+    int index = reliable_sequence_buffer_index( sequence_buffer, sequence );
+    if ( sequence_buffer->layout == RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED )
+    {
+        reliable_assert( sequence_buffer->entry_stride == RELIABLE_SEQUENCE_BUFFER_SLOT_BYTES( entry_bytes ) );
+        uint8_t * slot = ( (uint8_t*) sequence_buffer->entry_sequence ) + index * RELIABLE_SEQUENCE_BUFFER_SLOT_BYTES( entry_bytes );
+        return ( *( (uint32_t*) slot ) == (uint32_t) sequence ) ? slot + RELIABLE_SEQUENCE_BUFFER_TAG_BYTES : NULL;
+    }
+    reliable_assert( sequence_buffer->entry_stride == entry_bytes );
+    return ( sequence_buffer->entry_sequence[index] == (uint32_t) sequence ) ? sequence_buffer->entry_data + index * entry_bytes : NULL;
+}
+
+static RELIABLE_INLINE struct reliable_sent_packet_data_t * reliable_sent_packets_find( struct reliable_sequence_buffer_t * sent_packets, uint16_t sequence )
+{
+    return (struct reliable_sent_packet_data_t*) reliable_sequence_buffer_find_typed( sent_packets, sequence, sizeof( struct reliable_sent_packet_data_t ) );
+}
+
+static RELIABLE_INLINE struct reliable_received_packet_data_t * reliable_received_packets_find( struct reliable_sequence_buffer_t * received_packets, uint16_t sequence )
+{
+    return (struct reliable_received_packet_data_t*) reliable_sequence_buffer_find_typed( received_packets, sequence, sizeof( struct reliable_received_packet_data_t ) );
+}
+
+static RELIABLE_INLINE struct reliable_fragment_reassembly_data_t * reliable_fragment_reassembly_find( struct reliable_sequence_buffer_t * fragment_reassembly, uint16_t sequence )
+{
+    return (struct reliable_fragment_reassembly_data_t*) reliable_sequence_buffer_find_typed( fragment_reassembly, sequence, sizeof( struct reliable_fragment_reassembly_data_t ) );
+}
+
 void reliable_default_config( struct reliable_config_t * config )
 {
     reliable_assert( config );
@@ -552,13 +953,20 @@ void reliable_default_config( struct reliable_config_t * config )
     config->max_fragments = 16;
     config->fragment_size = 1024;
     config->ack_buffer_size = 256;
+    config->ack_window_bits = 32;
+    config->ack_encoding = RELIABLE_ACK_ENCODING_BITFIELD;
     config->sent_packets_buffer_size = 256;
     config->received_packets_buffer_size = 256;
+    config->sent_packets_buffer_layout = RELIABLE_SEQUENCE_BUFFER_LAYOUT_SEPARATE;
+    config->received_packets_buffer_layout = RELIABLE_SEQUENCE_BUFFER_LAYOUT_SEPARATE;
     config->fragment_reassembly_buffer_size = 64;
     config->rtt_smoothing_factor = 0.0025f;
     config->packet_loss_smoothing_factor = 0.1f;
     config->bandwidth_smoothing_factor = 0.1f;
     config->packet_header_size = 28;        // note: UDP over IPv4 = 20 + 8 bytes, UDP over IPv6 = 40 + 8 bytes
+    config->fragment_pacing_queue_size = 256;
+    config->fragment_reassembly_pool_size = 4;
+    config->fragment_reassembly_timeout = 0.0f;
 }
 
 struct reliable_endpoint_t * reliable_endpoint_create( struct reliable_config_t * config, double time )
@@ -570,9 +978,11 @@ struct reliable_endpoint_t * reliable_endpoint_create( struct reliable_config_t
     reliable_assert( config->max_fragments <= 256 );
     reliable_assert( config->fragment_size > 0 );
     reliable_assert( config->ack_buffer_size > 0 );
+    reliable_assert( config->ack_window_bits == 32 || config->ack_window_bits == 64 || config->ack_window_bits == 128 || config->ack_window_bits == 256 );
+    reliable_assert( config->ack_encoding == RELIABLE_ACK_ENCODING_BITFIELD || config->ack_encoding == RELIABLE_ACK_ENCODING_RANGES );
     reliable_assert( config->sent_packets_buffer_size > 0 );
     reliable_assert( config->received_packets_buffer_size > 0 );
-    reliable_assert( config->transmit_packet_function != NULL );
+    reliable_assert( config->transmit_packet_function != NULL || config->transmit_packet_iov_function != NULL );
     reliable_assert( config->process_packet_function != NULL );
 
     void * allocator_context = config->allocator_context;
@@ -601,27 +1011,69 @@ struct reliable_endpoint_t * reliable_endpoint_create( struct reliable_config_t
     endpoint->config = *config;
     endpoint->time = time;
 
-    endpoint->acks = (uint16_t*) allocate_function( allocator_context, config->ack_buffer_size * sizeof( uint16_t ) );
+    if ( config->ack_function == NULL )
+    {
+        endpoint->acks = (uint16_t*) allocate_function( allocator_context, config->ack_buffer_size * sizeof( uint16_t ) );
+        memset( endpoint->acks, 0, config->ack_buffer_size * sizeof( uint16_t ) );
+    }
     
     endpoint->sent_packets = reliable_sequence_buffer_create( config->sent_packets_buffer_size, 
                                                               sizeof( struct reliable_sent_packet_data_t ), 
+                                                              config->sent_packets_buffer_layout, 
                                                               allocator_context, 
                                                               allocate_function, 
                                                               free_function );
 
     endpoint->received_packets = reliable_sequence_buffer_create( config->received_packets_buffer_size, 
                                                                   sizeof( struct reliable_received_packet_data_t ), 
+                                                                  config->received_packets_buffer_layout, 
                                                                   allocator_context, 
                                                                   allocate_function, 
                                                                   free_function );
     
     endpoint->fragment_reassembly = reliable_sequence_buffer_create( config->fragment_reassembly_buffer_size, 
                                                                      sizeof( struct reliable_fragment_reassembly_data_t ), 
+                                                                     RELIABLE_SEQUENCE_BUFFER_LAYOUT_SEPARATE, 
                                                                      allocator_context, 
                                                                      allocate_function, 
                                                                      free_function );
 
-    memset( endpoint->acks, 0, config->ack_buffer_size * sizeof( uint16_t ) );
+    endpoint->deferred_packets = reliable_sequence_buffer_create( config->received_packets_buffer_size, 
+                                                                  sizeof( struct reliable_deferred_packet_data_t ), 
+                                                                  config->received_packets_buffer_layout, 
+                                                                  allocator_context, 
+                                                                  allocate_function, 
+                                                                  free_function );
+
+    reliable_fragment_pool_create( &endpoint->fragment_pool, 
+                                   config->max_fragments * config->fragment_size, 
+                                   config->fragment_reassembly_max_bytes, 
+                                   config->fragment_reassembly_pool_size, 
+                                   allocator_context, 
+                                   allocate_function, 
+                                   free_function );
+
+    endpoint->ack = 0xFFFF;
+
+    // buffers only reserve room for the header this endpoint writes, which depends on its ack window
+
+    endpoint->max_packet_header_bytes = RELIABLE_MAX_PACKET_HEADER_BYTES_FOR_ACK_WINDOW( config->ack_window_bits );
+
+    if ( config->fragment_pacing_kbps > 0.0f || config->fragment_pacing_bytes_per_rtt > 0 )
+    {
+        reliable_assert( config->fragment_pacing_queue_size > 0 );
+        endpoint->fragment_queue_stride = RELIABLE_FRAGMENT_HEADER_BYTES + endpoint->max_packet_header_bytes + config->fragment_size;
+        endpoint->fragment_queue = (struct reliable_queued_fragment_t*) allocate_function( allocator_context, config->fragment_pacing_queue_size * sizeof( struct reliable_queued_fragment_t ) );
+        endpoint->fragment_queue_data = (uint8_t*) allocate_function( allocator_context, config->fragment_pacing_queue_size * endpoint->fragment_queue_stride );
+        endpoint->fragment_pacing_budget = endpoint->fragment_queue_stride;
+    }
+
+    endpoint->transmit_packet_data = (uint8_t*) allocate_function( allocator_context, endpoint->max_packet_header_bytes + config->max_packet_size );
+
+    if ( config->transmit_packet_gso_function )
+    {
+        endpoint->gso_packet_data = (uint8_t*) allocate_function( allocator_context, endpoint->max_packet_header_bytes + config->max_fragments * ( RELIABLE_FRAGMENT_HEADER_BYTES + config->fragment_size ) );
+    }
 
     return endpoint;
 }
@@ -629,7 +1081,6 @@ struct reliable_endpoint_t * reliable_endpoint_create( struct reliable_config_t
 void reliable_endpoint_destroy( struct reliable_endpoint_t * endpoint )
 {
     reliable_assert( endpoint );
-    reliable_assert( endpoint->acks );
     reliable_assert( endpoint->sent_packets );
     reliable_assert( endpoint->received_packets );
 
@@ -641,16 +1092,35 @@ void reliable_endpoint_destroy( struct reliable_endpoint_t * endpoint )
 
         if ( reassembly_data && reassembly_data->packet_data )
         {
-            endpoint->free_function( endpoint->allocator_context, reassembly_data->packet_data );
+            reliable_fragment_pool_free( &endpoint->fragment_pool, reassembly_data->packet_data );
             reassembly_data->packet_data = NULL;
         }
     }
 
-    endpoint->free_function( endpoint->allocator_context, endpoint->acks );
+    if ( endpoint->acks )
+    {
+        endpoint->free_function( endpoint->allocator_context, endpoint->acks );
+    }
+
+    endpoint->free_function( endpoint->allocator_context, endpoint->transmit_packet_data );
+
+    if ( endpoint->gso_packet_data )
+    {
+        endpoint->free_function( endpoint->allocator_context, endpoint->gso_packet_data );
+    }
+
+    if ( endpoint->fragment_queue )
+    {
+        endpoint->free_function( endpoint->allocator_context, endpoint->fragment_queue );
+        endpoint->free_function( endpoint->allocator_context, endpoint->fragment_queue_data );
+    }
 
     reliable_sequence_buffer_destroy( endpoint->sent_packets );
     reliable_sequence_buffer_destroy( endpoint->received_packets );
     reliable_sequence_buffer_destroy( endpoint->fragment_reassembly );
+    reliable_sequence_buffer_destroy( endpoint->deferred_packets );
+
+    reliable_fragment_pool_destroy( &endpoint->fragment_pool );
 
     endpoint->free_function( endpoint->allocator_context, endpoint );
 }
@@ -661,6 +1131,10 @@ uint16_t reliable_endpoint_next_packet_sequence( struct reliable_endpoint_t * en
     return endpoint->sequence;
 }
 
+#define RELIABLE_PACKET_HEADER_ACK_BITS 0
+#define RELIABLE_PACKET_HEADER_ACK_WIDE 1
+#define RELIABLE_PACKET_HEADER_ACK_RANGES 2
+
 int reliable_write_packet_header( uint8_t * packet_data, uint16_t sequence, uint16_t ack, uint32_t ack_bits )
 {
     uint8_t * p = packet_data;
@@ -726,1109 +1200,5103 @@ int reliable_write_packet_header( uint8_t * packet_data, uint16_t sequence, uint
         reliable_write_uint8( &p, (uint8_t) ( ( ack_bits & 0xFF000000 ) >> 24 ) );
     }
 
-    reliable_assert( p - packet_data <= RELIABLE_MAX_PACKET_HEADER_BYTES );
+    reliable_assert( p - packet_data <= RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES );
 
     return (int) ( p - packet_data );
 }
 
-void reliable_endpoint_send_packet( struct reliable_endpoint_t * endpoint, uint8_t * packet_data, int packet_bytes )
+int reliable_write_packet_header_window( uint8_t * packet_data, uint16_t sequence, uint16_t ack, const uint64_t * ack_bits, int ack_window_bits )
 {
-    reliable_assert( endpoint );
-    reliable_assert( packet_data );
-    reliable_assert( packet_bytes > 0 );
-
-    if ( packet_bytes > endpoint->config.max_packet_size )
+    if ( ack_window_bits == 32 )
     {
-        reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] packet too large to send. packet is %d bytes, maximum is %d\n", 
-            endpoint->config.name, packet_bytes, endpoint->config.max_packet_size );
-        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_TOO_LARGE_TO_SEND]++;
-        return;
+        return reliable_write_packet_header( packet_data, sequence, ack, (uint32_t) ack_bits[0] );
     }
 
-    uint16_t sequence = endpoint->sequence++;
-    uint16_t ack;
-    uint32_t ack_bits;
+    // wide ack windows set bits 6-7 of the prefix byte to RELIABLE_PACKET_HEADER_ACK_WIDE, and bits 1-2 to the window size.
+    // each 64 bits of the window is written as a mask byte, followed by the bytes of ack bits that are not all ones
 
-    reliable_sequence_buffer_generate_ack_bits( endpoint->received_packets, &ack, &ack_bits );
+    reliable_assert( ack_window_bits == 64 || ack_window_bits == 128 || ack_window_bits == 256 );
 
-    reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] sending packet %d\n", endpoint->config.name, sequence );
+    int num_words = ack_window_bits / 64;
 
-    struct reliable_sent_packet_data_t * sent_packet_data = (struct reliable_sent_packet_data_t*) reliable_sequence_buffer_insert( endpoint->sent_packets, sequence );
+    uint8_t * p = packet_data;
 
-    reliable_assert( sent_packet_data );
+    uint8_t prefix_byte = ( RELIABLE_PACKET_HEADER_ACK_WIDE << 6 ) | ( ( num_words >> 1 ) << 1 );
 
-    sent_packet_data->time = endpoint->time;
-    sent_packet_data->packet_bytes = endpoint->config.packet_header_size + packet_bytes;
-    sent_packet_data->acked = 0;
+    int sequence_difference = sequence - ack;
+    if ( sequence_difference < 0 )
+        sequence_difference += 65536;
+    if ( sequence_difference <= 255 )
+        prefix_byte |= (1<<5);
 
-    if ( packet_bytes <= endpoint->config.fragment_above )
+    reliable_write_uint8( &p, prefix_byte );
+
+    reliable_write_uint16( &p, sequence );
+
+    if ( sequence_difference <= 255 )
     {
-        // regular packet
+        reliable_write_uint8( &p, (uint8_t) sequence_difference );
+    }
+    else
+    {
+        reliable_write_uint16( &p, ack );
+    }
 
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] sending packet %d without fragmentation\n", endpoint->config.name, sequence );
+    int i;
+    for ( i = 0; i < num_words; ++i )
+    {
+        uint8_t * mask = p++;
+        *mask = 0;
+        int j;
+        for ( j = 0; j < 8; ++j )
+        {
+            uint8_t value = (uint8_t) ( ack_bits[i] >> ( j * 8 ) );
+            if ( value != 0xFF )
+            {
+                *mask |= (uint8_t) ( 1 << j );
+                reliable_write_uint8( &p, value );
+            }
+        }
+    }
 
-        uint8_t * transmit_packet_data = (uint8_t*) endpoint->allocate_function( endpoint->allocator_context, packet_bytes + RELIABLE_MAX_PACKET_HEADER_BYTES );
+    reliable_assert( p - packet_data <= RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES );
 
-        int packet_header_bytes = reliable_write_packet_header( transmit_packet_data, sequence, ack, ack_bits );
+    return (int) ( p - packet_data );
+}
+
+int reliable_packet_header_window_bytes( uint16_t sequence, uint16_t ack, const uint64_t * ack_bits, int ack_window_bits )
+{
+    // the size of the header reliable_write_packet_header_window writes, without writing it
 
-        memcpy( transmit_packet_data + packet_header_bytes, packet_data, packet_bytes );
+    int sequence_difference = sequence - ack;
+    if ( sequence_difference < 0 )
+        sequence_difference += 65536;
 
-        endpoint->config.transmit_packet_function( endpoint->config.context, endpoint->config.id, sequence, transmit_packet_data, packet_header_bytes + packet_bytes );
+    int bytes = ( sequence_difference <= 255 ) ? 4 : 5;
 
-        endpoint->free_function( endpoint->allocator_context, transmit_packet_data );
+    int num_words = 1;
+    if ( ack_window_bits > 32 )
+    {
+        num_words = ack_window_bits / 64;
+        bytes += num_words;
     }
-    else
+
+    int i;
+    for ( i = 0; i < num_words; ++i )
     {
-        // fragmented packet
+        // one bit per byte that is not all ones
+
+        uint64_t value = ~ack_bits[i];
+        if ( ack_window_bits == 32 )
+            value &= 0xFFFFFFFFULL;
+        value |= value >> 4;
+        value |= value >> 2;
+        value |= value >> 1;
+        bytes += reliable_popcount64( value & 0x0101010101010101ULL );
+    }
+
+    return bytes;
+}
 
-        uint8_t packet_header[RELIABLE_MAX_PACKET_HEADER_BYTES];
+int reliable_ack_window_find( const uint64_t * window, int offset, int num_bits, int value )
+{
+    // returns the first bit at or after offset that is set when value is 1, or clear when value is 0. returns num_bits if there is none
+
+    while ( offset < num_bits )
+    {
+        uint64_t word = window[offset >> 6];
+        if ( !value )
+            word = ~word;
+        word >>= ( offset & 63 );
+        if ( word != 0 )
+        {
+            offset += reliable_ctz64( word );
+            return offset < num_bits ? offset : num_bits;
+        }
+        offset = ( offset | 63 ) + 1;
+    }
+    return num_bits;
+}
 
-        memset( packet_header, 0, RELIABLE_MAX_PACKET_HEADER_BYTES );
+void reliable_ack_window_set_range( uint64_t * window, int start, int end )
+{
+    while ( start < end )
+    {
+        int num_bits = 64 - ( start & 63 );
+        if ( num_bits > end - start )
+            num_bits = end - start;
+        uint64_t mask = ( num_bits == 64 ) ? ~0ULL : ( ( 1ULL << num_bits ) - 1 );
+        window[start >> 6] |= mask << ( start & 63 );
+        start += num_bits;
+    }
+}
 
-        int packet_header_bytes = reliable_write_packet_header( packet_header, sequence, ack, ack_bits );        
+#define RELIABLE_PACKET_HEADER_MAX_ACK_RANGES 15
 
-        int num_fragments = ( packet_bytes / endpoint->config.fragment_size ) + ( ( packet_bytes % endpoint->config.fragment_size ) != 0 ? 1 : 0 );
+int reliable_write_packet_header_ranges( uint8_t * packet_data, uint16_t sequence, uint16_t ack, const uint64_t * ack_bits, int ack_window_bits )
+{
+    // ack ranges set bits 6-7 of the prefix byte to RELIABLE_PACKET_HEADER_ACK_RANGES, and bits 1-4 to the number of ranges.
+    // each range of received packets, most recent first, is written as a varint gap since the end of the previous range and a varint length.
+    // if the ranges don't come out smaller than the ack bitfield, e.g. under scattered loss, the bitfield is written instead
 
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] sending packet %d as %d fragments\n", endpoint->config.name, sequence, num_fragments );
+    // count the ranges first, so heavy loss goes straight to the bitfield
 
-        reliable_assert( num_fragments >= 1 );
-        reliable_assert( num_fragments <= endpoint->config.max_fragments );
+    int num_words = ( ack_window_bits + 63 ) / 64;
+    int num_ranges = 0;
+    uint64_t carry = 0;
+    int i;
+    for ( i = 0; i < num_words; ++i )
+    {
+        uint64_t bits = ack_bits[i];
+        if ( ack_window_bits < 64 )
+            bits &= ( 1ULL << ack_window_bits ) - 1;
+        num_ranges += reliable_popcount64( bits & ~( ( bits << 1 ) | carry ) );
+        carry = bits >> 63;
+    }
 
-        int fragment_buffer_size = RELIABLE_FRAGMENT_HEADER_BYTES + RELIABLE_MAX_PACKET_HEADER_BYTES + endpoint->config.fragment_size;
+    if ( num_ranges > RELIABLE_PACKET_HEADER_MAX_ACK_RANGES )
+    {
+        return reliable_write_packet_header_window( packet_data, sequence, ack, ack_bits, ack_window_bits );
+    }
 
-        uint8_t * fragment_packet_data = (uint8_t*) endpoint->allocate_function( endpoint->allocator_context, fragment_buffer_size );
+    int max_bytes = reliable_packet_header_window_bytes( sequence, ack, ack_bits, ack_window_bits );
 
-        uint8_t * q = packet_data;
+    uint8_t * p = packet_data;
 
-        uint8_t * end = q + packet_bytes;
+    uint8_t prefix_byte = RELIABLE_PACKET_HEADER_ACK_RANGES << 6;
 
-        int fragment_id;
-        for ( fragment_id = 0; fragment_id < num_fragments; ++fragment_id )
-        {
-            uint8_t * p = fragment_packet_data;
+    int sequence_difference = sequence - ack;
+    if ( sequence_difference < 0 )
+        sequence_difference += 65536;
+    if ( sequence_difference <= 255 )
+        prefix_byte |= (1<<5);
 
-            reliable_write_uint8( &p, 1 );
-            reliable_write_uint16( &p, sequence );
-            reliable_write_uint8( &p, (uint8_t) fragment_id );
-            reliable_write_uint8( &p, (uint8_t) ( num_fragments - 1 ) );
+    reliable_write_uint8( &p, prefix_byte );
 
-            if ( fragment_id == 0 )
-            {
-                memcpy( p, packet_header, packet_header_bytes );
-                p += packet_header_bytes;
-            }
+    reliable_write_uint16( &p, sequence );
 
-            int bytes_to_copy = endpoint->config.fragment_size;
-            if ( q + bytes_to_copy > end )
-            {
-                bytes_to_copy = (int) ( end - q );
-            }
+    if ( sequence_difference <= 255 )
+    {
+        reliable_write_uint8( &p, (uint8_t) sequence_difference );
+    }
+    else
+    {
+        reliable_write_uint16( &p, ack );
+    }
 
-            memcpy( p, q, bytes_to_copy );
+    num_ranges = 0;
+    int range_end = 0;
 
-            p += bytes_to_copy;
-            q += bytes_to_copy;
+    while ( 1 )
+    {
+        int range_start = reliable_ack_window_find( ack_bits, range_end, ack_window_bits, 1 );
+        if ( range_start == ack_window_bits )
+            break;
 
-            int fragment_packet_bytes = (int) ( p - fragment_packet_data );
+        int next_range_end = reliable_ack_window_find( ack_bits, range_start, ack_window_bits, 0 );
 
-            endpoint->config.transmit_packet_function( endpoint->config.context, endpoint->config.id, sequence, fragment_packet_data, fragment_packet_bytes );
+        uint32_t gap = (uint32_t) ( range_start - range_end );
+        uint32_t length = (uint32_t) ( next_range_end - range_start );
 
-            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT]++;
+        if ( ( p - packet_data ) + reliable_varint_bytes( gap ) + reliable_varint_bytes( length ) >= max_bytes )
+        {
+            return reliable_write_packet_header_window( packet_data, sequence, ack, ack_bits, ack_window_bits );
         }
 
-        endpoint->free_function( endpoint->allocator_context, fragment_packet_data );
+        reliable_write_varint( &p, gap );
+        reliable_write_varint( &p, length );
+
+        num_ranges++;
+        range_end = next_range_end;
     }
 
-    endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_SENT]++;
+    packet_data[0] = prefix_byte | (uint8_t) ( num_ranges << 1 );
+
+    reliable_assert( p - packet_data < max_bytes );
+
+    return (int) ( p - packet_data );
 }
 
-int reliable_read_packet_header( RELIABLE_CONST char * name, uint8_t * packet_data, int packet_bytes, uint16_t * sequence, uint16_t * ack, uint32_t * ack_bits )
+int reliable_write_fragment_header( uint8_t * fragment_data, 
+                                    uint16_t sequence, 
+                                    int fragment_id, 
+                                    int num_fragments, 
+                                    uint8_t * packet_header, 
+                                    int packet_header_bytes )
 {
-    if ( packet_bytes < 3 )
+    uint8_t * p = fragment_data;
+
+    reliable_write_uint8( &p, 1 );
+    reliable_write_uint16( &p, sequence );
+    reliable_write_uint8( &p, (uint8_t) fragment_id );
+    reliable_write_uint8( &p, (uint8_t) ( num_fragments - 1 ) );
+
+    if ( fragment_id == 0 )
     {
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] packet too small for packet header (1)\n", name );
-        return -1;
+        memcpy( p, packet_header, packet_header_bytes );
+        p += packet_header_bytes;
     }
 
-    uint8_t * p = packet_data;
-
-    uint8_t prefix_byte = reliable_read_uint8( &p );
+    return (int) ( p - fragment_data );
+}
 
-    if ( ( prefix_byte & 1 ) != 0 )
+void reliable_endpoint_transmit_packet( struct reliable_endpoint_t * endpoint, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    if ( endpoint->config.transmit_packet_function )
     {
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] prefix byte does not indicate a regular packet\n", name );
-        return -1;
+        endpoint->config.transmit_packet_function( endpoint->config.context, endpoint->config.id, sequence, packet_data, packet_bytes );
+    }
+    else
+    {
+        struct reliable_iovec_t iov;
+        iov.data = packet_data;
+        iov.bytes = packet_bytes;
+        endpoint->config.transmit_packet_iov_function( endpoint->config.context, endpoint->config.id, sequence, &iov, 1 );
     }
+}
 
-    *sequence = reliable_read_uint16( &p );
+void reliable_ack_window_shift_up( uint64_t * window, int shift )
+{
+    reliable_assert( shift > 0 );
 
-    if ( prefix_byte & (1<<5) )
+    if ( shift < 64 )
     {
-        if ( packet_bytes < 3 + 1 )
+        // the common case, a few packets newer than the last one received
+
+        int i;
+        for ( i = RELIABLE_ACK_WINDOW_WORDS - 1; i > 0; --i )
         {
-            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] packet too small for packet header (2)\n", name );
-            return -1;
+            window[i] = ( window[i] << shift ) | ( window[i-1] >> ( 64 - shift ) );
         }
-        uint8_t sequence_difference = reliable_read_uint8( &p );
-        *ack = *sequence - sequence_difference;
+        window[0] <<= shift;
+        return;
     }
-    else
+
+    int word_shift = shift >> 6;
+    int bit_shift = shift & 63;
+
+    int i;
+    for ( i = RELIABLE_ACK_WINDOW_WORDS - 1; i >= 0; --i )
     {
-        if ( packet_bytes < 3 + 2 )
+        uint64_t value = 0;
+        int source = i - word_shift;
+        if ( source >= 0 )
         {
-            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] packet too small for packet header (3)\n", name );
-            return -1;
+            value = window[source] << bit_shift;
+            if ( bit_shift && source > 0 )
+            {
+                value |= window[source-1] >> ( 64 - bit_shift );
+            }
         }
-        *ack = reliable_read_uint16( &p );
+        window[i] = value;
     }
+}
+
+void reliable_ack_window_shift_down( uint64_t * window, int shift )
+{
+    reliable_assert( shift > 0 );
+
+    int word_shift = shift >> 6;
+    int bit_shift = shift & 63;
 
-    int expected_bytes = 0;
     int i;
-    for ( i = 1; i <= 4; ++i )
+    for ( i = 0; i < RELIABLE_ACK_WINDOW_WORDS; ++i )
     {
-        if ( prefix_byte & (1<<i) )
+        uint64_t value = 0;
+        int source = i + word_shift;
+        if ( source < RELIABLE_ACK_WINDOW_WORDS )
         {
-            expected_bytes++;
+            value = window[source] >> bit_shift;
+            if ( bit_shift && source + 1 < RELIABLE_ACK_WINDOW_WORDS )
+            {
+                value |= window[source+1] << ( 64 - bit_shift );
+            }
         }
+        window[i] = value;
     }
-    if ( packet_bytes < ( p - packet_data ) + expected_bytes )
-    {
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] packet too small for packet header (4)\n", name );
-        return -1;
-    }
+}
 
-    *ack_bits = 0xFFFFFFFF;
+void reliable_ack_window_or_shifted( uint64_t * window, const uint64_t * bits, int shift )
+{
+    // bits that would be shifted past the end of the window are dropped
 
-    if ( prefix_byte & (1<<1) )
+    uint64_t shifted[RELIABLE_ACK_WINDOW_WORDS];
+    memcpy( shifted, bits, sizeof( shifted ) );
+    if ( shift > 0 )
     {
-        *ack_bits &= 0xFFFFFF00;
-        *ack_bits |= (uint32_t) ( reliable_read_uint8( &p ) );
+        reliable_ack_window_shift_up( shifted, shift );
     }
-
-    if ( prefix_byte & (1<<2) )
+    int i;
+    for ( i = 0; i < RELIABLE_ACK_WINDOW_WORDS; ++i )
     {
-        *ack_bits &= 0xFFFF00FF;
-        *ack_bits |= (uint32_t) ( reliable_read_uint8( &p ) ) << 8;
+        window[i] |= shifted[i];
     }
+}
 
-    if ( prefix_byte & (1<<3) )
-    {
-        *ack_bits &= 0xFF00FFFF;
-        *ack_bits |= (uint32_t) ( reliable_read_uint8( &p ) ) << 16;
-    }
+int reliable_ack_window_fits( const uint64_t * window, int shift )
+{
+    // returns 1 if the window can be shifted up without dropping any set bits
 
-    if ( prefix_byte & (1<<4) )
+    if ( shift == 0 )
+        return 1;
+
+    int first_bit = shift < RELIABLE_MAX_ACK_WINDOW_BITS ? RELIABLE_MAX_ACK_WINDOW_BITS - shift : 0;
+    int i = first_bit >> 6;
+    if ( ( window[i] >> ( first_bit & 63 ) ) != 0 )
+        return 0;
+    for ( ++i; i < RELIABLE_ACK_WINDOW_WORDS; ++i )
     {
-        *ack_bits &= 0x00FFFFFF;
-        *ack_bits |= (uint32_t) ( reliable_read_uint8( &p ) ) << 24;
+        if ( window[i] != 0 )
+            return 0;
     }
-
-    return (int) ( p - packet_data );
+    return 1;
 }
 
-int reliable_read_fragment_header( char * name, 
-                                   uint8_t * packet_data, 
-                                   int packet_bytes, 
-                                   int max_fragments, 
-                                   int fragment_size, 
-                                   int * fragment_id, 
-                                   int * num_fragments, 
-                                   int * fragment_bytes, 
-                                   uint16_t * sequence, 
-                                   uint16_t * ack, 
-                                   uint32_t * ack_bits )
+int reliable_ack_window_empty( const uint64_t * window )
 {
-    if ( packet_bytes < RELIABLE_FRAGMENT_HEADER_BYTES )
+    uint64_t bits = 0;
+    int i;
+    for ( i = 0; i < RELIABLE_ACK_WINDOW_WORDS; ++i )
     {
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] packet is too small to read fragment header\n", name );
-        return -1;
+        bits |= window[i];
     }
+    return bits == 0;
+}
 
-    uint8_t * p = packet_data;
+void reliable_endpoint_update_received_bits( struct reliable_endpoint_t * endpoint, uint16_t sequence, int received )
+{
+    // the received bits are a shift register over the most recent sequences. bit n is set if packet ack - n was received.
+    // they follow the received packets buffer as it advances, so ack bits never have to be rebuilt by probing the buffer
 
-    uint8_t prefix_byte = reliable_read_uint8( &p );
-    if ( prefix_byte != 1 )
-    {
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] prefix byte is not a fragment\n", name );
-        return -1;
-    }
-    
-    *sequence = reliable_read_uint16( &p );
-    *fragment_id = (int) reliable_read_uint8( &p );
-    *num_fragments = ( (int) reliable_read_uint8( &p ) ) + 1;
+    uint16_t ack = endpoint->received_packets->sequence - 1;
 
-    if ( *num_fragments > max_fragments )
+    int shift = (uint16_t) ( ack - endpoint->ack );
+    if ( shift > 0 )
     {
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] num fragments %d outside of range of max fragments %d\n", name, *num_fragments, max_fragments );
-        return -1;
+        reliable_ack_window_shift_up( endpoint->received_bits, shift );
+        endpoint->ack = ack;
     }
 
-    if ( *fragment_id >= *num_fragments )
+    if ( received )
     {
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] fragment id %d outside of range of num fragments %d\n", name, *fragment_id, *num_fragments );
-        return -1;
+        int offset = (uint16_t) ( ack - sequence );
+        if ( offset < RELIABLE_MAX_ACK_WINDOW_BITS )
+        {
+            endpoint->received_bits[offset >> 6] |= 1ULL << ( offset & 63 );
+        }
     }
+}
 
-    *fragment_bytes = packet_bytes - RELIABLE_FRAGMENT_HEADER_BYTES;
-
-    uint16_t packet_sequence = 0;
-    uint16_t packet_ack = 0;
-    uint32_t packet_ack_bits = 0;
+int reliable_endpoint_has_received( struct reliable_endpoint_t * endpoint, uint16_t sequence )
+{
+    // recent sequences are answered by the received bits. older ones fall back to the received packets buffer
 
-    if ( *fragment_id == 0 )
-    {
-        int packet_header_bytes = reliable_read_packet_header( name, 
-                                                               packet_data + RELIABLE_FRAGMENT_HEADER_BYTES, 
-                                                               packet_bytes, 
-                                                               &packet_sequence, 
-                                                               &packet_ack, 
-                                                               &packet_ack_bits );
+    int offset = (uint16_t) ( endpoint->ack - sequence );
+    if ( offset < RELIABLE_MAX_ACK_WINDOW_BITS )
+        return ( endpoint->received_bits[offset >> 6] >> ( offset & 63 ) ) & 1;
+    return reliable_sequence_buffer_exists( endpoint->received_packets, sequence );
+}
 
-        if ( packet_header_bytes < 0 )
-        {
-            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] bad packet header in fragment\n", name );
-            return -1;
-        }
+void reliable_endpoint_generate_ack_bits( struct reliable_endpoint_t * endpoint, uint16_t * ack, uint64_t * ack_bits )
+{
+    *ack = endpoint->ack;
 
-        if ( packet_sequence != *sequence )
-        {
-            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] bad packet sequence in fragment. expected %d, got %d\n", name, *sequence, packet_sequence );
-            return -1;
-        }
+    // only the configured window is sent. packets older than the received packets buffer have been evicted from it, so they are not acked
 
-        *fragment_bytes = packet_bytes - packet_header_bytes - RELIABLE_FRAGMENT_HEADER_BYTES;
+    int num_bits = endpoint->config.ack_window_bits;
+    if ( endpoint->received_packets->num_entries < num_bits )
+    {
+        num_bits = endpoint->received_packets->num_entries;
     }
 
-    *ack = packet_ack;
-    *ack_bits = packet_ack_bits;
+    int num_words = num_bits >> 6;
 
-    if ( *fragment_bytes > fragment_size )
+    int i;
+    for ( i = 0; i < num_words; ++i )
     {
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] fragment bytes %d > fragment size %d\n", name, *fragment_bytes, fragment_size );
-        return - 1;
+        ack_bits[i] = endpoint->received_bits[i];
     }
 
-    if ( *fragment_id != *num_fragments - 1 && *fragment_bytes != fragment_size )
+    if ( num_bits & 63 )
     {
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] fragment %d is %d bytes, which is not the expected fragment size %d\n", 
-            name, *fragment_id, *fragment_bytes, fragment_size );
-        return -1;
+        ack_bits[i] = endpoint->received_bits[i] & ( ( 1ULL << ( num_bits & 63 ) ) - 1 );
+        i++;
     }
 
-    return (int) ( p - packet_data );
-}
-
-void reliable_store_fragment_data( struct reliable_fragment_reassembly_data_t * reassembly_data, 
-                                   uint16_t sequence, 
-                                   uint16_t ack, 
-                                   uint32_t ack_bits, 
-                                   int fragment_id, 
-                                   int fragment_size, 
-                                   uint8_t * fragment_data, 
-                                   int fragment_bytes )
-{
-    if ( fragment_id == 0 )
+    for ( ; i < RELIABLE_ACK_WINDOW_WORDS; ++i )
     {
-        uint8_t packet_header[RELIABLE_MAX_PACKET_HEADER_BYTES];
-
-        memset( packet_header, 0, RELIABLE_MAX_PACKET_HEADER_BYTES );
-
-        reassembly_data->packet_header_bytes = reliable_write_packet_header( packet_header, sequence, ack, ack_bits );
-
-        memcpy( reassembly_data->packet_data + RELIABLE_MAX_PACKET_HEADER_BYTES - reassembly_data->packet_header_bytes, 
-                packet_header, 
-                reassembly_data->packet_header_bytes );
-
-        fragment_data += reassembly_data->packet_header_bytes;
-        fragment_bytes -= reassembly_data->packet_header_bytes;
+        ack_bits[i] = 0;
     }
+}
 
-    if ( fragment_id == reassembly_data->num_fragments_total - 1 )
+int reliable_endpoint_write_packet_header( struct reliable_endpoint_t * endpoint, uint8_t * packet_data, uint16_t sequence, uint16_t ack, const uint64_t * ack_bits )
+{
+    if ( endpoint->config.ack_encoding == RELIABLE_ACK_ENCODING_RANGES )
     {
-        reassembly_data->packet_bytes = ( reassembly_data->num_fragments_total - 1 ) * fragment_size + fragment_bytes;
+        return reliable_write_packet_header_ranges( packet_data, sequence, ack, ack_bits, endpoint->config.ack_window_bits );
     }
-
-    memcpy( reassembly_data->packet_data + RELIABLE_MAX_PACKET_HEADER_BYTES + fragment_id * fragment_size, fragment_data, fragment_bytes );
+    return reliable_write_packet_header_window( packet_data, sequence, ack, ack_bits, endpoint->config.ack_window_bits );
 }
 
-void reliable_endpoint_receive_packet( struct reliable_endpoint_t * endpoint, uint8_t * packet_data, int packet_bytes )
+int reliable_endpoint_begin_send( struct reliable_endpoint_t * endpoint, int packet_bytes, uint16_t * sequence )
 {
     reliable_assert( endpoint );
-    reliable_assert( packet_data );
-    reliable_assert( packet_bytes > 0 );
+    reliable_assert( sequence );
 
-    if ( packet_bytes > endpoint->config.max_packet_size + RELIABLE_MAX_PACKET_HEADER_BYTES + RELIABLE_FRAGMENT_HEADER_BYTES )
+    if ( packet_bytes > endpoint->config.max_packet_size )
     {
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] packet too large to receive. packet is at least %d bytes, maximum is %d\n",
-            endpoint->config.name, packet_bytes - ( RELIABLE_MAX_PACKET_HEADER_BYTES + RELIABLE_FRAGMENT_HEADER_BYTES ), endpoint->config.max_packet_size );
-        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_TOO_LARGE_TO_RECEIVE]++;
-        return;
+        reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] packet too large to send. packet is %d bytes, maximum is %d\n", 
+            endpoint->config.name, packet_bytes, endpoint->config.max_packet_size );
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_TOO_LARGE_TO_SEND]++;
+        return 0;
     }
 
-    uint8_t prefix_byte = packet_data[0];
+    *sequence = endpoint->sequence++;
 
-    if ( ( prefix_byte & 1 ) == 0 )
-    {
-        // regular packet
+    reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] sending packet %d\n", endpoint->config.name, *sequence );
 
-        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED]++;
+    struct reliable_sent_packet_data_t * sent_packet_data = (struct reliable_sent_packet_data_t*) reliable_sequence_buffer_insert( endpoint->sent_packets, *sequence );
 
-        uint16_t sequence;
-        uint16_t ack;
-        uint32_t ack_bits;
+    reliable_assert( sent_packet_data );
 
-        int packet_header_bytes = reliable_read_packet_header( endpoint->config.name, packet_data, packet_bytes, &sequence, &ack, &ack_bits );
-        if ( packet_header_bytes < 0 )
-        {
-            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring invalid packet. could not read packet header\n", endpoint->config.name );
-            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_INVALID]++;
-            return;
-        }
+    sent_packet_data->time = endpoint->time;
+    sent_packet_data->packet_bytes = endpoint->config.packet_header_size + packet_bytes;
+    sent_packet_data->acked = 0;
 
-        reliable_assert( packet_header_bytes <= packet_bytes );
+    return 1;
+}
 
-        int packet_payload_bytes = packet_bytes - packet_header_bytes;
+int reliable_endpoint_num_fragments( struct reliable_endpoint_t * endpoint, int packet_bytes )
+{
+    int num_fragments = ( packet_bytes / endpoint->config.fragment_size ) + ( ( packet_bytes % endpoint->config.fragment_size ) != 0 ? 1 : 0 );
 
-        if ( packet_payload_bytes > endpoint->config.max_packet_size )
-        {
-            reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] packet too large to receive. packet is at %d bytes, maximum is %d\n",
-                endpoint->config.name, packet_payload_bytes, endpoint->config.max_packet_size );
-            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_TOO_LARGE_TO_RECEIVE]++;
-            return;
-        }
+    reliable_assert( num_fragments >= 1 );
+    reliable_assert( num_fragments <= endpoint->config.max_fragments );
 
-        if ( !reliable_sequence_buffer_test_insert( endpoint->received_packets, sequence ) )
-        {
-            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring stale packet %d\n", endpoint->config.name, sequence );
-            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_STALE]++;
-            return;
-        }
+    return num_fragments;
+}
 
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] processing packet %d\n", endpoint->config.name, sequence );
+void reliable_endpoint_release_fragment( struct reliable_endpoint_t * endpoint )
+{
+    reliable_assert( endpoint->num_queued_fragments > 0 );
 
-        if ( endpoint->config.process_packet_function( endpoint->config.context, 
-                                                       endpoint->config.id, 
-                                                       sequence, 
-                                                       packet_data + packet_header_bytes, 
-                                                       packet_bytes - packet_header_bytes ) )
-        {
-            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] process packet %d successful\n", endpoint->config.name, sequence );
+    struct reliable_queued_fragment_t * fragment = endpoint->fragment_queue + endpoint->fragment_queue_head;
 
-            struct reliable_received_packet_data_t * received_packet_data = (struct reliable_received_packet_data_t*) 
-                reliable_sequence_buffer_insert( endpoint->received_packets, sequence );
+    uint8_t * fragment_data = endpoint->fragment_queue_data + endpoint->fragment_queue_head * endpoint->fragment_queue_stride;
 
-            reliable_sequence_buffer_advance_with_cleanup( endpoint->fragment_reassembly, sequence, reliable_fragment_reassembly_data_cleanup );
+    reliable_endpoint_transmit_packet( endpoint, fragment->sequence, fragment_data, fragment->fragment_bytes );
 
-            reliable_assert( received_packet_data );
+    endpoint->fragment_pacing_budget -= fragment->fragment_bytes;
 
-            received_packet_data->time = endpoint->time;
-            received_packet_data->packet_bytes = endpoint->config.packet_header_size + packet_bytes;
+    endpoint->fragment_queue_head = ( endpoint->fragment_queue_head + 1 ) % endpoint->config.fragment_pacing_queue_size;
 
-            int i;
-            for ( i = 0; i < 32; ++i )
-            {
-                if ( ack_bits & 1 )
-                {                    
-                    uint16_t ack_sequence = ack - ((uint16_t)i);
-                    
-                    struct reliable_sent_packet_data_t * sent_packet_data = (struct reliable_sent_packet_data_t*) 
-                        reliable_sequence_buffer_find( endpoint->sent_packets, ack_sequence );
-
-                    if ( sent_packet_data && !sent_packet_data->acked && endpoint->num_acks < endpoint->config.ack_buffer_size )
-                    {
-                        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] acked packet %d\n", endpoint->config.name, ack_sequence );
-                        endpoint->acks[endpoint->num_acks++] = ack_sequence;
-                        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED]++;
-                        sent_packet_data->acked = 1;
-
-                        float rtt = (float) ( endpoint->time - sent_packet_data->time ) * 1000.0f;
-                        reliable_assert( rtt >= 0.0 );
-                        if ( ( endpoint->rtt == 0.0f && rtt > 0.0f ) || fabs( endpoint->rtt - rtt ) < 0.00001 )
-                        {
-                            endpoint->rtt = rtt;
-                        }
-                        else
-                        {
-                            endpoint->rtt += ( rtt - endpoint->rtt ) * endpoint->config.rtt_smoothing_factor;
-                        }
-                    }
-                }
-                ack_bits >>= 1;
-            }
-        }
-        else
+    endpoint->num_queued_fragments--;
+
+    endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT]++;
+}
+
+void reliable_endpoint_release_fragments( struct reliable_endpoint_t * endpoint )
+{
+    while ( endpoint->num_queued_fragments > 0 && endpoint->fragment_pacing_budget >= endpoint->fragment_queue[endpoint->fragment_queue_head].fragment_bytes )
+    {
+        reliable_endpoint_release_fragment( endpoint );
+    }
+}
+
+void reliable_endpoint_queue_fragment( struct reliable_endpoint_t * endpoint, 
+                                       uint16_t sequence, 
+                                       int fragment_id, 
+                                       int num_fragments, 
+                                       uint8_t * packet_header, 
+                                       int packet_header_bytes, 
+                                       uint8_t * fragment_data, 
+                                       int fragment_bytes )
+{
+    // if the queue is full, the oldest fragment goes out now. the budget goes negative, which delays the fragments after it
+
+    if ( endpoint->num_queued_fragments == endpoint->config.fragment_pacing_queue_size )
+    {
+        reliable_endpoint_release_fragment( endpoint );
+    }
+
+    int index = ( endpoint->fragment_queue_head + endpoint->num_queued_fragments ) % endpoint->config.fragment_pacing_queue_size;
+
+    uint8_t * p = endpoint->fragment_queue_data + index * endpoint->fragment_queue_stride;
+
+    int header_bytes = reliable_write_fragment_header( p, sequence, fragment_id, num_fragments, packet_header, packet_header_bytes );
+
+    memcpy( p + header_bytes, fragment_data, fragment_bytes );
+
+    endpoint->fragment_queue[index].sequence = sequence;
+    endpoint->fragment_queue[index].fragment_bytes = header_bytes + fragment_bytes;
+
+    endpoint->num_queued_fragments++;
+
+    endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_QUEUED]++;
+}
+
+void reliable_endpoint_update_fragment_pacing( struct reliable_endpoint_t * endpoint, double delta_time )
+{
+    double bytes_per_second;
+
+    if ( endpoint->config.fragment_pacing_kbps > 0.0f )
+    {
+        bytes_per_second = endpoint->config.fragment_pacing_kbps * 1000.0 / 8.0;
+    }
+    else
+    {
+        // until there is an rtt estimate, assume 100ms
+
+        double rtt = ( endpoint->rtt > 0.0f ) ? endpoint->rtt : 100.0;
+        if ( rtt < 1.0 )
         {
-            reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] process packet failed\n", endpoint->config.name );
+            rtt = 1.0;
         }
+        bytes_per_second = endpoint->config.fragment_pacing_bytes_per_rtt / ( rtt / 1000.0 );
     }
-    else
+
+    endpoint->fragment_pacing_budget += delta_time * bytes_per_second;
+
+    reliable_endpoint_release_fragments( endpoint );
+
+    // don't bank budget while idle, otherwise the next fragmented packet goes out as a burst
+
+    if ( endpoint->num_queued_fragments == 0 && endpoint->fragment_pacing_budget > endpoint->fragment_queue_stride )
     {
-        // fragment packet
+        endpoint->fragment_pacing_budget = endpoint->fragment_queue_stride;
+    }
+}
 
-        int fragment_id;
-        int num_fragments;
-        int fragment_bytes;
+void reliable_endpoint_send_fragments( struct reliable_endpoint_t * endpoint, 
+                                       uint16_t sequence, 
+                                       uint16_t ack, 
+                                       const uint64_t * ack_bits, 
+                                       uint8_t * packet_data, 
+                                       int packet_bytes )
+{
+    uint8_t packet_header[RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES];
 
-        uint16_t sequence;
-        uint16_t ack;
-        uint32_t ack_bits;
+    memset( packet_header, 0, sizeof( packet_header ) );
 
-        int fragment_header_bytes = reliable_read_fragment_header( endpoint->config.name, 
-                                                                   packet_data, 
-                                                                   packet_bytes, 
-                                                                   endpoint->config.max_fragments, 
-                                                                   endpoint->config.fragment_size,
-                                                                   &fragment_id, 
-                                                                   &num_fragments, 
-                                                                   &fragment_bytes, 
-                                                                   &sequence, 
-                                                                   &ack, 
-                                                                   &ack_bits );
+    int packet_header_bytes = reliable_endpoint_write_packet_header( endpoint, packet_header, sequence, ack, ack_bits );        
 
-        if ( fragment_header_bytes < 0 )
+    int num_fragments = reliable_endpoint_num_fragments( endpoint, packet_bytes );
+
+    reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] sending packet %d as %d fragments\n", endpoint->config.name, sequence, num_fragments );
+
+    uint8_t * q = packet_data;
+
+    uint8_t * end = q + packet_bytes;
+
+    if ( endpoint->fragment_queue )
+    {
+        // paced. fragments are queued and released by reliable_endpoint_update at the pacing rate
+
+        int fragment_id;
+        for ( fragment_id = 0; fragment_id < num_fragments; ++fragment_id )
         {
-            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring invalid fragment. could not read fragment header\n", endpoint->config.name );
-            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID]++;
-            return;
+            int fragment_bytes = ( q + endpoint->config.fragment_size > end ) ? (int) ( end - q ) : endpoint->config.fragment_size;
+
+            reliable_endpoint_queue_fragment( endpoint, sequence, fragment_id, num_fragments, packet_header, packet_header_bytes, q, fragment_bytes );
+
+            q += fragment_bytes;
         }
 
-        struct reliable_fragment_reassembly_data_t * reassembly_data = (struct reliable_fragment_reassembly_data_t*) 
-            reliable_sequence_buffer_find( endpoint->fragment_reassembly, sequence );
+        reliable_endpoint_release_fragments( endpoint );
 
-        if ( !reassembly_data )
-        {
-            reassembly_data = (struct reliable_fragment_reassembly_data_t*) 
-                reliable_sequence_buffer_insert_with_cleanup( endpoint->fragment_reassembly, sequence, reliable_fragment_reassembly_data_cleanup );
+        return;
+    }
 
-            if ( !reassembly_data )
-            {
-                reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] ignoring invalid fragment. could not insert in reassembly buffer (stale)\n", endpoint->config.name );
-                endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID]++;
-                return;
-            }
+    if ( endpoint->config.transmit_packet_gso_function )
+    {
+        // fragment 0 carries the packet header, so it is longer than the rest and goes out on its own. 
+        // the remaining fragments are laid out back to back at a fixed stride, so a UDP GSO socket can 
+        // send many of them with one syscall. only the last fragment may be shorter than the stride.
 
-            reliable_sequence_buffer_advance( endpoint->received_packets, sequence );
+        uint8_t * p = endpoint->gso_packet_data;
 
-            int packet_buffer_size = RELIABLE_MAX_PACKET_HEADER_BYTES + num_fragments * endpoint->config.fragment_size;
+        p += reliable_write_fragment_header( p, sequence, 0, num_fragments, packet_header, packet_header_bytes );
 
-            reassembly_data->sequence = sequence;
-            reassembly_data->ack = 0;
-            reassembly_data->ack_bits = 0;
-            reassembly_data->num_fragments_received = 0;
-            reassembly_data->num_fragments_total = num_fragments;
-            reassembly_data->packet_data = (uint8_t*) endpoint->allocate_function( endpoint->allocator_context, packet_buffer_size );
-            reassembly_data->packet_bytes = 0;
-            memset( reassembly_data->fragment_received, 0, sizeof( reassembly_data->fragment_received ) );
-        }
+        int fragment_bytes = ( q + endpoint->config.fragment_size > end ) ? (int) ( end - q ) : endpoint->config.fragment_size;
 
-        if ( num_fragments != (int) reassembly_data->num_fragments_total )
+        memcpy( p, q, fragment_bytes );
+
+        p += fragment_bytes;
+        q += fragment_bytes;
+
+        reliable_endpoint_transmit_packet( endpoint, sequence, endpoint->gso_packet_data, (int) ( p - endpoint->gso_packet_data ) );
+
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT]++;
+
+        // the kernel rejects UDP_SEGMENT sends over RELIABLE_MAX_GSO_SEGMENTS segments or RELIABLE_MAX_GSO_BYTES bytes, 
+        // so large packets are split across several calls
+
+        int segment_bytes = RELIABLE_FRAGMENT_HEADER_BYTES + endpoint->config.fragment_size;
+
+        int max_segments = RELIABLE_MAX_GSO_BYTES / segment_bytes;
+        if ( max_segments > RELIABLE_MAX_GSO_SEGMENTS )
         {
-            reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] ignoring invalid fragment. fragment count mismatch. expected %d, got %d\n", 
-                endpoint->config.name, (int) reassembly_data->num_fragments_total, num_fragments );
-            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID]++;
-            return;
+            max_segments = RELIABLE_MAX_GSO_SEGMENTS;
         }
-
-        if ( reassembly_data->fragment_received[fragment_id] )
+        if ( max_segments < 1 )
         {
-            reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] ignoring fragment %d of packet %d. fragment already received\n", 
-                endpoint->config.name, fragment_id, sequence );
-            return;
+            max_segments = 1;
         }
 
-        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] received fragment %d of packet %d (%d/%d)\n", 
-            endpoint->config.name, fragment_id, sequence, reassembly_data->num_fragments_received+1, num_fragments );
+        int fragment_id = 1;
+        while ( fragment_id < num_fragments )
+        {
+            uint8_t * gso_data = p;
 
-        reassembly_data->num_fragments_received++;
-        reassembly_data->fragment_received[fragment_id] = 1;
+            int num_segments = 0;
+            while ( fragment_id < num_fragments && num_segments < max_segments )
+            {
+                p += reliable_write_fragment_header( p, sequence, fragment_id, num_fragments, NULL, 0 );
 
-        reliable_store_fragment_data( reassembly_data, 
-                                      sequence, 
-                                      ack, 
-                                      ack_bits, 
-                                      fragment_id, 
-                                      endpoint->config.fragment_size, 
-                                      packet_data + fragment_header_bytes, 
-                                      packet_bytes - fragment_header_bytes );
+                fragment_bytes = ( q + endpoint->config.fragment_size > end ) ? (int) ( end - q ) : endpoint->config.fragment_size;
 
-        if ( reassembly_data->num_fragments_received == reassembly_data->num_fragments_total )
-        {
-            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] completed reassembly of packet %d\n", endpoint->config.name, sequence );
+                memcpy( p, q, fragment_bytes );
 
-            reliable_endpoint_receive_packet( endpoint, 
-                                              reassembly_data->packet_data + RELIABLE_MAX_PACKET_HEADER_BYTES - reassembly_data->packet_header_bytes, 
-                                              reassembly_data->packet_header_bytes + reassembly_data->packet_bytes );
+                p += fragment_bytes;
+                q += fragment_bytes;
 
-            reliable_sequence_buffer_remove_with_cleanup( endpoint->fragment_reassembly, sequence, reliable_fragment_reassembly_data_cleanup );
+                fragment_id++;
+                num_segments++;
+            }
+
+            endpoint->config.transmit_packet_gso_function( endpoint->config.context, 
+                                                           endpoint->config.id, 
+                                                           sequence, 
+                                                           gso_data, 
+                                                           (int) ( p - gso_data ), 
+                                                           segment_bytes );
+
+            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT] += num_segments;
         }
 
-        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_RECEIVED]++;
+        return;
     }
-}
 
-void reliable_endpoint_free_packet( struct reliable_endpoint_t * endpoint, void * packet )
-{
-    reliable_assert( endpoint );
-    reliable_assert( packet );
-    endpoint->free_function( endpoint->allocator_context, packet );
-}
+    if ( endpoint->config.transmit_packet_iov_function )
+    {
+        // gather each fragment from a small header chunk and a pointer into the packet data, without copying the payload
 
-uint16_t * reliable_endpoint_get_acks( struct reliable_endpoint_t * endpoint, int * num_acks )
-{
-    reliable_assert( endpoint );
-    reliable_assert( num_acks );
-    *num_acks = endpoint->num_acks;
-    return endpoint->acks;
-}
+        uint8_t fragment_header[RELIABLE_FRAGMENT_HEADER_BYTES + RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES];
 
-void reliable_endpoint_clear_acks( struct reliable_endpoint_t * endpoint )
-{
-    reliable_assert( endpoint );
-    endpoint->num_acks = 0;
-}
+        int fragment_id;
+        for ( fragment_id = 0; fragment_id < num_fragments; ++fragment_id )
+        {
+            int fragment_bytes = endpoint->config.fragment_size;
+            if ( q + fragment_bytes > end )
+            {
+                fragment_bytes = (int) ( end - q );
+            }
 
-void reliable_endpoint_reset( struct reliable_endpoint_t * endpoint )
-{
-    reliable_assert( endpoint );
+            struct reliable_iovec_t iov[2];
+            iov[0].data = fragment_header;
+            iov[0].bytes = reliable_write_fragment_header( fragment_header, sequence, fragment_id, num_fragments, packet_header, packet_header_bytes );
+            iov[1].data = q;
+            iov[1].bytes = fragment_bytes;
 
-    endpoint->num_acks = 0;
-    endpoint->sequence = 0;
+            q += fragment_bytes;
 
-    memset( endpoint->acks, 0, endpoint->config.ack_buffer_size * sizeof( uint16_t ) );
-    memset( endpoint->counters, 0, RELIABLE_ENDPOINT_NUM_COUNTERS * sizeof( uint64_t ) );
+            endpoint->config.transmit_packet_iov_function( endpoint->config.context, endpoint->config.id, sequence, iov, 2 );
 
-    int i;
-    for ( i = 0; i < endpoint->config.fragment_reassembly_buffer_size; ++i )
+            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT]++;
+        }
+
+        return;
+    }
+
+    int fragment_buffer_size = RELIABLE_FRAGMENT_HEADER_BYTES + endpoint->max_packet_header_bytes + endpoint->config.fragment_size;
+
+    uint8_t * fragment_packet_data = (uint8_t*) endpoint->allocate_function( endpoint->allocator_context, fragment_buffer_size );
+
+    int fragment_id;
+    for ( fragment_id = 0; fragment_id < num_fragments; ++fragment_id )
     {
-        struct reliable_fragment_reassembly_data_t * reassembly_data = (struct reliable_fragment_reassembly_data_t*) 
-            reliable_sequence_buffer_at_index( endpoint->fragment_reassembly, i );
+        uint8_t * p = fragment_packet_data;
 
-        if ( reassembly_data && reassembly_data->packet_data )
+        p += reliable_write_fragment_header( p, sequence, fragment_id, num_fragments, packet_header, packet_header_bytes );
+
+        int bytes_to_copy = endpoint->config.fragment_size;
+        if ( q + bytes_to_copy > end )
         {
-            endpoint->free_function( endpoint->allocator_context, reassembly_data->packet_data );
-            reassembly_data->packet_data = NULL;
+            bytes_to_copy = (int) ( end - q );
         }
+
+        memcpy( p, q, bytes_to_copy );
+
+        p += bytes_to_copy;
+        q += bytes_to_copy;
+
+        int fragment_packet_bytes = (int) ( p - fragment_packet_data );
+
+        endpoint->config.transmit_packet_function( endpoint->config.context, endpoint->config.id, sequence, fragment_packet_data, fragment_packet_bytes );
+
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT]++;
     }
 
-    reliable_sequence_buffer_reset( endpoint->sent_packets );
-    reliable_sequence_buffer_reset( endpoint->received_packets );
-    reliable_sequence_buffer_reset( endpoint->fragment_reassembly );
+    endpoint->free_function( endpoint->allocator_context, fragment_packet_data );
 }
 
-void reliable_endpoint_update( struct reliable_endpoint_t * endpoint, double time )
+void reliable_endpoint_send_packet( struct reliable_endpoint_t * endpoint, uint8_t * packet_data, int packet_bytes )
 {
     reliable_assert( endpoint );
+    reliable_assert( packet_data );
+    reliable_assert( packet_bytes > 0 );
 
-    endpoint->time = time;
-    
-    // calculate packet loss
+    uint16_t sequence;
+    uint16_t ack;
+    uint64_t ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+
+    if ( !reliable_endpoint_begin_send( endpoint, packet_bytes, &sequence ) )
+        return;
+
+    reliable_endpoint_generate_ack_bits( endpoint, &ack, ack_bits );
+
+    if ( packet_bytes <= endpoint->config.fragment_above )
     {
-        uint32_t base_sequence = ( endpoint->sent_packets->sequence - endpoint->config.sent_packets_buffer_size + 1 ) + 0xFFFF;
-        int i;
-        int num_dropped = 0;
-        int num_samples = endpoint->config.sent_packets_buffer_size / 2;
-        for ( i = 0; i < num_samples; ++i )
-        {
-            uint16_t sequence = (uint16_t) ( base_sequence + i );
-            struct reliable_sent_packet_data_t * sent_packet_data = (struct reliable_sent_packet_data_t*) 
-                reliable_sequence_buffer_find( endpoint->sent_packets, sequence );
-            if ( sent_packet_data && !sent_packet_data->acked )
-            {
-                num_dropped++;
-            }
-        }
-        float packet_loss = ( (float) num_dropped ) / ( (float) num_samples ) * 100.0f;
-        if ( fabs( endpoint->packet_loss - packet_loss ) > 0.00001 )
+        // regular packet
+
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] sending packet %d without fragmentation\n", endpoint->config.name, sequence );
+
+        if ( endpoint->config.transmit_packet_iov_function )
         {
-            endpoint->packet_loss += ( packet_loss - endpoint->packet_loss ) * endpoint->config.packet_loss_smoothing_factor;
+            uint8_t packet_header[RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES];
+
+            struct reliable_iovec_t iov[2];
+            iov[0].data = packet_header;
+            iov[0].bytes = reliable_endpoint_write_packet_header( endpoint, packet_header, sequence, ack, ack_bits );
+            iov[1].data = packet_data;
+            iov[1].bytes = packet_bytes;
+
+            endpoint->config.transmit_packet_iov_function( endpoint->config.context, endpoint->config.id, sequence, iov, 2 );
         }
         else
         {
-            endpoint->packet_loss = packet_loss;
+            uint8_t * transmit_packet_data = (uint8_t*) endpoint->allocate_function( endpoint->allocator_context, packet_bytes + endpoint->max_packet_header_bytes );
+
+            int packet_header_bytes = reliable_endpoint_write_packet_header( endpoint, transmit_packet_data, sequence, ack, ack_bits );
+
+            memcpy( transmit_packet_data + packet_header_bytes, packet_data, packet_bytes );
+
+            endpoint->config.transmit_packet_function( endpoint->config.context, endpoint->config.id, sequence, transmit_packet_data, packet_header_bytes + packet_bytes );
+
+            endpoint->free_function( endpoint->allocator_context, transmit_packet_data );
         }
     }
-
-    // calculate sent bandwidth
+    else
     {
-        uint32_t base_sequence = ( endpoint->sent_packets->sequence - endpoint->config.sent_packets_buffer_size + 1 ) + 0xFFFF;
-        int i;
-        int bytes_sent = 0;
-        double start_time = FLT_MAX;
-        double finish_time = 0.0;
-        int num_samples = endpoint->config.sent_packets_buffer_size / 2;
-        for ( i = 0; i < num_samples; ++i )
-        {
-            uint16_t sequence = (uint16_t) ( base_sequence + i );
-            struct reliable_sent_packet_data_t * sent_packet_data = (struct reliable_sent_packet_data_t*) 
-                reliable_sequence_buffer_find( endpoint->sent_packets, sequence );
-            if ( !sent_packet_data )
+        // fragmented packet
+
+        reliable_endpoint_send_fragments( endpoint, sequence, ack, ack_bits, packet_data, packet_bytes );
+    }
+
+    endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_SENT]++;
+}
+
+void reliable_endpoint_send_packet_with_headroom( struct reliable_endpoint_t * endpoint, uint8_t * packet_data, int packet_bytes )
+{
+    reliable_assert( endpoint );
+    reliable_assert( packet_data );
+    reliable_assert( packet_bytes > 0 );
+
+    uint16_t sequence;
+    uint16_t ack;
+    uint64_t ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+
+    if ( !reliable_endpoint_begin_send( endpoint, packet_bytes, &sequence ) )
+        return;
+
+    reliable_endpoint_generate_ack_bits( endpoint, &ack, ack_bits );
+
+    if ( packet_bytes <= endpoint->config.fragment_above )
+    {
+        // regular packet. the caller reserved RELIABLE_MAX_PACKET_HEADER_BYTES_FOR_ACK_WINDOW( ack_window_bits ) in front of the packet data, 
+        // so the header is written backwards into that space and the packet is transmitted without a copy
+
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] sending packet %d without fragmentation (headroom)\n", endpoint->config.name, sequence );
+
+        uint8_t packet_header[RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES];
+
+        int packet_header_bytes = reliable_endpoint_write_packet_header( endpoint, packet_header, sequence, ack, ack_bits );
+
+        uint8_t * transmit_packet_data = packet_data - packet_header_bytes;
+
+        memcpy( transmit_packet_data, packet_header, packet_header_bytes );
+
+        reliable_endpoint_transmit_packet( endpoint, sequence, transmit_packet_data, packet_header_bytes + packet_bytes );
+    }
+    else
+    {
+        // fragmented packet. each fragment needs its own header, so headroom doesn't help here
+
+        reliable_endpoint_send_fragments( endpoint, sequence, ack, ack_bits, packet_data, packet_bytes );
+    }
+
+    endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_SENT]++;
+}
+
+uint8_t * reliable_endpoint_begin_packet( struct reliable_endpoint_t * endpoint, int max_bytes )
+{
+    reliable_assert( endpoint );
+    reliable_assert( max_bytes > 0 );
+    reliable_assert( endpoint->transmit_packet_max_bytes == 0 );
+
+    if ( max_bytes > endpoint->config.max_packet_size )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] packet too large to begin. packet is %d bytes, maximum is %d\n", 
+            endpoint->config.name, max_bytes, endpoint->config.max_packet_size );
+        return NULL;
+    }
+
+    endpoint->transmit_packet_max_bytes = max_bytes;
+
+    return endpoint->transmit_packet_data + endpoint->max_packet_header_bytes;
+}
+
+void reliable_endpoint_commit_packet( struct reliable_endpoint_t * endpoint, int packet_bytes )
+{
+    reliable_assert( endpoint );
+    reliable_assert( endpoint->transmit_packet_max_bytes > 0 );
+    reliable_assert( packet_bytes > 0 );
+    reliable_assert( packet_bytes <= endpoint->transmit_packet_max_bytes );
+
+    endpoint->transmit_packet_max_bytes = 0;
+
+    reliable_endpoint_send_packet_with_headroom( endpoint, endpoint->transmit_packet_data + endpoint->max_packet_header_bytes, packet_bytes );
+}
+
+struct reliable_transmit_batch_t
+{
+    int num_datagrams;
+    uint16_t sequence[RELIABLE_MAX_BATCH_DATAGRAMS];
+    struct reliable_iovec_t iov[RELIABLE_MAX_BATCH_DATAGRAMS*2];
+    uint8_t header_data[RELIABLE_MAX_BATCH_DATAGRAMS][RELIABLE_FRAGMENT_HEADER_BYTES + RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES];
+};
+
+void reliable_endpoint_flush_transmit_batch( struct reliable_endpoint_t * endpoint, struct reliable_transmit_batch_t * batch )
+{
+    if ( batch->num_datagrams == 0 )
+        return;
+
+    if ( endpoint->config.transmit_packets_function )
+    {
+        endpoint->config.transmit_packets_function( endpoint->config.context, endpoint->config.id, batch->sequence, batch->iov, batch->num_datagrams );
+    }
+    else if ( endpoint->config.transmit_packet_iov_function )
+    {
+        int i;
+        for ( i = 0; i < batch->num_datagrams; ++i )
+        {
+            endpoint->config.transmit_packet_iov_function( endpoint->config.context, endpoint->config.id, batch->sequence[i], batch->iov + i*2, 2 );
+        }
+    }
+    else
+    {
+        int max_payload_bytes = endpoint->config.fragment_above > endpoint->config.fragment_size ? endpoint->config.fragment_above : endpoint->config.fragment_size;
+
+        uint8_t * transmit_packet_data = (uint8_t*) endpoint->allocate_function( endpoint->allocator_context, RELIABLE_FRAGMENT_HEADER_BYTES + endpoint->max_packet_header_bytes + max_payload_bytes );
+
+        int i;
+        for ( i = 0; i < batch->num_datagrams; ++i )
+        {
+            struct reliable_iovec_t * iov = batch->iov + i*2;
+            memcpy( transmit_packet_data, iov[0].data, iov[0].bytes );
+            memcpy( transmit_packet_data + iov[0].bytes, iov[1].data, iov[1].bytes );
+            endpoint->config.transmit_packet_function( endpoint->config.context, endpoint->config.id, batch->sequence[i], transmit_packet_data, iov[0].bytes + iov[1].bytes );
+        }
+
+        endpoint->free_function( endpoint->allocator_context, transmit_packet_data );
+    }
+
+    batch->num_datagrams = 0;
+}
+
+uint8_t * reliable_endpoint_transmit_batch_header( struct reliable_endpoint_t * endpoint, struct reliable_transmit_batch_t * batch )
+{
+    if ( batch->num_datagrams == RELIABLE_MAX_BATCH_DATAGRAMS )
+    {
+        reliable_endpoint_flush_transmit_batch( endpoint, batch );
+    }
+    return batch->header_data[batch->num_datagrams];
+}
+
+void reliable_endpoint_transmit_batch_add( struct reliable_transmit_batch_t * batch, uint16_t sequence, int header_bytes, uint8_t * payload_data, int payload_bytes )
+{
+    reliable_assert( batch->num_datagrams < RELIABLE_MAX_BATCH_DATAGRAMS );
+    struct reliable_iovec_t * iov = batch->iov + batch->num_datagrams*2;
+    iov[0].data = batch->header_data[batch->num_datagrams];
+    iov[0].bytes = header_bytes;
+    iov[1].data = payload_data;
+    iov[1].bytes = payload_bytes;
+    batch->sequence[batch->num_datagrams] = sequence;
+    batch->num_datagrams++;
+}
+
+void reliable_endpoint_send_packets( struct reliable_endpoint_t * endpoint, uint8_t ** packet_data, int * packet_bytes, int num_packets )
+{
+    reliable_assert( endpoint );
+    reliable_assert( packet_data );
+    reliable_assert( packet_bytes );
+    reliable_assert( num_packets >= 0 );
+
+    // sending doesn't change received packets, so one ack snapshot is valid for the whole batch
+
+    uint16_t ack;
+    uint64_t ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+
+    reliable_endpoint_generate_ack_bits( endpoint, &ack, ack_bits );
+
+    struct reliable_transmit_batch_t batch;
+    batch.num_datagrams = 0;
+
+    int i;
+    for ( i = 0; i < num_packets; ++i )
+    {
+        reliable_assert( packet_data[i] );
+        reliable_assert( packet_bytes[i] > 0 );
+
+        uint16_t sequence;
+
+        if ( !reliable_endpoint_begin_send( endpoint, packet_bytes[i], &sequence ) )
+            continue;
+
+        if ( packet_bytes[i] <= endpoint->config.fragment_above )
+        {
+            // regular packet
+
+            uint8_t * header = reliable_endpoint_transmit_batch_header( endpoint, &batch );
+
+            int header_bytes = reliable_endpoint_write_packet_header( endpoint, header, sequence, ack, ack_bits );
+
+            reliable_endpoint_transmit_batch_add( &batch, sequence, header_bytes, packet_data[i], packet_bytes[i] );
+        }
+        else if ( endpoint->fragment_queue )
+        {
+            // fragmented packet with pacing. fragment 0 goes out right away, so flush earlier packets first to keep them in order
+
+            reliable_endpoint_flush_transmit_batch( endpoint, &batch );
+
+            reliable_endpoint_send_fragments( endpoint, sequence, ack, ack_bits, packet_data[i], packet_bytes[i] );
+        }
+        else
+        {
+            // fragmented packet
+
+            uint8_t packet_header[RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES];
+
+            int packet_header_bytes = reliable_endpoint_write_packet_header( endpoint, packet_header, sequence, ack, ack_bits );
+
+            int num_fragments = reliable_endpoint_num_fragments( endpoint, packet_bytes[i] );
+
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] sending packet %d as %d fragments\n", endpoint->config.name, sequence, num_fragments );
+
+            uint8_t * q = packet_data[i];
+
+            uint8_t * end = q + packet_bytes[i];
+
+            int fragment_id;
+            for ( fragment_id = 0; fragment_id < num_fragments; ++fragment_id )
             {
-                continue;
+                int fragment_bytes = endpoint->config.fragment_size;
+                if ( q + fragment_bytes > end )
+                {
+                    fragment_bytes = (int) ( end - q );
+                }
+
+                uint8_t * header = reliable_endpoint_transmit_batch_header( endpoint, &batch );
+
+                int header_bytes = reliable_write_fragment_header( header, sequence, fragment_id, num_fragments, packet_header, packet_header_bytes );
+
+                reliable_endpoint_transmit_batch_add( &batch, sequence, header_bytes, q, fragment_bytes );
+
+                q += fragment_bytes;
+
+                endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT]++;
             }
-            bytes_sent += sent_packet_data->packet_bytes;
-            if ( sent_packet_data->time < start_time )
+        }
+
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_SENT]++;
+    }
+
+    reliable_endpoint_flush_transmit_batch( endpoint, &batch );
+}
+
+int reliable_parse_packet_header_window( uint8_t * packet_data, int packet_bytes, uint16_t * sequence, uint16_t * ack, uint64_t * ack_bits, int * ack_window_bits )
+{
+    if ( packet_bytes < 3 )
+    {
+        return -1;
+    }
+
+    uint8_t * p = packet_data;
+
+    uint8_t prefix_byte = reliable_read_uint8( &p );
+
+    if ( ( prefix_byte & 1 ) != 0 )
+    {
+        return -1;
+    }
+
+    int encoding = prefix_byte >> 6;
+
+    if ( encoding != RELIABLE_PACKET_HEADER_ACK_BITS && encoding != RELIABLE_PACKET_HEADER_ACK_WIDE && encoding != RELIABLE_PACKET_HEADER_ACK_RANGES )
+    {
+        return -1;
+    }
+
+    *sequence = reliable_read_uint16( &p );
+
+    if ( prefix_byte & (1<<5) )
+    {
+        if ( packet_bytes < 3 + 1 )
+        {
+            return -1;
+        }
+        uint8_t sequence_difference = reliable_read_uint8( &p );
+        *ack = *sequence - sequence_difference;
+    }
+    else
+    {
+        if ( packet_bytes < 3 + 2 )
+        {
+            return -1;
+        }
+        *ack = reliable_read_uint16( &p );
+    }
+
+    memset( ack_bits, 0, RELIABLE_ACK_WINDOW_WORDS * sizeof( uint64_t ) );
+
+    if ( encoding == RELIABLE_PACKET_HEADER_ACK_RANGES )
+    {
+        int num_ranges = ( prefix_byte >> 1 ) & 0xF;
+        int range_end = 0;
+
+        int i;
+        for ( i = 0; i < num_ranges; ++i )
+        {
+            uint32_t gap;
+            uint32_t length;
+
+            if ( !reliable_read_varint( &p, packet_data + packet_bytes, &gap ) || !reliable_read_varint( &p, packet_data + packet_bytes, &length ) )
             {
-                start_time = sent_packet_data->time;
+                return -1;
             }
-            if ( sent_packet_data->time > finish_time )
+
+            if ( length == 0 || gap > RELIABLE_MAX_ACK_WINDOW_BITS || length > RELIABLE_MAX_ACK_WINDOW_BITS || 
+                 range_end + (int) gap + (int) length > RELIABLE_MAX_ACK_WINDOW_BITS )
             {
-                finish_time = sent_packet_data->time;
+                return -1;
             }
+
+            reliable_ack_window_set_range( ack_bits, range_end + (int) gap, range_end + (int) gap + (int) length );
+
+            range_end += (int) gap + (int) length;
         }
-        if ( start_time != FLT_MAX && finish_time != 0.0 )
+
+        *ack_window_bits = range_end;
+
+        return (int) ( p - packet_data );
+    }
+
+    if ( encoding == RELIABLE_PACKET_HEADER_ACK_WIDE )
+    {
+        int width = ( prefix_byte >> 1 ) & 3;
+        if ( width == 3 || ( prefix_byte & ( (1<<3) | (1<<4) ) ) != 0 )
         {
-            float sent_bandwidth_kbps = (float) ( ( (double) bytes_sent ) / ( finish_time - start_time ) * 8.0f / 1000.0f );
-            if ( fabs( endpoint->sent_bandwidth_kbps - sent_bandwidth_kbps ) > 0.00001 )
+            return -1;
+        }
+
+        int num_words = 1 << width;
+
+        int i;
+        for ( i = 0; i < num_words; ++i )
+        {
+            if ( packet_bytes < ( p - packet_data ) + 1 )
             {
-                endpoint->sent_bandwidth_kbps += ( sent_bandwidth_kbps - endpoint->sent_bandwidth_kbps ) * endpoint->config.bandwidth_smoothing_factor;
+                return -1;
             }
-            else
+
+            uint8_t mask = reliable_read_uint8( &p );
+
+            if ( packet_bytes < ( p - packet_data ) + reliable_popcount64( mask ) )
             {
-                endpoint->sent_bandwidth_kbps = sent_bandwidth_kbps;
+                return -1;
+            }
+
+            int j;
+            for ( j = 0; j < 8; ++j )
+            {
+                uint64_t value = 0xFF;
+                if ( mask & ( 1 << j ) )
+                {
+                    value = reliable_read_uint8( &p );
+                }
+                ack_bits[i] |= value << ( j * 8 );
             }
         }
+
+        *ack_window_bits = num_words * 64;
+
+        return (int) ( p - packet_data );
+    }
+
+    int expected_bytes = 0;
+    int i;
+    for ( i = 1; i <= 4; ++i )
+    {
+        if ( prefix_byte & (1<<i) )
+        {
+            expected_bytes++;
+        }
+    }
+    if ( packet_bytes < ( p - packet_data ) + expected_bytes )
+    {
+        return -1;
+    }
+
+    uint32_t bits = 0xFFFFFFFF;
+
+    if ( prefix_byte & (1<<1) )
+    {
+        bits &= 0xFFFFFF00;
+        bits |= (uint32_t) ( reliable_read_uint8( &p ) );
+    }
+
+    if ( prefix_byte & (1<<2) )
+    {
+        bits &= 0xFFFF00FF;
+        bits |= (uint32_t) ( reliable_read_uint8( &p ) ) << 8;
+    }
+
+    if ( prefix_byte & (1<<3) )
+    {
+        bits &= 0xFF00FFFF;
+        bits |= (uint32_t) ( reliable_read_uint8( &p ) ) << 16;
+    }
+
+    if ( prefix_byte & (1<<4) )
+    {
+        bits &= 0x00FFFFFF;
+        bits |= (uint32_t) ( reliable_read_uint8( &p ) ) << 24;
+    }
+
+    ack_bits[0] = bits;
+
+    *ack_window_bits = 32;
+
+    return (int) ( p - packet_data );
+}
+
+int reliable_parse_packet_header( uint8_t * packet_data, int packet_bytes, uint16_t * sequence, uint16_t * ack, uint32_t * ack_bits )
+{
+    // only the most recent 32 ack bits are returned from wide ack windows
+
+    uint64_t ack_window[RELIABLE_ACK_WINDOW_WORDS];
+    int ack_window_bits;
+    int packet_header_bytes = reliable_parse_packet_header_window( packet_data, packet_bytes, sequence, ack, ack_window, &ack_window_bits );
+    if ( packet_header_bytes < 0 )
+        return -1;
+    *ack_bits = (uint32_t) ack_window[0];
+    return packet_header_bytes;
+}
+
+int reliable_read_packet_header_window( RELIABLE_CONST char * name, uint8_t * packet_data, int packet_bytes, uint16_t * sequence, uint16_t * ack, uint64_t * ack_bits, int * ack_window_bits )
+{
+    int packet_header_bytes = reliable_parse_packet_header_window( packet_data, packet_bytes, sequence, ack, ack_bits, ack_window_bits );
+    if ( packet_header_bytes < 0 )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] invalid packet header\n", name );
+    }
+    return packet_header_bytes;
+}
+
+int reliable_read_packet_header( RELIABLE_CONST char * name, uint8_t * packet_data, int packet_bytes, uint16_t * sequence, uint16_t * ack, uint32_t * ack_bits )
+{
+    int packet_header_bytes = reliable_parse_packet_header( packet_data, packet_bytes, sequence, ack, ack_bits );
+    if ( packet_header_bytes < 0 )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] invalid packet header\n", name );
+    }
+    return packet_header_bytes;
+}
+
+int reliable_peek_datagram( uint8_t * packet_data, int packet_bytes, struct reliable_datagram_info_t * info )
+{
+    // classifies a datagram without an endpoint, so it can be routed before it is received.
+    // ack and ack bits are only available for regular packets and the first fragment of a packet.
+
+    reliable_assert( packet_data );
+    reliable_assert( info );
+
+    if ( packet_bytes < 1 )
+        return RELIABLE_ERROR;
+
+    if ( ( packet_data[0] & 1 ) == 0 )
+    {
+        int packet_header_bytes = reliable_parse_packet_header_window( packet_data, packet_bytes, &info->sequence, &info->ack, info->ack_window, &info->ack_window_bits );
+        if ( packet_header_bytes < 0 )
+            return RELIABLE_ERROR;
+
+        info->ack_bits = (uint32_t) info->ack_window[0];
+
+        info->type = RELIABLE_DATAGRAM_PACKET;
+        info->has_ack = 1;
+        info->fragment_id = 0;
+        info->num_fragments = 1;
+        info->header_bytes = packet_header_bytes;
+
+        return RELIABLE_OK;
+    }
+
+    if ( packet_bytes < RELIABLE_FRAGMENT_HEADER_BYTES || packet_data[0] != 1 )
+        return RELIABLE_ERROR;
+
+    uint8_t * p = packet_data + 1;
+
+    info->type = RELIABLE_DATAGRAM_FRAGMENT;
+    info->sequence = reliable_read_uint16( &p );
+    info->fragment_id = (int) reliable_read_uint8( &p );
+    info->num_fragments = ( (int) reliable_read_uint8( &p ) ) + 1;
+    info->has_ack = 0;
+    info->ack = 0;
+    info->ack_bits = 0;
+    info->ack_window_bits = 0;
+    memset( info->ack_window, 0, sizeof( info->ack_window ) );
+    info->header_bytes = RELIABLE_FRAGMENT_HEADER_BYTES;
+
+    if ( info->fragment_id >= info->num_fragments )
+        return RELIABLE_ERROR;
+
+    if ( info->fragment_id == 0 )
+    {
+        uint16_t packet_sequence;
+
+        int packet_header_bytes = reliable_parse_packet_header_window( packet_data + RELIABLE_FRAGMENT_HEADER_BYTES, 
+                                                                       packet_bytes - RELIABLE_FRAGMENT_HEADER_BYTES, 
+                                                                       &packet_sequence, 
+                                                                       &info->ack, 
+                                                                       info->ack_window, 
+                                                                       &info->ack_window_bits );
+
+        if ( packet_header_bytes < 0 || packet_sequence != info->sequence )
+            return RELIABLE_ERROR;
+
+        info->ack_bits = (uint32_t) info->ack_window[0];
+
+        info->has_ack = 1;
+        info->header_bytes += packet_header_bytes;
+    }
+
+    return RELIABLE_OK;
+}
+
+int reliable_read_fragment_header( char * name, 
+                                   uint8_t * packet_data, 
+                                   int packet_bytes, 
+                                   int max_fragments, 
+                                   int fragment_size, 
+                                   int * fragment_id, 
+                                   int * num_fragments, 
+                                   int * fragment_bytes, 
+                                   uint16_t * sequence, 
+                                   uint16_t * ack, 
+                                   uint64_t * ack_bits, 
+                                   int * packet_header_bytes )
+{
+    struct reliable_datagram_info_t info;
+
+    if ( reliable_peek_datagram( packet_data, packet_bytes, &info ) != RELIABLE_OK || info.type != RELIABLE_DATAGRAM_FRAGMENT )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] invalid fragment header\n", name );
+        return -1;
+    }
+
+    if ( info.num_fragments > max_fragments )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] num fragments %d outside of range of max fragments %d\n", name, info.num_fragments, max_fragments );
+        return -1;
+    }
+
+    *sequence = info.sequence;
+    *ack = info.ack;
+    memcpy( ack_bits, info.ack_window, sizeof( info.ack_window ) );
+    *packet_header_bytes = info.header_bytes - RELIABLE_FRAGMENT_HEADER_BYTES;
+    *fragment_id = info.fragment_id;
+    *num_fragments = info.num_fragments;
+    *fragment_bytes = packet_bytes - info.header_bytes;
+
+    if ( *fragment_bytes > fragment_size )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] fragment bytes %d > fragment size %d\n", name, *fragment_bytes, fragment_size );
+        return - 1;
+    }
+
+    if ( *fragment_id != *num_fragments - 1 && *fragment_bytes != fragment_size )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] fragment %d is %d bytes, which is not the expected fragment size %d\n", 
+            name, *fragment_id, *fragment_bytes, fragment_size );
+        return -1;
+    }
+
+    return RELIABLE_FRAGMENT_HEADER_BYTES;
+}
+
+void reliable_store_fragment_data( struct reliable_fragment_reassembly_data_t * reassembly_data, 
+                                   uint16_t ack, 
+                                   const uint64_t * ack_bits, 
+                                   int packet_header_bytes, 
+                                   int fragment_id, 
+                                   int fragment_size, 
+                                   uint8_t * fragment_data, 
+                                   int fragment_bytes )
+{
+    if ( fragment_id == 0 )
+    {
+        // fragment 0 carries the packet header. keep the ack state from it, and store only the payload
+
+        reassembly_data->packet_header_bytes = (uint8_t) packet_header_bytes;
+        reassembly_data->ack = ack;
+        memcpy( reassembly_data->ack_bits, ack_bits, sizeof( reassembly_data->ack_bits ) );
+
+        fragment_data += reassembly_data->packet_header_bytes;
+        fragment_bytes -= reassembly_data->packet_header_bytes;
+    }
+
+    if ( fragment_id == reassembly_data->num_fragments_total - 1 )
+    {
+        reassembly_data->packet_bytes = ( reassembly_data->num_fragments_total - 1 ) * fragment_size + fragment_bytes;
+    }
+
+    memcpy( reassembly_data->packet_data + fragment_id * fragment_size, fragment_data, fragment_bytes );
+}
+
+int reliable_endpoint_accept_packet( struct reliable_endpoint_t * endpoint, uint16_t sequence, int packet_bytes )
+{
+    if ( packet_bytes > endpoint->config.max_packet_size )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] packet too large to receive. packet is at %d bytes, maximum is %d\n",
+            endpoint->config.name, packet_bytes, endpoint->config.max_packet_size );
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_TOO_LARGE_TO_RECEIVE]++;
+        return 0;
+    }
+
+    if ( !reliable_sequence_buffer_test_insert( endpoint->received_packets, sequence ) )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring stale packet %d\n", endpoint->config.name, sequence );
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_STALE]++;
+        return 0;
+    }
+
+    if ( endpoint->config.drop_duplicate_packets && reliable_endpoint_has_received( endpoint, sequence ) )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring duplicate packet %d\n", endpoint->config.name, sequence );
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_DUPLICATE]++;
+        return 0;
+    }
+
+    if ( reliable_sequence_buffer_exists( endpoint->deferred_packets, sequence ) )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring packet %d. packet is already deferred\n", endpoint->config.name, sequence );
+        return 0;
+    }
+
+    reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] processing packet %d\n", endpoint->config.name, sequence );
+
+    return 1;
+}
+
+void reliable_endpoint_record_received_packet( struct reliable_endpoint_t * endpoint, uint16_t sequence, int packet_bytes )
+{
+    reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] process packet %d successful\n", endpoint->config.name, sequence );
+
+    struct reliable_received_packet_data_t * received_packet_data = (struct reliable_received_packet_data_t*) 
+        reliable_sequence_buffer_insert( endpoint->received_packets, sequence );
+
+    if ( !received_packet_data )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] could not record packet %d (stale)\n", endpoint->config.name, sequence );
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_STALE]++;
+        return;
+    }
+
+    reliable_endpoint_update_received_bits( endpoint, sequence, 1 );
+
+    reliable_sequence_buffer_advance_with_cleanup( endpoint->fragment_reassembly, sequence, reliable_fragment_reassembly_data_cleanup );
+
+    received_packet_data->time = endpoint->time;
+    received_packet_data->packet_bytes = endpoint->config.packet_header_size + packet_bytes;
+}
+
+float reliable_endpoint_ack_packet( struct reliable_endpoint_t * endpoint, uint16_t ack_sequence, double receive_time )
+{
+    // returns the round trip time in milliseconds if this is a new ack, otherwise -1
+
+    struct reliable_sent_packet_data_t * sent_packet_data = 
+        reliable_sent_packets_find( endpoint->sent_packets, ack_sequence );
+
+    if ( !sent_packet_data || sent_packet_data->acked )
+        return -1.0f;
+
+    float rtt = (float) ( receive_time - sent_packet_data->time ) * 1000.0f;
+    reliable_assert( rtt >= 0.0 );
+
+    if ( endpoint->config.ack_function )
+    {
+        endpoint->config.ack_function( endpoint->config.context, endpoint->config.id, ack_sequence, sent_packet_data->time, rtt );
+    }
+    else if ( endpoint->num_acks < endpoint->config.ack_buffer_size )
+    {
+        endpoint->acks[endpoint->num_acks++] = ack_sequence;
+    }
+    else
+    {
+        // the packet is still acked, so rtt and packet loss stay right. only the entry in the ack buffer is dropped
+
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ack buffer is full. dropped ack for packet %d\n", endpoint->config.name, ack_sequence );
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_ACKS_OVERFLOW]++;
+    }
+
+    reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] acked packet %d\n", endpoint->config.name, ack_sequence );
+    endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED]++;
+    sent_packet_data->acked = 1;
+
+    return rtt;
+}
+
+void reliable_endpoint_update_rtt( struct reliable_endpoint_t * endpoint, float rtt )
+{
+    if ( ( endpoint->rtt == 0.0f && rtt > 0.0f ) || fabs( endpoint->rtt - rtt ) < 0.00001 )
+    {
+        endpoint->rtt = rtt;
+    }
+    else
+    {
+        endpoint->rtt += ( rtt - endpoint->rtt ) * endpoint->config.rtt_smoothing_factor;
+    }
+}
+
+void reliable_endpoint_apply_ack_bits( struct reliable_endpoint_t * endpoint, uint16_t ack, const uint64_t * ack_bits, uint64_t * new_ack_bits )
+{
+    // gets the bits in ack_bits that were not applied by previous packets, and marks them as applied
+
+    int i;
+
+    if ( reliable_sequence_greater_than( ack, endpoint->applied_ack ) )
+    {
+        reliable_ack_window_shift_up( endpoint->applied_ack_bits, (uint16_t) ( ack - endpoint->applied_ack ) );
+        endpoint->applied_ack = ack;
+        for ( i = 0; i < RELIABLE_ACK_WINDOW_WORDS; ++i )
+        {
+            new_ack_bits[i] = ack_bits[i] & ~endpoint->applied_ack_bits[i];
+            endpoint->applied_ack_bits[i] |= ack_bits[i];
+        }
+    }
+    else
+    {
+        int shift = (uint16_t) ( endpoint->applied_ack - ack );
+        if ( shift >= RELIABLE_MAX_ACK_WINDOW_BITS )
+        {
+            memcpy( new_ack_bits, ack_bits, RELIABLE_ACK_WINDOW_WORDS * sizeof( uint64_t ) );
+            return;
+        }
+        uint64_t applied_ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+        memcpy( applied_ack_bits, endpoint->applied_ack_bits, sizeof( applied_ack_bits ) );
+        if ( shift > 0 )
+        {
+            reliable_ack_window_shift_down( applied_ack_bits, shift );
+        }
+        for ( i = 0; i < RELIABLE_ACK_WINDOW_WORDS; ++i )
+        {
+            new_ack_bits[i] = ack_bits[i] & ~applied_ack_bits[i];
+        }
+        reliable_ack_window_or_shifted( endpoint->applied_ack_bits, ack_bits, shift );
+    }
+}
+
+void reliable_endpoint_unapply_ack( struct reliable_endpoint_t * endpoint, uint16_t sequence )
+{
+    // the ack couldn't be applied, so the next packet that carries it tries again
+
+    int shift = (uint16_t) ( endpoint->applied_ack - sequence );
+    if ( shift < RELIABLE_MAX_ACK_WINDOW_BITS )
+    {
+        endpoint->applied_ack_bits[shift >> 6] &= ~( ( (uint64_t) 1 ) << ( shift & 63 ) );
+    }
+}
+
+float reliable_endpoint_apply_ack( struct reliable_endpoint_t * endpoint, uint16_t sequence, double receive_time )
+{
+    // acks for packets that are not in the sent packets buffer are not applied either, so stale acks don't hide future ones
+
+    if ( !reliable_sequence_buffer_exists( endpoint->sent_packets, sequence ) )
+    {
+        reliable_endpoint_unapply_ack( endpoint, sequence );
+        return -1.0f;
+    }
+
+    return reliable_endpoint_ack_packet( endpoint, sequence, receive_time );
+}
+
+void reliable_endpoint_process_acks( struct reliable_endpoint_t * endpoint, uint16_t ack, const uint64_t * ack_bits, double receive_time )
+{
+    uint64_t new_ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+
+    reliable_endpoint_apply_ack_bits( endpoint, ack, ack_bits, new_ack_bits );
+
+    int i;
+    for ( i = 0; i < RELIABLE_ACK_WINDOW_WORDS; ++i )
+    {
+        uint64_t bits = new_ack_bits[i];
+        while ( bits != 0 )
+        {
+            int j = reliable_ctz64( bits );
+            bits &= bits - 1;
+            float rtt = reliable_endpoint_apply_ack( endpoint, ack - ((uint16_t)( i * 64 + j )), receive_time );
+            if ( rtt >= 0.0f )
+            {
+                reliable_endpoint_update_rtt( endpoint, rtt );
+            }
+        }
+    }
+}
+
+void reliable_endpoint_defer_packet( struct reliable_endpoint_t * endpoint, uint16_t sequence, uint16_t ack, const uint64_t * ack_bits, int packet_bytes )
+{
+    // the sequence is reserved until the application commits it, so it is not acked yet, and duplicates are ignored
+
+    struct reliable_deferred_packet_data_t * deferred_packet_data = (struct reliable_deferred_packet_data_t*) 
+        reliable_sequence_buffer_insert( endpoint->deferred_packets, sequence );
+
+    if ( !deferred_packet_data )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] could not defer packet %d (stale)\n", endpoint->config.name, sequence );
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_STALE]++;
+        return;
+    }
+
+    reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] deferred packet %d\n", endpoint->config.name, sequence );
+
+    deferred_packet_data->time = endpoint->time;
+    deferred_packet_data->ack = ack;
+    memcpy( deferred_packet_data->ack_bits, ack_bits, sizeof( deferred_packet_data->ack_bits ) );
+    deferred_packet_data->packet_bytes = packet_bytes;
+
+    endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_DEFERRED]++;
+}
+
+int reliable_endpoint_process_packet( struct reliable_endpoint_t * endpoint, 
+                                      uint16_t sequence, 
+                                      uint16_t ack, 
+                                      const uint64_t * ack_bits, 
+                                      uint8_t * packet_data, 
+                                      int packet_bytes, 
+                                      int packet_header_bytes, 
+                                      int (*process_packet_function)(void*,uint64_t,uint16_t,uint8_t*,int) )
+{
+    if ( !reliable_endpoint_accept_packet( endpoint, sequence, packet_bytes ) )
+        return 0;
+
+    int result = process_packet_function( endpoint->config.context, endpoint->config.id, sequence, packet_data, packet_bytes );
+
+    if ( !result )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] process packet failed\n", endpoint->config.name );
+        return 0;
+    }
+
+    if ( result == RELIABLE_PACKET_DEFERRED )
+    {
+        reliable_endpoint_defer_packet( endpoint, sequence, ack, ack_bits, packet_header_bytes + packet_bytes );
+        return result;
+    }
+
+    reliable_endpoint_record_received_packet( endpoint, sequence, packet_header_bytes + packet_bytes );
+
+    reliable_endpoint_process_acks( endpoint, ack, ack_bits, endpoint->time );
+
+    return result;
+}
+
+void reliable_endpoint_receive_packet( struct reliable_endpoint_t * endpoint, uint8_t * packet_data, int packet_bytes )
+{
+    reliable_assert( endpoint );
+    reliable_assert( packet_data );
+    reliable_assert( packet_bytes > 0 );
+
+    // the peer may send a wider ack window than this endpoint does, so allow for the widest header
+
+    if ( packet_bytes > endpoint->config.max_packet_size + RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES + RELIABLE_FRAGMENT_HEADER_BYTES )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] packet too large to receive. packet is at least %d bytes, maximum is %d\n",
+            endpoint->config.name, packet_bytes - ( RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES + RELIABLE_FRAGMENT_HEADER_BYTES ), endpoint->config.max_packet_size );
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_TOO_LARGE_TO_RECEIVE]++;
+        return;
+    }
+
+    uint8_t prefix_byte = packet_data[0];
+
+    if ( ( prefix_byte & 1 ) == 0 )
+    {
+        // regular packet
+
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED]++;
+
+        uint16_t sequence;
+        uint16_t ack;
+        uint64_t ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+        int ack_window_bits;
+
+        int packet_header_bytes = reliable_read_packet_header_window( endpoint->config.name, packet_data, packet_bytes, &sequence, &ack, ack_bits, &ack_window_bits );
+        if ( packet_header_bytes < 0 )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring invalid packet. could not read packet header\n", endpoint->config.name );
+            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_INVALID]++;
+            return;
+        }
+
+        reliable_assert( packet_header_bytes <= packet_bytes );
+
+        reliable_endpoint_process_packet( endpoint, 
+                                          sequence, 
+                                          ack, 
+                                          ack_bits, 
+                                          packet_data + packet_header_bytes, 
+                                          packet_bytes - packet_header_bytes, 
+                                          packet_header_bytes, 
+                                          endpoint->config.process_packet_function );
+    }
+    else
+    {
+        // fragment packet
+
+        int fragment_id;
+        int num_fragments;
+        int fragment_bytes;
+
+        uint16_t sequence;
+        uint16_t ack;
+        uint64_t ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+        int packet_header_bytes;
+
+        int fragment_header_bytes = reliable_read_fragment_header( endpoint->config.name, 
+                                                                   packet_data, 
+                                                                   packet_bytes, 
+                                                                   endpoint->config.max_fragments, 
+                                                                   endpoint->config.fragment_size,
+                                                                   &fragment_id, 
+                                                                   &num_fragments, 
+                                                                   &fragment_bytes, 
+                                                                   &sequence, 
+                                                                   &ack, 
+                                                                   ack_bits, 
+                                                                   &packet_header_bytes );
+
+        if ( fragment_header_bytes < 0 )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring invalid fragment. could not read fragment header\n", endpoint->config.name );
+            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID]++;
+            return;
+        }
+
+        struct reliable_fragment_reassembly_data_t * reassembly_data = 
+            reliable_fragment_reassembly_find( endpoint->fragment_reassembly, sequence );
+
+        if ( !reassembly_data )
+        {
+            reassembly_data = (struct reliable_fragment_reassembly_data_t*) 
+                reliable_sequence_buffer_insert_with_cleanup( endpoint->fragment_reassembly, sequence, reliable_fragment_reassembly_data_cleanup );
+
+            if ( !reassembly_data )
+            {
+                reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] ignoring invalid fragment. could not insert in reassembly buffer (stale)\n", endpoint->config.name );
+                endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID]++;
+                return;
+            }
+
+            uint8_t * reassembly_packet_data = reliable_fragment_pool_allocate( &endpoint->fragment_pool );
+            if ( !reassembly_packet_data )
+            {
+                reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring fragment of packet %d. reassembly buffers are full\n", endpoint->config.name, sequence );
+                reassembly_data->packet_data = NULL;
+                reliable_sequence_buffer_remove( endpoint->fragment_reassembly, sequence );
+                endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_REASSEMBLY_FULL]++;
+                return;
+            }
+
+            reliable_sequence_buffer_advance( endpoint->received_packets, sequence );
+
+            reliable_endpoint_update_received_bits( endpoint, sequence, 0 );
+
+            reassembly_data->time = endpoint->time;
+            reassembly_data->sequence = sequence;
+            reassembly_data->ack = 0;
+            memset( reassembly_data->ack_bits, 0, sizeof( reassembly_data->ack_bits ) );
+            reassembly_data->num_fragments_total = (uint16_t) num_fragments;
+            reassembly_data->packet_data = reassembly_packet_data;
+            reassembly_data->packet_bytes = 0;
+            reassembly_data->pool = &endpoint->fragment_pool;
+            reassembly_data->fragment_received[0] = 0;
+            reassembly_data->fragment_received[1] = 0;
+            reassembly_data->fragment_received[2] = 0;
+            reassembly_data->fragment_received[3] = 0;
+        }
+
+        if ( num_fragments != (int) reassembly_data->num_fragments_total )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] ignoring invalid fragment. fragment count mismatch. expected %d, got %d\n", 
+                endpoint->config.name, (int) reassembly_data->num_fragments_total, num_fragments );
+            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID]++;
+            return;
+        }
+
+        uint64_t fragment_bit = ( (uint64_t) 1 ) << ( fragment_id & 63 );
+
+        if ( reassembly_data->fragment_received[fragment_id >> 6] & fragment_bit )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] ignoring fragment %d of packet %d. fragment already received\n", 
+                endpoint->config.name, fragment_id, sequence );
+            return;
+        }
+
+        reassembly_data->fragment_received[fragment_id >> 6] |= fragment_bit;
+
+        int num_fragments_received = reliable_fragment_reassembly_num_fragments_received( reassembly_data );
+
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] received fragment %d of packet %d (%d/%d)\n", 
+            endpoint->config.name, fragment_id, sequence, num_fragments_received, num_fragments );
+
+        reliable_store_fragment_data( reassembly_data, 
+                                      ack, 
+                                      ack_bits, 
+                                      packet_header_bytes, 
+                                      fragment_id, 
+                                      endpoint->config.fragment_size, 
+                                      packet_data + fragment_header_bytes, 
+                                      packet_bytes - fragment_header_bytes );
+
+        if ( num_fragments_received == num_fragments )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] completed reassembly of packet %d\n", endpoint->config.name, sequence );
+
+            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED]++;
+
+            int (*process_packet_function)(void*,uint64_t,uint16_t,uint8_t*,int) = endpoint->config.process_reassembled_packet_function;
+            if ( process_packet_function == NULL )
+            {
+                process_packet_function = endpoint->config.process_packet_function;
+            }
+
+            int result = reliable_endpoint_process_packet( endpoint, 
+                                                           sequence, 
+                                                           reassembly_data->ack, 
+                                                           reassembly_data->ack_bits, 
+                                                           reassembly_data->packet_data, 
+                                                           reassembly_data->packet_bytes, 
+                                                           reassembly_data->packet_header_bytes, 
+                                                           process_packet_function );
+
+            if ( ( result == RELIABLE_PACKET_RETAINED || result == RELIABLE_PACKET_DEFERRED ) && endpoint->config.process_reassembled_packet_function )
+            {
+                // the application owns the packet data now, and frees it with reliable_endpoint_free_packet
+
+                reliable_fragment_pool_release( &endpoint->fragment_pool, reassembly_data->packet_data );
+                reassembly_data->packet_data = NULL;
+            }
+
+            reliable_sequence_buffer_remove_with_cleanup( endpoint->fragment_reassembly, sequence, reliable_fragment_reassembly_data_cleanup );
+        }
+
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_RECEIVED]++;
+    }
+}
+
+struct reliable_receive_batch_t
+{
+    int num_packets;
+    uint16_t sequence[RELIABLE_MAX_BATCH_DATAGRAMS];
+    uint16_t ack[RELIABLE_MAX_BATCH_DATAGRAMS];
+    uint64_t ack_bits[RELIABLE_MAX_BATCH_DATAGRAMS][RELIABLE_ACK_WINDOW_WORDS];
+    uint8_t * packet_data[RELIABLE_MAX_BATCH_DATAGRAMS];
+    int packet_bytes[RELIABLE_MAX_BATCH_DATAGRAMS];
+    int packet_header_bytes[RELIABLE_MAX_BATCH_DATAGRAMS];
+    int result[RELIABLE_MAX_BATCH_DATAGRAMS];
+};
+
+void reliable_endpoint_process_merged_acks( struct reliable_endpoint_t * endpoint, uint16_t ack, const uint64_t * ack_bits )
+{
+    // the rtt is sampled once, from the most recent packet that is newly acked
+
+    int rtt_sampled = 0;
+
+    uint64_t new_ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+
+    reliable_endpoint_apply_ack_bits( endpoint, ack, ack_bits, new_ack_bits );
+
+    int i;
+    for ( i = 0; i < RELIABLE_ACK_WINDOW_WORDS; ++i )
+    {
+        uint64_t bits = new_ack_bits[i];
+        while ( bits != 0 )
+        {
+            int j = reliable_ctz64( bits );
+            bits &= bits - 1;
+            float rtt = reliable_endpoint_apply_ack( endpoint, ack - ((uint16_t)( i * 64 + j )), endpoint->time );
+            if ( rtt >= 0.0f && !rtt_sampled )
+            {
+                reliable_endpoint_update_rtt( endpoint, rtt );
+                rtt_sampled = 1;
+            }
+        }
+    }
+}
+
+void reliable_endpoint_process_receive_batch( struct reliable_endpoint_t * endpoint, struct reliable_receive_batch_t * batch )
+{
+    // drop stale and oversized packets from the batch, and duplicates of packets earlier in the batch if duplicates are dropped
+
+    int num_packets = 0;
+
+    int i, j;
+    for ( i = 0; i < batch->num_packets; ++i )
+    {
+        if ( !reliable_endpoint_accept_packet( endpoint, batch->sequence[i], batch->packet_bytes[i] ) )
+            continue;
+
+        if ( endpoint->config.drop_duplicate_packets )
+        {
+            for ( j = 0; j < num_packets; ++j )
+            {
+                if ( batch->sequence[j] == batch->sequence[i] )
+                    break;
+            }
+
+            if ( j < num_packets )
+            {
+                reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring duplicate packet %d\n", endpoint->config.name, batch->sequence[i] );
+                endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_DUPLICATE]++;
+                continue;
+            }
+        }
+
+        batch->sequence[num_packets] = batch->sequence[i];
+        batch->ack[num_packets] = batch->ack[i];
+        memcpy( batch->ack_bits[num_packets], batch->ack_bits[i], sizeof( batch->ack_bits[i] ) );
+        batch->packet_data[num_packets] = batch->packet_data[i];
+        batch->packet_bytes[num_packets] = batch->packet_bytes[i];
+        batch->packet_header_bytes[num_packets] = batch->packet_header_bytes[i];
+        num_packets++;
+    }
+
+    batch->num_packets = 0;
+
+    if ( num_packets == 0 )
+        return;
+
+    if ( endpoint->config.process_packets_function )
+    {
+        memset( batch->result, 0, num_packets * sizeof( int ) );
+
+        endpoint->config.process_packets_function( endpoint->config.context, 
+                                                   endpoint->config.id, 
+                                                   batch->sequence, 
+                                                   batch->packet_data, 
+                                                   batch->packet_bytes, 
+                                                   batch->result, 
+                                                   num_packets );
+    }
+    else
+    {
+        for ( i = 0; i < num_packets; ++i )
+        {
+            batch->result[i] = endpoint->config.process_packet_function( endpoint->config.context, 
+                                                                         endpoint->config.id, 
+                                                                         batch->sequence[i], 
+                                                                         batch->packet_data[i], 
+                                                                         batch->packet_bytes[i] );
+        }
+    }
+
+    // merge the ack bitfields of all processed packets into one window relative to the most recent ack. 
+    // if an ack doesn't fit in the window, the acks merged so far are processed first.
+
+    uint16_t merged_ack = 0;
+    uint64_t merged_ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+    memset( merged_ack_bits, 0, sizeof( merged_ack_bits ) );
+
+    for ( i = 0; i < num_packets; ++i )
+    {
+        if ( !batch->result[i] )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] process packet failed\n", endpoint->config.name );
+            continue;
+        }
+
+        // the same packet can be in the batch more than once, and an earlier copy may have been deferred while this one was processed
+
+        if ( reliable_sequence_buffer_exists( endpoint->deferred_packets, batch->sequence[i] ) )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring packet %d. packet is already deferred\n", endpoint->config.name, batch->sequence[i] );
+            continue;
+        }
+
+        if ( batch->result[i] == RELIABLE_PACKET_DEFERRED )
+        {
+            reliable_endpoint_defer_packet( endpoint, batch->sequence[i], batch->ack[i], batch->ack_bits[i], batch->packet_header_bytes[i] + batch->packet_bytes[i] );
+            continue;
+        }
+
+        // packets were checked for staleness before the batch was processed, but a more recent packet earlier in the batch may have moved the window past this one
+
+        if ( !reliable_sequence_buffer_test_insert( endpoint->received_packets, batch->sequence[i] ) )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring stale packet %d\n", endpoint->config.name, batch->sequence[i] );
+            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_STALE]++;
+            continue;
+        }
+
+        reliable_endpoint_record_received_packet( endpoint, batch->sequence[i], batch->packet_header_bytes[i] + batch->packet_bytes[i] );
+
+        uint16_t ack = batch->ack[i];
+        uint64_t * ack_bits = batch->ack_bits[i];
+
+        if ( reliable_ack_window_empty( ack_bits ) )
+            continue;
+
+        if ( reliable_ack_window_empty( merged_ack_bits ) )
+        {
+            merged_ack = ack;
+            memcpy( merged_ack_bits, ack_bits, sizeof( merged_ack_bits ) );
+        }
+        else if ( reliable_sequence_greater_than( ack, merged_ack ) )
+        {
+            int shift = (uint16_t) ( ack - merged_ack );
+            if ( !reliable_ack_window_fits( merged_ack_bits, shift ) )
+            {
+                reliable_endpoint_process_merged_acks( endpoint, merged_ack, merged_ack_bits );
+                memset( merged_ack_bits, 0, sizeof( merged_ack_bits ) );
+            }
+            else
+            {
+                reliable_ack_window_shift_up( merged_ack_bits, shift );
+            }
+            merged_ack = ack;
+            reliable_ack_window_or_shifted( merged_ack_bits, ack_bits, 0 );
+        }
+        else
+        {
+            int shift = (uint16_t) ( merged_ack - ack );
+            if ( reliable_ack_window_fits( ack_bits, shift ) )
+            {
+                reliable_ack_window_or_shifted( merged_ack_bits, ack_bits, shift );
+            }
+            else
+            {
+                reliable_endpoint_process_merged_acks( endpoint, ack, ack_bits );
+            }
+        }
+    }
+
+    if ( !reliable_ack_window_empty( merged_ack_bits ) )
+    {
+        reliable_endpoint_process_merged_acks( endpoint, merged_ack, merged_ack_bits );
+    }
+}
+
+void reliable_endpoint_receive_packets( struct reliable_endpoint_t * endpoint, uint8_t ** packet_data, int * packet_bytes, int num_packets )
+{
+    reliable_assert( endpoint );
+    reliable_assert( packet_data );
+    reliable_assert( packet_bytes );
+    reliable_assert( num_packets >= 0 );
+
+    struct reliable_receive_batch_t batch;
+    batch.num_packets = 0;
+
+    int i;
+    for ( i = 0; i < num_packets; ++i )
+    {
+        reliable_assert( packet_data[i] );
+        reliable_assert( packet_bytes[i] > 0 );
+
+        if ( packet_bytes[i] > endpoint->config.max_packet_size + RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES + RELIABLE_FRAGMENT_HEADER_BYTES )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] packet too large to receive. packet is at least %d bytes, maximum is %d\n",
+                endpoint->config.name, packet_bytes[i] - ( RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES + RELIABLE_FRAGMENT_HEADER_BYTES ), endpoint->config.max_packet_size );
+            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_TOO_LARGE_TO_RECEIVE]++;
+            continue;
+        }
+
+        if ( packet_data[i][0] & 1 )
+        {
+            // fragments go through reassembly one at a time. process the packets before them first, so packets are processed in the order they arrived
+
+            reliable_endpoint_process_receive_batch( endpoint, &batch );
+
+            reliable_endpoint_receive_packet( endpoint, packet_data[i], packet_bytes[i] );
+            continue;
+        }
+
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED]++;
+
+        int index = batch.num_packets;
+
+        int ack_window_bits;
+
+        int packet_header_bytes = reliable_read_packet_header_window( endpoint->config.name, packet_data[i], packet_bytes[i], &batch.sequence[index], &batch.ack[index], batch.ack_bits[index], &ack_window_bits );
+        if ( packet_header_bytes < 0 )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring invalid packet. could not read packet header\n", endpoint->config.name );
+            endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_INVALID]++;
+            continue;
+        }
+
+        // prefetch the received and sent packet entries this packet will touch, so the misses overlap with parsing the rest of the batch
+
+        int received_index = reliable_sequence_buffer_index( endpoint->received_packets, batch.sequence[index] );
+        int sent_index = reliable_sequence_buffer_index( endpoint->sent_packets, batch.ack[index] );
+        reliable_prefetch( reliable_sequence_buffer_entry_sequence( endpoint->received_packets, received_index ) );
+        reliable_prefetch( endpoint->received_packets->entry_data + received_index * endpoint->received_packets->entry_stride );
+        reliable_prefetch( reliable_sequence_buffer_entry_sequence( endpoint->sent_packets, sent_index ) );
+        reliable_prefetch( endpoint->sent_packets->entry_data + sent_index * endpoint->sent_packets->entry_stride );
+
+        batch.packet_data[index] = packet_data[i] + packet_header_bytes;
+        batch.packet_bytes[index] = packet_bytes[i] - packet_header_bytes;
+        batch.packet_header_bytes[index] = packet_header_bytes;
+        batch.num_packets++;
+
+        if ( batch.num_packets == RELIABLE_MAX_BATCH_DATAGRAMS )
+        {
+            reliable_endpoint_process_receive_batch( endpoint, &batch );
+        }
+    }
+
+    reliable_endpoint_process_receive_batch( endpoint, &batch );
+}
+
+void reliable_endpoint_commit_received( struct reliable_endpoint_t * endpoint, uint16_t sequence, int ok )
+{
+    reliable_assert( endpoint );
+
+    struct reliable_deferred_packet_data_t * deferred_packet_data = (struct reliable_deferred_packet_data_t*)
+        reliable_sequence_buffer_find( endpoint->deferred_packets, sequence );
+
+    if ( !deferred_packet_data )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring commit of packet %d. packet is not deferred\n", endpoint->config.name, sequence );
+        return;
+    }
+
+    struct reliable_deferred_packet_data_t deferred_packet = *deferred_packet_data;
+
+    reliable_sequence_buffer_remove( endpoint->deferred_packets, sequence );
+
+    if ( !ok )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "[%s] process packet failed\n", endpoint->config.name );
+        return;
+    }
+
+    if ( !reliable_sequence_buffer_test_insert( endpoint->received_packets, sequence ) )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] ignoring commit of stale packet %d\n", endpoint->config.name, sequence );
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_STALE]++;
+        return;
+    }
+
+    reliable_endpoint_record_received_packet( endpoint, sequence, deferred_packet.packet_bytes );
+
+    // rtt is measured from when the packet was received, so time spent processing it doesn't count
+
+    reliable_endpoint_process_acks( endpoint, deferred_packet.ack, deferred_packet.ack_bits, deferred_packet.time );
+}
+
+void reliable_endpoint_free_packet(struct reliable_endpoint_t * endpoint, void * packet )
+{
+    reliable_assert( endpoint );
+    reliable_assert( packet );
+    endpoint->free_function( endpoint->allocator_context, packet );
+}
+
+uint16_t * reliable_endpoint_get_acks( struct reliable_endpoint_t * endpoint, int * num_acks )
+{
+    reliable_assert( endpoint );
+    reliable_assert( num_acks );
+    *num_acks = endpoint->num_acks;
+    return endpoint->acks;
+}
+
+void reliable_endpoint_clear_acks( struct reliable_endpoint_t * endpoint )
+{
+    reliable_assert( endpoint );
+    endpoint->num_acks = 0;
+}
+
+void reliable_endpoint_reset( struct reliable_endpoint_t * endpoint )
+{
+    reliable_assert( endpoint );
+
+    endpoint->num_acks = 0;
+    endpoint->sequence = 0;
+
+    if ( endpoint->acks )
+    {
+        memset( endpoint->acks, 0, endpoint->config.ack_buffer_size * sizeof( uint16_t ) );
+    }
+    memset( endpoint->counters, 0, RELIABLE_ENDPOINT_NUM_COUNTERS * sizeof( uint64_t ) );
+
+    int i;
+    for ( i = 0; i < endpoint->config.fragment_reassembly_buffer_size; ++i )
+    {
+        struct reliable_fragment_reassembly_data_t * reassembly_data = (struct reliable_fragment_reassembly_data_t*) 
+            reliable_sequence_buffer_at_index( endpoint->fragment_reassembly, i );
+
+        if ( reassembly_data && reassembly_data->packet_data )
+        {
+            reliable_fragment_pool_free( &endpoint->fragment_pool, reassembly_data->packet_data );
+            reassembly_data->packet_data = NULL;
+        }
+    }
+
+    reliable_sequence_buffer_reset( endpoint->sent_packets );
+    reliable_sequence_buffer_reset( endpoint->received_packets );
+    reliable_sequence_buffer_reset( endpoint->fragment_reassembly );
+    reliable_sequence_buffer_reset( endpoint->deferred_packets );
+
+    endpoint->ack = 0xFFFF;
+    memset( endpoint->received_bits, 0, sizeof( endpoint->received_bits ) );
+    endpoint->applied_ack = 0;
+    memset( endpoint->applied_ack_bits, 0, sizeof( endpoint->applied_ack_bits ) );
+
+    endpoint->fragment_queue_head = 0;
+    endpoint->num_queued_fragments = 0;
+    endpoint->fragment_pacing_budget = endpoint->fragment_queue_stride;
+}
+
+void reliable_endpoint_expire_fragment_reassembly( struct reliable_endpoint_t * endpoint )
+{
+    // partially received packets are normally evicted as newer sequences arrive, which may never happen on an idle connection
+
+    double expire_time = endpoint->time - endpoint->config.fragment_reassembly_timeout;
+
+    int i;
+    for ( i = 0; i < endpoint->config.fragment_reassembly_buffer_size; ++i )
+    {
+        struct reliable_fragment_reassembly_data_t * reassembly_data = (struct reliable_fragment_reassembly_data_t*) 
+            reliable_sequence_buffer_at_index( endpoint->fragment_reassembly, i );
+
+        if ( !reassembly_data || reassembly_data->time > expire_time )
+            continue;
+
+        // fragment payloads are fragment_size bytes, except the last fragment, whose size is known once it is received
+
+        int num_fragments_received = reliable_fragment_reassembly_num_fragments_received( reassembly_data );
+        int last_fragment_id = reassembly_data->num_fragments_total - 1;
+        uint64_t fragment_bytes = (uint64_t) num_fragments_received * endpoint->config.fragment_size;
+        if ( reassembly_data->fragment_received[last_fragment_id >> 6] & ( ( (uint64_t) 1 ) << ( last_fragment_id & 63 ) ) )
+        {
+            fragment_bytes -= (uint64_t) ( endpoint->config.fragment_size - ( reassembly_data->packet_bytes - last_fragment_id * endpoint->config.fragment_size ) );
+        }
+
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "[%s] expired reassembly of packet %d (%d/%d fragments)\n", 
+            endpoint->config.name, reassembly_data->sequence, num_fragments_received, (int) reassembly_data->num_fragments_total );
+
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTED_PACKETS_EXPIRED]++;
+        endpoint->counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENT_BYTES_EXPIRED] += fragment_bytes;
+
+        reliable_sequence_buffer_remove_with_cleanup( endpoint->fragment_reassembly, reassembly_data->sequence, reliable_fragment_reassembly_data_cleanup );
+    }
+}
+
+void reliable_endpoint_update( struct reliable_endpoint_t * endpoint, double time )
+{
+    reliable_assert( endpoint );
+
+    double delta_time = time - endpoint->time;
+
+    endpoint->time = time;
+
+    if ( endpoint->fragment_queue && delta_time > 0.0 )
+    {
+        reliable_endpoint_update_fragment_pacing( endpoint, delta_time );
+    }
+
+    if ( endpoint->config.fragment_reassembly_timeout > 0.0f )
+    {
+        reliable_endpoint_expire_fragment_reassembly( endpoint );
+    }
+    
+    // calculate packet loss
+    {
+        uint32_t base_sequence = ( endpoint->sent_packets->sequence - endpoint->config.sent_packets_buffer_size + 1 ) + 0xFFFF;
+        int i;
+        int num_dropped = 0;
+        int num_samples = endpoint->config.sent_packets_buffer_size / 2;
+        for ( i = 0; i < num_samples; ++i )
+        {
+            uint16_t sequence = (uint16_t) ( base_sequence + i );
+            struct reliable_sent_packet_data_t * sent_packet_data = 
+                reliable_sent_packets_find( endpoint->sent_packets, sequence );
+            if ( sent_packet_data && !sent_packet_data->acked )
+            {
+                num_dropped++;
+            }
+        }
+        float packet_loss = ( (float) num_dropped ) / ( (float) num_samples ) * 100.0f;
+        if ( fabs( endpoint->packet_loss - packet_loss ) > 0.00001 )
+        {
+            endpoint->packet_loss += ( packet_loss - endpoint->packet_loss ) * endpoint->config.packet_loss_smoothing_factor;
+        }
+        else
+        {
+            endpoint->packet_loss = packet_loss;
+        }
+    }
+
+    // calculate sent bandwidth
+    {
+        uint32_t base_sequence = ( endpoint->sent_packets->sequence - endpoint->config.sent_packets_buffer_size + 1 ) + 0xFFFF;
+        int i;
+        int bytes_sent = 0;
+        double start_time = FLT_MAX;
+        double finish_time = 0.0;
+        int num_samples = endpoint->config.sent_packets_buffer_size / 2;
+        for ( i = 0; i < num_samples; ++i )
+        {
+            uint16_t sequence = (uint16_t) ( base_sequence + i );
+            struct reliable_sent_packet_data_t * sent_packet_data = 
+                reliable_sent_packets_find( endpoint->sent_packets, sequence );
+            if ( !sent_packet_data )
+            {
+                continue;
+            }
+            bytes_sent += sent_packet_data->packet_bytes;
+            if ( sent_packet_data->time < start_time )
+            {
+                start_time = sent_packet_data->time;
+            }
+            if ( sent_packet_data->time > finish_time )
+            {
+                finish_time = sent_packet_data->time;
+            }
+        }
+        if ( start_time != FLT_MAX && finish_time != 0.0 )
+        {
+            float sent_bandwidth_kbps = (float) ( ( (double) bytes_sent ) / ( finish_time - start_time ) * 8.0f / 1000.0f );
+            if ( fabs( endpoint->sent_bandwidth_kbps - sent_bandwidth_kbps ) > 0.00001 )
+            {
+                endpoint->sent_bandwidth_kbps += ( sent_bandwidth_kbps - endpoint->sent_bandwidth_kbps ) * endpoint->config.bandwidth_smoothing_factor;
+            }
+            else
+            {
+                endpoint->sent_bandwidth_kbps = sent_bandwidth_kbps;
+            }
+        }
+    }
+
+    // calculate received bandwidth
+    {
+        uint32_t base_sequence = ( endpoint->received_packets->sequence - endpoint->config.received_packets_buffer_size + 1 ) + 0xFFFF;
+        int i;
+        int bytes_sent = 0;
+        double start_time = FLT_MAX;
+        double finish_time = 0.0;
+        int num_samples = endpoint->config.received_packets_buffer_size / 2;
+        for ( i = 0; i < num_samples; ++i )
+        {
+            uint16_t sequence = (uint16_t) ( base_sequence + i );
+            struct reliable_received_packet_data_t * received_packet_data = 
+                reliable_received_packets_find( endpoint->received_packets, sequence );
+            if ( !received_packet_data )
+            {
+                continue;
+            }
+            bytes_sent += received_packet_data->packet_bytes;
+            if ( received_packet_data->time < start_time )
+            {
+                start_time = received_packet_data->time;
+            }
+            if ( received_packet_data->time > finish_time )
+            {
+                finish_time = received_packet_data->time;
+            }
+        }
+        if ( start_time != FLT_MAX && finish_time != 0.0 )
+        {
+            float received_bandwidth_kbps = (float) ( ( (double) bytes_sent ) / ( finish_time - start_time ) * 8.0f / 1000.0f );
+            if ( fabs( endpoint->received_bandwidth_kbps - received_bandwidth_kbps ) > 0.00001 )
+            {
+                endpoint->received_bandwidth_kbps += ( received_bandwidth_kbps - endpoint->received_bandwidth_kbps ) * endpoint->config.bandwidth_smoothing_factor;
+            }
+            else
+            {
+                endpoint->received_bandwidth_kbps = received_bandwidth_kbps;
+            }
+        }
+    }
+
+    // calculate acked bandwidth
+    {
+        uint32_t base_sequence = ( endpoint->sent_packets->sequence - endpoint->config.sent_packets_buffer_size + 1 ) + 0xFFFF;
+        int i;
+        int bytes_sent = 0;
+        double start_time = FLT_MAX;
+        double finish_time = 0.0;
+        int num_samples = endpoint->config.sent_packets_buffer_size / 2;
+        for ( i = 0; i < num_samples; ++i )
+        {
+            uint16_t sequence = (uint16_t) ( base_sequence + i );
+            struct reliable_sent_packet_data_t * sent_packet_data = 
+                reliable_sent_packets_find( endpoint->sent_packets, sequence );
+            if ( !sent_packet_data || !sent_packet_data->acked )
+            {
+                continue;
+            }
+            bytes_sent += sent_packet_data->packet_bytes;
+            if ( sent_packet_data->time < start_time )
+            {
+                start_time = sent_packet_data->time;
+            }
+            if ( sent_packet_data->time > finish_time )
+            {
+                finish_time = sent_packet_data->time;
+            }
+        }
+        if ( start_time != FLT_MAX && finish_time != 0.0 )
+        {
+            float acked_bandwidth_kbps = (float) ( ( (double) bytes_sent ) / ( finish_time - start_time ) * 8.0f / 1000.0f );
+            if ( fabs( endpoint->acked_bandwidth_kbps - acked_bandwidth_kbps ) > 0.00001 )
+            {
+                endpoint->acked_bandwidth_kbps += ( acked_bandwidth_kbps - endpoint->acked_bandwidth_kbps ) * endpoint->config.bandwidth_smoothing_factor;
+            }
+            else
+            {
+                endpoint->acked_bandwidth_kbps = acked_bandwidth_kbps;
+            }
+        }
+    }
+}
+
+float reliable_endpoint_rtt( struct reliable_endpoint_t * endpoint )
+{
+    reliable_assert( endpoint );
+    return endpoint->rtt;
+}
+
+float reliable_endpoint_packet_loss( struct reliable_endpoint_t * endpoint )
+{
+    reliable_assert( endpoint );
+    return endpoint->packet_loss;
+}
+
+void reliable_endpoint_bandwidth( struct reliable_endpoint_t * endpoint, float * sent_bandwidth_kbps, float * received_bandwidth_kbps, float * acked_bandwidth_kbps )
+{
+    reliable_assert( endpoint );
+    reliable_assert( sent_bandwidth_kbps );
+    reliable_assert( acked_bandwidth_kbps );
+    reliable_assert( received_bandwidth_kbps );
+    *sent_bandwidth_kbps = endpoint->sent_bandwidth_kbps;
+    *received_bandwidth_kbps = endpoint->received_bandwidth_kbps;
+    *acked_bandwidth_kbps = endpoint->acked_bandwidth_kbps;
+}
+
+RELIABLE_CONST uint64_t * reliable_endpoint_counters( struct reliable_endpoint_t * endpoint )
+{
+    reliable_assert( endpoint );
+    return endpoint->counters;
+}
+
+int reliable_endpoint_num_queued_fragments( struct reliable_endpoint_t * endpoint )
+{
+    reliable_assert( endpoint );
+    return endpoint->num_queued_fragments;
+}
+
+void reliable_copy_string( char * dest, RELIABLE_CONST char * source, size_t dest_size )
+{
+    reliable_assert( dest );
+    reliable_assert( source );
+    reliable_assert( dest_size >= 1 );
+    memset( dest, 0, dest_size );
+    for ( size_t i = 0; i < dest_size - 1; i++ )
+    {
+        if ( source[i] == '\0' )
+            break;
+        dest[i] = source[i];
+    }
+}
+
+// ---------------------------------------------------------------
+
+#if RELIABLE_ENABLE_TESTS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <memory.h>
+
+static void check_handler( RELIABLE_CONST char * condition, 
+                           RELIABLE_CONST char * function,
+                           RELIABLE_CONST char * file,
+                           int line )
+{
+    printf( "check failed: ( %s ), function %s, file %s, line %d\n", condition, function, file, line );
+#ifdef RELIABLE_DEBUG
+    #if defined( __GNUC__ )
+        __builtin_trap();
+    #elif defined( _MSC_VER )
+        __debugbreak();
+    #endif
+#endif
+    exit( 1 );
+}
+
+#define check( condition )                                                                                      \
+do                                                                                                              \
+{                                                                                                               \
+    if ( !(condition) )                                                                                         \
+    {                                                                                                           \
+        check_handler( #condition, (RELIABLE_CONST char*) __FUNCTION__, __FILE__, __LINE__ );                   \
+    }                                                                                                           \
+} while(0)
+
+static void test_endian()
+{
+    uint32_t value = 0x11223344;
+
+    char * bytes = (char*) &value;
+
+#if RELIABLE_LITTLE_ENDIAN
+
+    check( bytes[0] == 0x44 );
+    check( bytes[1] == 0x33 );
+    check( bytes[2] == 0x22 );
+    check( bytes[3] == 0x11 );
+
+#else // #if RELIABLE_LITTLE_ENDIAN
+
+    check( bytes[3] == 0x44 );
+    check( bytes[2] == 0x33 );
+    check( bytes[1] == 0x22 );
+    check( bytes[0] == 0x11 );
+
+#endif // #if RELIABLE_LITTLE_ENDIAN
+}
+
+struct test_sequence_data_t
+{
+    uint16_t sequence;
+};
+
+#define TEST_SEQUENCE_BUFFER_SIZE 256
+
+static void test_sequence_buffer()
+{
+    struct reliable_sequence_buffer_t * sequence_buffer = reliable_sequence_buffer_create( TEST_SEQUENCE_BUFFER_SIZE, 
+                                                                                           sizeof( struct test_sequence_data_t ), 
+                                                                                           RELIABLE_SEQUENCE_BUFFER_LAYOUT_SEPARATE, 
+                                                                                           NULL, 
+                                                                                           NULL, 
+                                                                                           NULL );
+
+    check( sequence_buffer );
+    check( sequence_buffer->sequence == 0 );
+    check( sequence_buffer->num_entries == TEST_SEQUENCE_BUFFER_SIZE );
+    check( sequence_buffer->entry_stride == sizeof( struct test_sequence_data_t ) );
+
+    int i;
+    for ( i = 0; i < TEST_SEQUENCE_BUFFER_SIZE; ++i )
+    {
+        check( reliable_sequence_buffer_find( sequence_buffer, ((uint16_t)i) ) == NULL );
+    }                                                                      
+
+    for ( i = 0; i <= TEST_SEQUENCE_BUFFER_SIZE*4; ++i )
+    {
+        struct test_sequence_data_t * entry = (struct test_sequence_data_t*) reliable_sequence_buffer_insert( sequence_buffer, ((uint16_t)i) );
+        check( entry );
+        entry->sequence = (uint16_t) i;
+        check( sequence_buffer->sequence == i + 1 );
+    }
+
+    for ( i = 0; i <= TEST_SEQUENCE_BUFFER_SIZE; ++i )
+    {
+        struct test_sequence_data_t * entry = (struct test_sequence_data_t*) reliable_sequence_buffer_insert( sequence_buffer, ((uint16_t)i) );
+        check( entry == NULL );
+    }    
+
+    int index = TEST_SEQUENCE_BUFFER_SIZE * 4;
+    for ( i = 0; i < TEST_SEQUENCE_BUFFER_SIZE; ++i )
+    {
+        struct test_sequence_data_t * entry = (struct test_sequence_data_t*) reliable_sequence_buffer_find( sequence_buffer, (uint16_t) index );
+        check( entry );
+        check( entry->sequence == (uint32_t) index );
+        index--;
+    }
+
+    reliable_sequence_buffer_reset( sequence_buffer );
+
+    check( sequence_buffer );
+    check( sequence_buffer->sequence == 0 );
+    check( sequence_buffer->num_entries == TEST_SEQUENCE_BUFFER_SIZE );
+    check( sequence_buffer->entry_stride == sizeof( struct test_sequence_data_t ) );
+
+    for ( i = 0; i < TEST_SEQUENCE_BUFFER_SIZE; ++i )
+    {
+        check( reliable_sequence_buffer_find( sequence_buffer, (uint16_t) i ) == NULL );
+    }
+
+    reliable_sequence_buffer_destroy( sequence_buffer );
+}
+
+// reference ack bits from scanning the sequence buffer. tests check the endpoint received bits against it
+
+static void reliable_sequence_buffer_generate_ack_bits( struct reliable_sequence_buffer_t * sequence_buffer, uint16_t * ack, uint32_t * ack_bits )
+{
+    reliable_assert( sequence_buffer );
+    reliable_assert( ack );
+    reliable_assert( ack_bits );
+    *ack = sequence_buffer->sequence - 1;
+    *ack_bits = 0;
+    uint32_t mask = 1;
+    int i;
+    for ( i = 0; i < 32; ++i )
+    {
+        uint16_t sequence = *ack - ((uint16_t)i);
+        if ( reliable_sequence_buffer_exists( sequence_buffer, sequence ) )
+            *ack_bits |= mask;
+        mask <<= 1;
+    }
+}
+
+static void test_generate_ack_bits()
+{
+    struct reliable_sequence_buffer_t * sequence_buffer = reliable_sequence_buffer_create( TEST_SEQUENCE_BUFFER_SIZE, 
+                                                                                           sizeof( struct test_sequence_data_t ), 
+                                                                                           RELIABLE_SEQUENCE_BUFFER_LAYOUT_SEPARATE, 
+                                                                                           NULL, 
+                                                                                           NULL, 
+                                                                                           NULL );
+
+    uint16_t ack = 0;
+    uint32_t ack_bits = 0xFFFFFFFF;
+
+    reliable_sequence_buffer_generate_ack_bits( sequence_buffer, &ack, &ack_bits );
+    check( ack == 0xFFFF );
+    check( ack_bits == 0 );
+
+    int i;
+    for ( i = 0; i <= TEST_SEQUENCE_BUFFER_SIZE; ++i )
+    {
+        reliable_sequence_buffer_insert( sequence_buffer, (uint16_t) i );
+    }
+
+    reliable_sequence_buffer_generate_ack_bits( sequence_buffer, &ack, &ack_bits );
+    check( ack == TEST_SEQUENCE_BUFFER_SIZE );
+    check( ack_bits == 0xFFFFFFFF );
+
+    reliable_sequence_buffer_reset( sequence_buffer );
+
+    uint16_t input_acks[] = { 1, 5, 9, 11 };
+    int input_num_acks = sizeof( input_acks ) / sizeof( uint16_t );
+    for ( i = 0; i < input_num_acks; ++i )
+    {
+        reliable_sequence_buffer_insert( sequence_buffer, input_acks[i] );
+    }
+
+    reliable_sequence_buffer_generate_ack_bits( sequence_buffer, &ack, &ack_bits );
+
+    check( ack == 11 );
+    check( ack_bits == ( 1 | (1<<(11-9)) | (1<<(11-5)) | (1<<(11-1)) ) );
+
+    reliable_sequence_buffer_destroy( sequence_buffer );
+}
+
+static void test_packet_header()
+{
+    uint16_t write_sequence;
+    uint16_t write_ack;
+    uint32_t write_ack_bits;
+
+    uint16_t read_sequence;
+    uint16_t read_ack;
+    uint32_t read_ack_bits;
+
+    uint8_t packet_data[RELIABLE_MAX_PACKET_HEADER_BYTES];
+
+    // worst case, sequence and ack are far apart, no packets acked.
+
+    write_sequence = 10000;
+    write_ack = 100;
+    write_ack_bits = 0;
+
+    int bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, write_ack_bits );
+
+    check( bytes_written == RELIABLE_MAX_PACKET_HEADER_BYTES );
+
+    int bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits );
+
+    check( bytes_read == bytes_written );
+
+    check( read_sequence == write_sequence );
+    check( read_ack == write_ack );
+    check( read_ack_bits == write_ack_bits );
+
+    // rare case. sequence and ack are far apart, significant # of acks are missing
+
+    write_sequence = 10000;
+    write_ack = 100;
+    write_ack_bits = 0xFEFEFFFE;
+
+    bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, write_ack_bits );
+
+    check( bytes_written == 1 + 2 + 2 + 3 );
+
+    bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits );
+
+    check( bytes_read == bytes_written );
+
+    check( read_sequence == write_sequence );
+    check( read_ack == write_ack );
+    check( read_ack_bits == write_ack_bits );
+
+    // common case under packet loss. sequence and ack are close together, some acks are missing
+
+    write_sequence = 200;
+    write_ack = 100;
+    write_ack_bits = 0xFFFEFFFF;
+
+    bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, write_ack_bits );
+
+    check( bytes_written == 1 + 2 + 1 + 1 );
+
+    bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits );
+
+    check( bytes_read == bytes_written );
+
+    check( read_sequence == write_sequence );
+    check( read_ack == write_ack );
+    check( read_ack_bits == write_ack_bits );
+
+    // ideal case. no packet loss.
+
+    write_sequence = 200;
+    write_ack = 100;
+    write_ack_bits = 0xFFFFFFFF;
+
+    bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, write_ack_bits );
+
+    check( bytes_written == 1 + 2 + 1 );
+
+    bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits );
+
+    check( bytes_read == bytes_written );
+
+    check( read_sequence == write_sequence );
+    check( read_ack == write_ack );
+    check( read_ack_bits == write_ack_bits );
+}
+
+struct test_context_t
+{
+    int drop;
+    int allow_packets;
+    struct reliable_endpoint_t * sender;
+    struct reliable_endpoint_t * receiver;
+};
+
+void test_default_context( struct test_context_t * context )
+{
+    memset( context, 0, sizeof( *context ) );
+    context->allow_packets = -1;
+}
+
+static void test_transmit_packet_function( void * _context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) sequence;
+
+    struct test_context_t * context = (struct test_context_t*) _context;
+
+    if ( context->drop )
+    {
+        return;
+    }
+
+    if ( context->allow_packets >= 0 )
+    {
+        if ( context->allow_packets == 0 )
+        {
+            return;
+        }
+
+        context->allow_packets--;
+    }
+
+    if ( id == 0 )
+    {
+        reliable_endpoint_receive_packet( context->receiver, packet_data, packet_bytes );
+    }
+    else if ( id == 1 )
+    {
+        reliable_endpoint_receive_packet( context->sender, packet_data, packet_bytes );
+    }
+}
+
+static int test_process_packet_function( void * _context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    struct test_context_t * context = (struct test_context_t*) _context;
+
+    (void) context;
+    (void) id;
+    (void) sequence;
+    (void) packet_data;
+    (void) packet_bytes;
+
+    return 1;
+}
+
+#define TEST_ACKS_NUM_ITERATIONS 256
+
+static void test_acks()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+    
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function;
+
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    double delta_time = 0.01;
+
+    int i;
+    for ( i = 0; i < TEST_ACKS_NUM_ITERATIONS; ++i )
+    {
+        uint8_t dummy_packet[8];
+        memset( dummy_packet, 0, sizeof( dummy_packet ) );
+
+        reliable_endpoint_send_packet( context.sender, dummy_packet, sizeof( dummy_packet ) );
+        reliable_endpoint_send_packet( context.receiver, dummy_packet, sizeof( dummy_packet ) );
+
+        reliable_endpoint_update( context.sender, time );
+        reliable_endpoint_update( context.receiver, time );
+
+        time += delta_time;
+    }
+
+    uint8_t sender_acked_packet[TEST_ACKS_NUM_ITERATIONS];
+    memset( sender_acked_packet, 0, sizeof( sender_acked_packet ) );
+    int sender_num_acks;
+    uint16_t * sender_acks = reliable_endpoint_get_acks( context.sender, &sender_num_acks );
+    for ( i = 0; i < sender_num_acks; ++i )
+    {
+        if ( sender_acks[i] < TEST_ACKS_NUM_ITERATIONS )
+        {
+            sender_acked_packet[sender_acks[i]] = 1;
+        }
+    }
+    for ( i = 0; i < TEST_ACKS_NUM_ITERATIONS / 2; ++i )
+    {
+        check( sender_acked_packet[i] == 1 );
+    }
+
+    uint8_t receiver_acked_packet[TEST_ACKS_NUM_ITERATIONS];
+    memset( receiver_acked_packet, 0, sizeof( receiver_acked_packet ) );
+    int receiver_num_acks;
+    uint16_t * receiver_acks = reliable_endpoint_get_acks( context.receiver, &receiver_num_acks );
+    for ( i = 0; i < receiver_num_acks; ++i )
+    {
+        if ( receiver_acks[i] < TEST_ACKS_NUM_ITERATIONS )
+            receiver_acked_packet[receiver_acks[i]] = 1;
+    }
+    for ( i = 0; i < TEST_ACKS_NUM_ITERATIONS / 2; ++i )
+    {
+        check( receiver_acked_packet[i] == 1 );
+    }
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+}
+
+static void test_acks_packet_loss()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+    
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function;
+
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    const double delta_time = 0.1f;
+
+    int i;
+    for ( i = 0; i < TEST_ACKS_NUM_ITERATIONS; ++i )
+    {
+        uint8_t dummy_packet[8];
+        memset( dummy_packet, 0, sizeof( dummy_packet ) );
+
+        context.drop = ( i % 2 );
+
+        reliable_endpoint_send_packet( context.sender, dummy_packet, sizeof( dummy_packet ) );
+        reliable_endpoint_send_packet( context.receiver, dummy_packet, sizeof( dummy_packet ) );
+
+        reliable_endpoint_update( context.sender, time );
+        reliable_endpoint_update( context.receiver, time );
+
+        time += delta_time;
+    }
+
+    uint8_t sender_acked_packet[TEST_ACKS_NUM_ITERATIONS];
+    memset( sender_acked_packet, 0, sizeof( sender_acked_packet ) );
+    int sender_num_acks;
+    uint16_t * sender_acks = reliable_endpoint_get_acks( context.sender, &sender_num_acks );
+    for ( i = 0; i < sender_num_acks; ++i )
+    {
+        if ( sender_acks[i] < TEST_ACKS_NUM_ITERATIONS )
+        {
+            sender_acked_packet[sender_acks[i]] = 1;
+        }
+    }
+    for ( i = 0; i < TEST_ACKS_NUM_ITERATIONS / 2; ++i )
+    {
+        check( sender_acked_packet[i] == (i+1) % 2 );
+    }
+
+    uint8_t receiver_acked_packet[TEST_ACKS_NUM_ITERATIONS];
+    memset( receiver_acked_packet, 0, sizeof( receiver_acked_packet ) );
+    int receiver_num_acks;
+    uint16_t * receiver_acks = reliable_endpoint_get_acks( context.sender, &receiver_num_acks );
+    for ( i = 0; i < receiver_num_acks; ++i )
+    {
+        if ( receiver_acks[i] < TEST_ACKS_NUM_ITERATIONS )
+        {
+            receiver_acked_packet[receiver_acks[i]] = 1;
+        }
+    }
+    for ( i = 0; i < TEST_ACKS_NUM_ITERATIONS / 2; ++i )
+    {
+        check( receiver_acked_packet[i] == (i+1) % 2 );
+    }
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+}
+
+#define TEST_MAX_PACKET_BYTES (4*1024)
+
+static void generate_packet_data_with_size( uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    reliable_assert( packet_bytes >= 2 );
+    reliable_assert( packet_bytes <= TEST_MAX_PACKET_BYTES );
+
+    packet_data[0] = (uint8_t) ( sequence & 0xFF );
+    packet_data[1] = (uint8_t) ( (sequence>>8) & 0xFF );
+    int i;
+    for ( i = 2; i < packet_bytes; ++i )
+    {
+        packet_data[i] = (uint8_t) ( ( (int)i + sequence ) % 256 );
+    }
+}
+
+static int generate_packet_data( uint16_t sequence, uint8_t * packet_data )
+{
+    int packet_bytes = ( ( (int)sequence * 1023 ) % ( TEST_MAX_PACKET_BYTES - 2 ) ) + 2;
+    generate_packet_data_with_size( sequence, packet_data, packet_bytes );
+    return packet_bytes;
+}
+
+static void validate_packet_data( uint8_t * packet_data, int packet_bytes )
+{
+    reliable_assert( packet_bytes >= 2 );
+    reliable_assert( packet_bytes <= TEST_MAX_PACKET_BYTES );
+    uint16_t sequence = 0;
+    sequence |= (uint16_t) packet_data[0];
+    sequence |= ( (uint16_t) packet_data[1] ) << 8;
+    check( packet_bytes == ( ( (int)sequence * 1023 ) % ( TEST_MAX_PACKET_BYTES - 2 ) ) + 2 );
+    int i;
+    for ( i = 2; i < packet_bytes; ++i )
+    {
+        check( packet_data[i] == (uint8_t) ( ( (int)i + sequence ) % 256 ) );
+    }
+}
+
+static int test_process_packet_function_validate( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    reliable_assert( packet_data );
+    reliable_assert( packet_bytes > 0 );
+    reliable_assert( packet_bytes <= TEST_MAX_PACKET_BYTES );
+
+    (void) context;
+    (void) id;
+    (void) sequence;
+
+    validate_packet_data( packet_data, packet_bytes );
+
+    return 1;
+}
+
+static int generate_packet_data_large( uint8_t* packet_data )
+{
+    int data_bytes = TEST_MAX_PACKET_BYTES - 2;
+    reliable_assert( data_bytes >= 2) ;
+    reliable_assert( data_bytes <= (1 << 16) );
+
+    packet_data[0] = (uint8_t) (data_bytes & 0xFF);
+    packet_data[1] = (uint8_t) ( (data_bytes >> 8) & 0xFF );
+    int i;
+    for ( i = 2; i < data_bytes; ++i )
+    {
+        packet_data[i] = (uint8_t) ( i % 256 );
+    }
+    return data_bytes + 2;
+}
+
+static int test_process_packet_function_validate_large( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    reliable_assert( packet_data );
+    reliable_assert( packet_bytes >= 2 );
+    reliable_assert( packet_bytes <= TEST_MAX_PACKET_BYTES );
+
+    (void) context;
+    (void) id;
+    (void) sequence;
+
+    uint16_t data_bytes = 0;
+    data_bytes |= (uint16_t) packet_data[0];
+    data_bytes |= ( (uint16_t) packet_data[1] ) << 8;
+    check( packet_bytes == data_bytes + 2 );
+    int i;
+    for ( i = 2; i < data_bytes; ++i )
+    {
+        check( packet_data[i] == (uint8_t) ( i  % 256 ) );
+    }
+
+    return 1;
+}
+
+void test_packets()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+    
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    sender_config.fragment_above = 500;
+    receiver_config.fragment_above = 500;
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function_validate;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function_validate;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    double delta_time = 0.1;
+
+    int i;
+    for ( i = 0; i < 16; ++i )
+    {
+        {
+            uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+            uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
+            int packet_bytes = generate_packet_data( sequence, packet_data );
+            reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+        }
+
+        {
+            uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+            uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
+            int packet_bytes = generate_packet_data( sequence, packet_data );
+            reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+        }
+
+        reliable_endpoint_update( context.sender, time );
+        reliable_endpoint_update( context.receiver, time );
+
+        reliable_endpoint_clear_acks( context.sender );
+        reliable_endpoint_clear_acks( context.receiver );
+
+        time += delta_time;
+    }
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+}
+
+void test_large_packets()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    sender_config.max_packet_size = TEST_MAX_PACKET_BYTES;
+    receiver_config.max_packet_size = TEST_MAX_PACKET_BYTES;
+
+    sender_config.fragment_above = TEST_MAX_PACKET_BYTES;
+    receiver_config.fragment_above = TEST_MAX_PACKET_BYTES;
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function_validate_large;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function_validate_large;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    {
+        uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+        int packet_bytes = generate_packet_data_large( packet_data );
+        check( packet_bytes == TEST_MAX_PACKET_BYTES );
+        reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+    }
+
+    reliable_endpoint_update( context.sender, time );
+    reliable_endpoint_update( context.receiver, time );
+
+    reliable_endpoint_clear_acks( context.sender );
+    reliable_endpoint_clear_acks( context.receiver );
+
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_TOO_LARGE_TO_RECEIVE] == 0 );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 1 );
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+}
+
+void test_sequence_buffer_rollover()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+    
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    sender_config.fragment_above = 500;
+    receiver_config.fragment_above = 500;
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    int num_packets_sent = 0;
+    int i;
+    for (i = 0; i <= 32767; ++i)
+    {
+        uint8_t packet_data[16];
+        int packet_bytes = sizeof( packet_data ) / sizeof( uint8_t );
+        reliable_endpoint_next_packet_sequence( context.sender );
+        reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+
+        ++num_packets_sent;
+    }
+
+    uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+    int packet_bytes = sizeof( packet_data ) / sizeof( uint8_t );
+    reliable_endpoint_next_packet_sequence( context.sender );
+    reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+    ++num_packets_sent;
+
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == (uint16_t) num_packets_sent );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID] == 0 );
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+}
+
+#define ARRAY_LENGTH(x) (sizeof(x) / sizeof((x)[0]))
+
+struct test_tracking_allocate_context_t
+{
+    void* active_allocations[1024];
+};
+
+void * test_tracking_allocate_function( void * context, size_t bytes )
+{
+    struct test_tracking_allocate_context_t* tracking_context = (struct test_tracking_allocate_context_t*)context;
+    void * allocation = malloc( bytes );
+    int tracking_index;
+    for ( tracking_index = 0; tracking_index < (int) ARRAY_LENGTH(tracking_context->active_allocations); ++tracking_index )
+    {
+        if ( tracking_context->active_allocations[tracking_index] == NULL )
+        {
+            break;
+        }
+    }
+
+    reliable_assert(tracking_index < (int) ARRAY_LENGTH(tracking_context->active_allocations));
+    tracking_context->active_allocations[tracking_index] = allocation;
+    return allocation;
+}
+
+void test_tracking_free_function( void * context, void * pointer )
+{
+    struct test_tracking_allocate_context_t* tracking_context = (struct test_tracking_allocate_context_t*)context;
+    int tracking_index;
+    for ( tracking_index = 0; tracking_index < (int) ARRAY_LENGTH(tracking_context->active_allocations); ++tracking_index )
+    {
+        if ( tracking_context->active_allocations[tracking_index] == pointer )
+        {
+            break;
+        }
+    }
+
+    reliable_assert( tracking_index < (int) ARRAY_LENGTH(tracking_context->active_allocations) );
+    tracking_context->active_allocations[tracking_index] = NULL;
+    free( pointer );
+}
+
+void test_fragment_cleanup()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+
+    struct test_tracking_allocate_context_t tracking_alloc_context;
+    memset( &tracking_alloc_context, 0, sizeof( tracking_alloc_context ) );
+    
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    receiver_config.allocator_context = &tracking_alloc_context;
+    receiver_config.allocate_function = &test_tracking_allocate_function;
+    receiver_config.free_function = &test_tracking_free_function;
+    receiver_config.fragment_reassembly_buffer_size = 4;
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    double delta_time = 0.1;
+
+    int packet_sizes[] = {
+        sender_config.fragment_size + sender_config.fragment_size/2,
+        10,
+        10,
+        10,
+        10,
+    };
+
+    // Make sure we're sending more than receiver_config.fragment_reassembly_buffer_size packets, so the buffer wraps around.
+    reliable_assert( (int) ARRAY_LENGTH( packet_sizes ) > receiver_config.fragment_reassembly_buffer_size );
+
+    int i;
+    for ( i = 0; i < (int) ARRAY_LENGTH( packet_sizes ); ++i )
+    {
+        // Only allow one packet per transmit, so that our fragmented packets are only partially
+        // delivered.
+        context.allow_packets = 1;
+        {
+            uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+            uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
+            generate_packet_data_with_size( sequence, packet_data, packet_sizes[i] );
+            reliable_endpoint_send_packet( context.sender, packet_data, packet_sizes[i]);
+        }
+
+        reliable_endpoint_update( context.sender, time );
+        reliable_endpoint_update( context.receiver, time );
+
+        reliable_endpoint_clear_acks( context.sender );
+        reliable_endpoint_clear_acks( context.receiver );
+
+        time += delta_time;
+    }
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+    
+    // Make sure that there is no memory that hasn't been freed.
+    int tracking_index;
+    for ( tracking_index = 0; tracking_index < (int) ARRAY_LENGTH(tracking_alloc_context.active_allocations); ++tracking_index )
+    {
+        check( tracking_alloc_context.active_allocations[tracking_index] == NULL );
+    }
+}
+
+struct test_counting_allocate_context_t
+{
+    int num_allocations;
+    int num_frees;
+};
+
+void * test_counting_allocate_function( void * context, size_t bytes )
+{
+    struct test_counting_allocate_context_t * counting_context = (struct test_counting_allocate_context_t*) context;
+    counting_context->num_allocations++;
+    return malloc( bytes );
+}
+
+void test_counting_free_function( void * context, void * pointer )
+{
+    struct test_counting_allocate_context_t * counting_context = (struct test_counting_allocate_context_t*) context;
+    counting_context->num_frees++;
+    free( pointer );
+}
+
+void test_packets_headroom()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+
+    struct test_counting_allocate_context_t counting_alloc_context;
+    memset( &counting_alloc_context, 0, sizeof( counting_alloc_context ) );
+
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    sender_config.fragment_above = 500;
+    receiver_config.fragment_above = 500;
+
+    sender_config.allocator_context = &counting_alloc_context;
+    sender_config.allocate_function = &test_counting_allocate_function;
+    sender_config.free_function = &test_counting_free_function;
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function_validate;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function_validate;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    double delta_time = 0.1;
+
+    int num_regular_packets = 0;
+    int num_fragmented_packets = 0;
+
+    int i;
+    for ( i = 0; i < 32; ++i )
+    {
+        uint8_t buffer[RELIABLE_MAX_PACKET_HEADER_BYTES + TEST_MAX_PACKET_BYTES];
+        uint8_t * packet_data = buffer + RELIABLE_MAX_PACKET_HEADER_BYTES;
+        uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
+        int packet_bytes = generate_packet_data( sequence, packet_data );
+
+        int num_allocations = counting_alloc_context.num_allocations;
+
+        reliable_endpoint_send_packet_with_headroom( context.sender, packet_data, packet_bytes );
+
+        if ( packet_bytes <= sender_config.fragment_above )
+        {
+            check( counting_alloc_context.num_allocations == num_allocations );
+            num_regular_packets++;
+        }
+        else
+        {
+            num_fragmented_packets++;
+        }
+
+        reliable_endpoint_update( context.sender, time );
+        reliable_endpoint_update( context.receiver, time );
+
+        time += delta_time;
+    }
+
+    check( num_regular_packets > 0 );
+    check( num_fragmented_packets > 0 );
+
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 32 );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_INVALID] == 0 );
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+}
+
+static void test_transmit_packet_iov_function( void * _context, uint64_t id, uint16_t sequence, struct reliable_iovec_t * iov, int num_iov )
+{
+    uint8_t packet_data[RELIABLE_FRAGMENT_HEADER_BYTES + RELIABLE_MAX_PACKET_HEADER_BYTES + TEST_MAX_PACKET_BYTES];
+    int packet_bytes = 0;
+    int i;
+    for ( i = 0; i < num_iov; ++i )
+    {
+        check( packet_bytes + iov[i].bytes <= (int) sizeof( packet_data ) );
+        memcpy( packet_data + packet_bytes, iov[i].data, iov[i].bytes );
+        packet_bytes += iov[i].bytes;
+    }
+    test_transmit_packet_function( _context, id, sequence, packet_data, packet_bytes );
+}
+
+void test_packets_iov()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+
+    struct test_counting_allocate_context_t counting_alloc_context;
+    memset( &counting_alloc_context, 0, sizeof( counting_alloc_context ) );
+
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    sender_config.fragment_above = 500;
+    receiver_config.fragment_above = 500;
+
+    sender_config.allocator_context = &counting_alloc_context;
+    sender_config.allocate_function = &test_counting_allocate_function;
+    sender_config.free_function = &test_counting_free_function;
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_iov_function = &test_transmit_packet_iov_function;
+    sender_config.process_packet_function = &test_process_packet_function_validate;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_iov_function = &test_transmit_packet_iov_function;
+    receiver_config.process_packet_function = &test_process_packet_function_validate;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    double delta_time = 0.1;
+
+    int num_allocations = counting_alloc_context.num_allocations;
+
+    int i;
+    for ( i = 0; i < 32; ++i )
+    {
+        uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+        uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
+        int packet_bytes = generate_packet_data( sequence, packet_data );
+        reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+
+        reliable_endpoint_update( context.sender, time );
+        reliable_endpoint_update( context.receiver, time );
+
+        time += delta_time;
+    }
+
+    check( counting_alloc_context.num_allocations == num_allocations );
+
+    RELIABLE_CONST uint64_t * sender_counters = reliable_endpoint_counters( context.sender );
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+    check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT] > 0 );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_RECEIVED] == sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT] );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 32 );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID] == 0 );
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+}
+
+static int test_num_transmit_packets_calls;
+
+static void test_transmit_packets_function( void * _context, uint64_t id, uint16_t * sequences, struct reliable_iovec_t * iov, int num_datagrams )
+{
+    check( num_datagrams > 0 );
+    check( num_datagrams <= RELIABLE_MAX_BATCH_DATAGRAMS );
+    test_num_transmit_packets_calls++;
+    int i;
+    for ( i = 0; i < num_datagrams; ++i )
+    {
+        test_transmit_packet_iov_function( _context, id, sequences[i], iov + i*2, 2 );
+    }
+}
+
+void test_packets_batch()
+{
+    #define TEST_BATCH_NUM_PACKETS 8
+
+    uint8_t packet_buffer[TEST_BATCH_NUM_PACKETS][TEST_MAX_PACKET_BYTES];
+    uint8_t * packet_data[TEST_BATCH_NUM_PACKETS];
+    int packet_bytes[TEST_BATCH_NUM_PACKETS];
+
+    int i;
+    for ( i = 0; i < TEST_BATCH_NUM_PACKETS; ++i )
+    {
+        packet_data[i] = packet_buffer[i];
+        packet_bytes[i] = generate_packet_data( (uint16_t) i, packet_data[i] );
+    }
+
+    // the second pass has no batch callback, so every datagram goes through transmit packet function instead
+
+    int batch_callback;
+    for ( batch_callback = 1; batch_callback >= 0; --batch_callback )
+    {
+        double time = 100.0;
+
+        struct test_context_t context;
+        test_default_context( &context );
+
+        struct reliable_config_t sender_config;
+        struct reliable_config_t receiver_config;
+
+        reliable_default_config( &sender_config );
+        reliable_default_config( &receiver_config );
+
+        sender_config.fragment_above = 500;
+        receiver_config.fragment_above = 500;
+
+        reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+        sender_config.context = &context;
+        sender_config.id = 0;
+        sender_config.transmit_packet_function = &test_transmit_packet_function;
+        sender_config.transmit_packets_function = batch_callback ? &test_transmit_packets_function : NULL;
+        sender_config.process_packet_function = &test_process_packet_function_validate;
+
+        reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+        receiver_config.context = &context;
+        receiver_config.id = 1;
+        receiver_config.transmit_packet_function = &test_transmit_packet_function;
+        receiver_config.process_packet_function = &test_process_packet_function_validate;
+
+        context.sender = reliable_endpoint_create( &sender_config, time );
+        context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+        test_num_transmit_packets_calls = 0;
+
+        reliable_endpoint_send_packets( context.sender, packet_data, packet_bytes, TEST_BATCH_NUM_PACKETS );
+
+        check( test_num_transmit_packets_calls == batch_callback );
+
+        RELIABLE_CONST uint64_t * sender_counters = reliable_endpoint_counters( context.sender );
+        RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+        check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_SENT] == TEST_BATCH_NUM_PACKETS );
+        check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT] > 0 );
+        check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == TEST_BATCH_NUM_PACKETS );
+        check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_INVALID] == 0 );
+        check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID] == 0 );
+
+        reliable_endpoint_destroy( context.sender );
+        reliable_endpoint_destroy( context.receiver );
+    }
+}
+
+static int test_num_transmit_packet_gso_calls;
+
+static void test_transmit_packet_gso_function( void * _context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes, int segment_bytes )
+{
+    check( packet_bytes > 0 );
+    check( segment_bytes > 0 );
+    check( packet_bytes <= RELIABLE_MAX_GSO_BYTES );
+    check( ( packet_bytes + segment_bytes - 1 ) / segment_bytes <= RELIABLE_MAX_GSO_SEGMENTS );
+    test_num_transmit_packet_gso_calls++;
+    while ( packet_bytes > 0 )
+    {
+        int bytes = packet_bytes < segment_bytes ? packet_bytes : segment_bytes;
+        test_transmit_packet_function( _context, id, sequence, packet_data, bytes );
+        packet_data += bytes;
+        packet_bytes -= bytes;
+    }
+}
+
+void test_packets_gso()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    sender_config.fragment_above = 500;
+    receiver_config.fragment_above = 500;
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.transmit_packet_gso_function = &test_transmit_packet_gso_function;
+    sender_config.process_packet_function = &test_process_packet_function_validate;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function_validate;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    test_num_transmit_packet_gso_calls = 0;
+
+    int num_multi_fragment_packets = 0;
+
+    int i;
+    for ( i = 0; i < 32; ++i )
+    {
+        uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+        uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
+        int packet_bytes = generate_packet_data( sequence, packet_data );
+        reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+
+        if ( packet_bytes > sender_config.fragment_above && packet_bytes > sender_config.fragment_size )
+        {
+            num_multi_fragment_packets++;
+        }
+
+        reliable_endpoint_update( context.sender, time );
+        reliable_endpoint_update( context.receiver, time );
+
+        time += 0.1;
+    }
+
+    check( num_multi_fragment_packets > 0 );
+    check( test_num_transmit_packet_gso_calls == num_multi_fragment_packets );
+
+    RELIABLE_CONST uint64_t * sender_counters = reliable_endpoint_counters( context.sender );
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_RECEIVED] == sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT] );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 32 );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID] == 0 );
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+}
+
+#define TEST_GSO_MAX_FRAGMENTS 100
+
+static int test_process_packet_function_gso_large( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) context;
+    (void) id;
+
+    int i;
+    for ( i = 0; i < packet_bytes; ++i )
+    {
+        check( packet_data[i] == (uint8_t) ( sequence + i ) );
+    }
+
+    return 1;
+}
+
+void test_packets_gso_many_fragments()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    // more fragments than fit in one UDP_SEGMENT send, by segment count and by bytes
+
+    sender_config.max_fragments = TEST_GSO_MAX_FRAGMENTS;
+    sender_config.max_packet_size = TEST_GSO_MAX_FRAGMENTS * sender_config.fragment_size;
+    receiver_config.max_fragments = sender_config.max_fragments;
+    receiver_config.max_packet_size = sender_config.max_packet_size;
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.transmit_packet_gso_function = &test_transmit_packet_gso_function;
+    sender_config.process_packet_function = &test_process_packet_function_gso_large;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function_gso_large;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    test_num_transmit_packet_gso_calls = 0;
+
+    static uint8_t packet_data[TEST_GSO_MAX_FRAGMENTS * 1024];
+
+    int packet_sizes[] = { sender_config.max_packet_size, sender_config.max_packet_size - 100, 65 * sender_config.fragment_size };
+
+    int num_fragments_sent = 0;
+
+    int i;
+    for ( i = 0; i < (int) ( sizeof( packet_sizes ) / sizeof( packet_sizes[0] ) ); ++i )
+    {
+        uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
+        int j;
+        for ( j = 0; j < packet_sizes[i]; ++j )
+        {
+            packet_data[j] = (uint8_t) ( sequence + j );
+        }
+
+        reliable_endpoint_send_packet( context.sender, packet_data, packet_sizes[i] );
+
+        num_fragments_sent += ( packet_sizes[i] + sender_config.fragment_size - 1 ) / sender_config.fragment_size;
+
+        reliable_endpoint_update( context.sender, time );
+        reliable_endpoint_update( context.receiver, time );
+
+        time += 0.1;
+    }
+
+    // each packet sends fragment 0 on its own, then the rest in two GSO calls
+
+    check( test_num_transmit_packet_gso_calls == 6 );
+
+    RELIABLE_CONST uint64_t * sender_counters = reliable_endpoint_counters( context.sender );
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+    check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT] == (uint64_t) num_fragments_sent );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_RECEIVED] == (uint64_t) num_fragments_sent );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 3 );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID] == 0 );
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+}
+
+void test_packets_builder()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+
+    struct test_counting_allocate_context_t counting_alloc_context;
+    memset( &counting_alloc_context, 0, sizeof( counting_alloc_context ) );
+
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    sender_config.fragment_above = 500;
+    receiver_config.fragment_above = 500;
+
+    sender_config.allocator_context = &counting_alloc_context;
+    sender_config.allocate_function = &test_counting_allocate_function;
+    sender_config.free_function = &test_counting_free_function;
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function_validate;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function_validate;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    check( reliable_endpoint_begin_packet( context.sender, sender_config.max_packet_size + 1 ) == NULL );
+
+    double delta_time = 0.1;
+
+    int num_regular_packets = 0;
+    int num_fragmented_packets = 0;
+
+    int i;
+    for ( i = 0; i < 32; ++i )
+    {
+        uint8_t * packet_data = reliable_endpoint_begin_packet( context.sender, TEST_MAX_PACKET_BYTES );
+        check( packet_data );
+
+        uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
+        int packet_bytes = generate_packet_data( sequence, packet_data );
+
+        int num_allocations = counting_alloc_context.num_allocations;
+
+        reliable_endpoint_commit_packet( context.sender, packet_bytes );
+
+        if ( packet_bytes <= sender_config.fragment_above )
+        {
+            check( counting_alloc_context.num_allocations == num_allocations );
+            num_regular_packets++;
+        }
+        else
+        {
+            num_fragmented_packets++;
+        }
+
+        reliable_endpoint_update( context.sender, time );
+        reliable_endpoint_update( context.receiver, time );
+
+        time += delta_time;
+    }
+
+    check( num_regular_packets > 0 );
+    check( num_fragmented_packets > 0 );
+
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 32 );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_INVALID] == 0 );
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+}
+
+void test_received_bits_reset()
+{
+    // generating ack bits again without new packets doesn't change the received bits, and reset clears them
+
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    uint8_t packet_data[8];
+    memset( packet_data, 0, sizeof( packet_data ) );
+
+    uint16_t ack, expected_ack;
+    uint64_t ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+    uint32_t expected_ack_bits;
+
+    int i;
+    for ( i = 0; i < 200; ++i )
+    {
+        // drop some packets so the ack bits have holes in them
+
+        context.drop = ( i % 5 ) == 0 || ( i % 7 ) == 0;
+
+        reliable_endpoint_send_packet( context.sender, packet_data, sizeof( packet_data ) );
+
+        context.drop = 1;
+
+        int j;
+        for ( j = 0; j < 3; ++j )
+        {
+            reliable_endpoint_generate_ack_bits( context.receiver, &ack, ack_bits );
+            reliable_sequence_buffer_generate_ack_bits( context.receiver->received_packets, &expected_ack, &expected_ack_bits );
+            check( ack == expected_ack );
+            check( ack_bits[0] == expected_ack_bits );
+            reliable_endpoint_send_packet( context.receiver, packet_data, sizeof( packet_data ) );
+        }
+    }
+
+    reliable_endpoint_reset( context.receiver );
+
+    reliable_endpoint_generate_ack_bits( context.receiver, &ack, ack_bits );
+    reliable_sequence_buffer_generate_ack_bits( context.receiver->received_packets, &expected_ack, &expected_ack_bits );
+    check( ack == expected_ack );
+    check( ack_bits[0] == expected_ack_bits );
+    check( ack_bits[0] == 0 );
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+}
+
+void test_fragment_pacing()
+{
+    int pass;
+    for ( pass = 0; pass < 2; ++pass )
+    {
+        double time = 100.0;
+
+        struct test_context_t context;
+        test_default_context( &context );
+
+        struct reliable_config_t sender_config;
+        struct reliable_config_t receiver_config;
+
+        reliable_default_config( &sender_config );
+        reliable_default_config( &receiver_config );
+
+        // release roughly one fragment per 10ms update, either from a fixed rate or from the rtt (100ms until measured)
+
+        if ( pass == 0 )
+        {
+            sender_config.fragment_pacing_kbps = 1100 * 8 * 100 / 1000.0f;
+        }
+        else
+        {
+            sender_config.fragment_pacing_bytes_per_rtt = 1100 * 10;
+        }
+
+        reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+        sender_config.context = &context;
+        sender_config.id = 0;
+        sender_config.transmit_packet_function = &test_transmit_packet_function;
+        sender_config.process_packet_function = &test_process_packet_function;
+
+        reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+        receiver_config.context = &context;
+        receiver_config.id = 1;
+        receiver_config.transmit_packet_function = &test_transmit_packet_function;
+        receiver_config.process_packet_function = &test_process_packet_function;
+
+        context.sender = reliable_endpoint_create( &sender_config, time );
+        context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+        uint8_t packet_data[8*1024];
+        memset( packet_data, 0, sizeof( packet_data ) );
+
+        reliable_endpoint_send_packet( context.sender, packet_data, sizeof( packet_data ) );
+
+        RELIABLE_CONST uint64_t * sender_counters = reliable_endpoint_counters( context.sender );
+        RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+
+        check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_QUEUED] == 8 );
+        check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT] == 1 );
+        check( reliable_endpoint_num_queued_fragments( context.sender ) == 7 );
+
+        int num_updates = 0;
+
+        while ( reliable_endpoint_num_queued_fragments( context.sender ) > 0 )
+        {
+            uint64_t num_fragments_sent = sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT];
+
+            time += 0.01;
+
+            reliable_endpoint_update( context.sender, time );
+            reliable_endpoint_update( context.receiver, time );
+
+            check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT] - num_fragments_sent <= 2 );
+
+            num_updates++;
+            check( num_updates < 100 );
+        }
+
+        check( num_updates >= 4 );
+        check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT] == 8 );
+        check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_RECEIVED] == 8 );
+        check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 1 );
+
+        reliable_endpoint_destroy( context.sender );
+        reliable_endpoint_destroy( context.receiver );
+    }
+}
+
+#define TEST_RETAINED_MAX_PACKETS 32
+
+static int test_num_retained_packets;
+static uint8_t * test_retained_packet_data[TEST_RETAINED_MAX_PACKETS];
+static int test_retained_packet_bytes[TEST_RETAINED_MAX_PACKETS];
+
+static int test_process_reassembled_packet_function_retain( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) context;
+    (void) id;
+    (void) sequence;
+
+    validate_packet_data( packet_data, packet_bytes );
+
+    check( test_num_retained_packets < TEST_RETAINED_MAX_PACKETS );
+
+    test_retained_packet_data[test_num_retained_packets] = packet_data;
+    test_retained_packet_bytes[test_num_retained_packets] = packet_bytes;
+    test_num_retained_packets++;
+
+    return RELIABLE_PACKET_RETAINED;
+}
+
+void test_fragment_retained()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+
+    struct test_counting_allocate_context_t counting_alloc_context;
+    memset( &counting_alloc_context, 0, sizeof( counting_alloc_context ) );
+
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    sender_config.fragment_above = 500;
+    receiver_config.fragment_above = 500;
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function_validate;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function_validate;
+    receiver_config.process_reassembled_packet_function = &test_process_reassembled_packet_function_retain;
+    receiver_config.allocator_context = &counting_alloc_context;
+    receiver_config.allocate_function = &test_counting_allocate_function;
+    receiver_config.free_function = &test_counting_free_function;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    test_num_retained_packets = 0;
+
+    int num_fragmented_packets = 0;
+
+    int i;
+    for ( i = 0; i < TEST_RETAINED_MAX_PACKETS; ++i )
+    {
+        uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+        uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
+        int packet_bytes = generate_packet_data( sequence, packet_data );
+
+        reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+
+        if ( packet_bytes > sender_config.fragment_above )
+        {
+            num_fragmented_packets++;
+        }
+
+        reliable_endpoint_update( context.sender, time );
+        reliable_endpoint_update( context.receiver, time );
+
+        time += 0.1;
+    }
+
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == TEST_RETAINED_MAX_PACKETS );
+
+    // the retained packets stay valid after the endpoint is done with them, until the application frees them
+
+    check( num_fragmented_packets > 0 );
+    check( test_num_retained_packets == num_fragmented_packets );
+
+    for ( i = 0; i < test_num_retained_packets; ++i )
+    {
+        validate_packet_data( test_retained_packet_data[i], test_retained_packet_bytes[i] );
+        reliable_endpoint_free_packet( context.receiver, test_retained_packet_data[i] );
+    }
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+
+    check( counting_alloc_context.num_allocations == counting_alloc_context.num_frees );
+}
+
+#define TEST_CAPTURE_MAX_DATAGRAMS 1024
+
+struct test_capture_context_t
+{
+    int num_datagrams;
+    uint8_t * datagram_data[TEST_CAPTURE_MAX_DATAGRAMS];
+    int datagram_bytes[TEST_CAPTURE_MAX_DATAGRAMS];
+};
+
+static void test_transmit_packet_function_capture( void * _context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) id;
+    (void) sequence;
+    struct test_capture_context_t * context = (struct test_capture_context_t*) _context;
+    check( context->num_datagrams < TEST_CAPTURE_MAX_DATAGRAMS );
+    context->datagram_data[context->num_datagrams] = (uint8_t*) malloc( packet_bytes );
+    memcpy( context->datagram_data[context->num_datagrams], packet_data, packet_bytes );
+    context->datagram_bytes[context->num_datagrams] = packet_bytes;
+    context->num_datagrams++;
+}
+
+static void test_deliver_captured_datagrams( struct test_capture_context_t * context, struct reliable_endpoint_t * endpoint, int batch )
+{
+    if ( batch )
+    {
+        reliable_endpoint_receive_packets( endpoint, context->datagram_data, context->datagram_bytes, context->num_datagrams );
+    }
+    else
+    {
+        int i;
+        for ( i = 0; i < context->num_datagrams; ++i )
+        {
+            reliable_endpoint_receive_packet( endpoint, context->datagram_data[i], context->datagram_bytes[i] );
+        }
+    }
+
+    int i;
+    for ( i = 0; i < context->num_datagrams; ++i )
+    {
+        free( context->datagram_data[i] );
+    }
+
+    context->num_datagrams = 0;
+}
+
+static int test_num_process_packets_calls;
+
+static void test_process_packets_function_validate( void * context, uint64_t id, uint16_t * sequences, uint8_t ** packet_data, int * packet_bytes, int * results, int num_packets )
+{
+    (void) context;
+    (void) id;
+    (void) sequences;
+
+    int i;
+    for ( i = 0; i < num_packets; ++i )
+    {
+        validate_packet_data( packet_data[i], packet_bytes[i] );
+        results[i] = 1;
+    }
+
+    test_num_process_packets_calls++;
+}
+
+static int test_compare_acks( const void * a, const void * b )
+{
+    return (int) *( (const uint16_t*) a ) - (int) *( (const uint16_t*) b );
+}
+
+void test_packets_receive_batch()
+{
+    // receive the same traffic one packet at a time, in batches, and in batches through process_packets_function. 
+    // the packets received, the counters and the set of acks must be the same in all three cases.
+    // this runs once with the default ack window, and once with the receiver sending a wide ack window.
+
+    uint64_t expected_counters[2][RELIABLE_ENDPOINT_NUM_COUNTERS];
+    uint16_t expected_acks[256];
+    int expected_num_acks = 0;
+
+    int pass;
+    for ( pass = 0; pass < 6; ++pass )
+    {
+        int mode = pass % 3;
+
+        double time = 100.0;
+
+        struct test_capture_context_t sender_capture;
+        struct test_capture_context_t receiver_capture;
+        memset( &sender_capture, 0, sizeof( sender_capture ) );
+        memset( &receiver_capture, 0, sizeof( receiver_capture ) );
+
+        struct reliable_config_t sender_config;
+        struct reliable_config_t receiver_config;
+
+        reliable_default_config( &sender_config );
+        reliable_default_config( &receiver_config );
+
+        sender_config.fragment_above = 500;
+        receiver_config.fragment_above = 500;
+
+        reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+        sender_config.context = &sender_capture;
+        sender_config.id = 0;
+        sender_config.transmit_packet_function = &test_transmit_packet_function_capture;
+        sender_config.process_packet_function = &test_process_packet_function_validate;
+
+        reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+        receiver_config.context = &receiver_capture;
+        receiver_config.id = 1;
+        receiver_config.transmit_packet_function = &test_transmit_packet_function_capture;
+        receiver_config.process_packet_function = &test_process_packet_function_validate;
+
+        if ( pass >= 3 )
+        {
+            receiver_config.ack_window_bits = RELIABLE_MAX_ACK_WINDOW_BITS;
+        }
+
+        if ( mode == 2 )
+        {
+            sender_config.process_packets_function = &test_process_packets_function_validate;
+            receiver_config.process_packets_function = &test_process_packets_function_validate;
+        }
+
+        struct reliable_endpoint_t * sender = reliable_endpoint_create( &sender_config, time );
+        struct reliable_endpoint_t * receiver = reliable_endpoint_create( &receiver_config, time );
+
+        test_num_process_packets_calls = 0;
+
+        // the receiver replies after every few packets, so the replies carry different acks
+
+        int i;
+        for ( i = 0; i < 64; ++i )
+        {
+            uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+            uint16_t sequence = reliable_endpoint_next_packet_sequence( sender );
+            int packet_bytes = generate_packet_data( sequence, packet_data );
+            reliable_endpoint_send_packet( sender, packet_data, packet_bytes );
+
+            if ( ( i % 4 ) == 3 )
+            {
+                test_deliver_captured_datagrams( &sender_capture, receiver, mode != 0 );
+
+                sequence = reliable_endpoint_next_packet_sequence( receiver );
+                packet_bytes = generate_packet_data( sequence, packet_data );
+                reliable_endpoint_send_packet( receiver, packet_data, packet_bytes );
+            }
+        }
+
+        test_deliver_captured_datagrams( &receiver_capture, sender, mode != 0 );
+
+        int num_acks;
+        uint16_t * acks = reliable_endpoint_get_acks( sender, &num_acks );
+        check( num_acks > 0 );
+        check( num_acks <= 256 );
+        qsort( acks, num_acks, sizeof( uint16_t ), test_compare_acks );
+
+        RELIABLE_CONST uint64_t * sender_counters = reliable_endpoint_counters( sender );
+        RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( receiver );
+
+        check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 64 );
+        check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 16 );
+
+        if ( mode == 0 )
+        {
+            memcpy( expected_counters[0], sender_counters, sizeof( expected_counters[0] ) );
+            memcpy( expected_counters[1], receiver_counters, sizeof( expected_counters[1] ) );
+            memcpy( expected_acks, acks, num_acks * sizeof( uint16_t ) );
+            expected_num_acks = num_acks;
+        }
+        else
+        {
+            check( memcmp( expected_counters[0], sender_counters, sizeof( expected_counters[0] ) ) == 0 );
+            check( memcmp( expected_counters[1], receiver_counters, sizeof( expected_counters[1] ) ) == 0 );
+            check( num_acks == expected_num_acks );
+            check( memcmp( expected_acks, acks, num_acks * sizeof( uint16_t ) ) == 0 );
+        }
+
+        if ( mode == 2 )
+        {
+            check( test_num_process_packets_calls > 0 );
+        }
+
+        reliable_endpoint_destroy( sender );
+        reliable_endpoint_destroy( receiver );
+    }
+}
+
+#define TEST_DEFERRED_MAX_PACKETS 16
+
+static int test_num_deferred_packets;
+static uint16_t test_deferred_sequence[TEST_DEFERRED_MAX_PACKETS];
+
+static int test_process_packet_function_defer( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) context;
+    (void) id;
+
+    // a real application would copy the payload into a queue for worker threads here
+
+    validate_packet_data( packet_data, packet_bytes );
+
+    check( test_num_deferred_packets < TEST_DEFERRED_MAX_PACKETS );
+
+    test_deferred_sequence[test_num_deferred_packets++] = sequence;
+
+    return RELIABLE_PACKET_DEFERRED;
+}
+
+void test_packets_deferred()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function_validate;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function_defer;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    test_num_deferred_packets = 0;
+
+    uint8_t packet_data[RELIABLE_MAX_PACKET_HEADER_BYTES + TEST_MAX_PACKET_BYTES];
+
+    int i;
+    for ( i = 0; i < TEST_DEFERRED_MAX_PACKETS; ++i )
+    {
+        uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
+        int packet_bytes = generate_packet_data( sequence, packet_data );
+        reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+    }
+
+    // deferred packets are not acked until they are committed
+
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+
+    check( test_num_deferred_packets == TEST_DEFERRED_MAX_PACKETS );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_DEFERRED] == TEST_DEFERRED_MAX_PACKETS );
+
+    for ( i = 0; i < TEST_DEFERRED_MAX_PACKETS; ++i )
+    {
+        check( test_deferred_sequence[i] == (uint16_t) i );
+        check( !reliable_sequence_buffer_exists( context.receiver->received_packets, (uint16_t) i ) );
+    }
+
+    // a duplicate of a packet that is still deferred is ignored
+
+    int packet_header_bytes = reliable_write_packet_header( packet_data, 3, 0, 0 );
+    int packet_bytes = generate_packet_data( 3, packet_data + packet_header_bytes );
+    reliable_endpoint_receive_packet( context.receiver, packet_data, packet_header_bytes + packet_bytes );
+
+    check( test_num_deferred_packets == TEST_DEFERRED_MAX_PACKETS );
+
+    // commit even packets as processed and odd packets as failed. only the even packets get acked
+
+    for ( i = 0; i < TEST_DEFERRED_MAX_PACKETS; ++i )
+    {
+        reliable_endpoint_commit_received( context.receiver, test_deferred_sequence[i], ( i % 2 ) == 0 );
+    }
+
+    reliable_endpoint_commit_received( context.receiver, 0, 1 );
+
+    for ( i = 0; i < TEST_DEFERRED_MAX_PACKETS; ++i )
+    {
+        check( reliable_sequence_buffer_exists( context.receiver->received_packets, (uint16_t) i ) == ( ( i % 2 ) == 0 ) );
+    }
+
+    uint16_t sequence = reliable_endpoint_next_packet_sequence( context.receiver );
+    packet_bytes = generate_packet_data( sequence, packet_data );
+    reliable_endpoint_send_packet( context.receiver, packet_data, packet_bytes );
+
+    int num_acks;
+    uint16_t * acks = reliable_endpoint_get_acks( context.sender, &num_acks );
+    check( num_acks == TEST_DEFERRED_MAX_PACKETS / 2 );
+    for ( i = 0; i < num_acks; ++i )
+    {
+        check( ( acks[i] % 2 ) == 0 );
+    }
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+}
+
+void test_peek_datagram()
+{
+    struct reliable_datagram_info_t info;
+
+    // regular packet
+
+    uint8_t packet_data[RELIABLE_MAX_PACKET_HEADER_BYTES + 16];
+    memset( packet_data, 0, sizeof( packet_data ) );
+
+    int packet_header_bytes = reliable_write_packet_header( packet_data, 1000, 990, 0xFFFFFF0F );
+
+    check( reliable_peek_datagram( packet_data, packet_header_bytes + 16, &info ) == RELIABLE_OK );
+    check( info.type == RELIABLE_DATAGRAM_PACKET );
+    check( info.sequence == 1000 );
+    check( info.has_ack );
+    check( info.ack == 990 );
+    check( info.ack_bits == 0xFFFFFF0F );
+    check( info.fragment_id == 0 );
+    check( info.num_fragments == 1 );
+    check( info.header_bytes == packet_header_bytes );
+
+    check( reliable_peek_datagram( packet_data, packet_header_bytes - 1, &info ) == RELIABLE_ERROR );
+    check( reliable_peek_datagram( packet_data, 0, &info ) == RELIABLE_ERROR );
+
+    // fragments of a packet sent through an endpoint
+
+    struct test_capture_context_t capture;
+    memset( &capture, 0, sizeof( capture ) );
+
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.fragment_above = 500;
+    config.fragment_size = 500;
+    config.context = &capture;
+    config.transmit_packet_function = &test_transmit_packet_function_capture;
+    config.process_packet_function = &test_process_packet_function_validate;
+
+    struct reliable_endpoint_t * endpoint = reliable_endpoint_create( &config, 100.0 );
+
+    uint8_t fragmented_packet_data[TEST_MAX_PACKET_BYTES];
+    int fragmented_packet_bytes = generate_packet_data( 0, fragmented_packet_data );
+    while ( fragmented_packet_bytes <= config.fragment_above )
+    {
+        uint16_t sequence = reliable_endpoint_next_packet_sequence( endpoint );
+        fragmented_packet_bytes = generate_packet_data( sequence, fragmented_packet_data );
+        reliable_endpoint_send_packet( endpoint, fragmented_packet_data, fragmented_packet_bytes );
+        if ( fragmented_packet_bytes <= config.fragment_above )
+        {
+            check( reliable_peek_datagram( capture.datagram_data[0], capture.datagram_bytes[0], &info ) == RELIABLE_OK );
+            check( info.type == RELIABLE_DATAGRAM_PACKET );
+            check( info.sequence == sequence );
+            free( capture.datagram_data[0] );
+            capture.num_datagrams = 0;
+        }
+    }
+
+    uint16_t fragmented_sequence = reliable_endpoint_next_packet_sequence( endpoint ) - 1;
+    int num_fragments = ( fragmented_packet_bytes + config.fragment_size - 1 ) / config.fragment_size;
+
+    check( capture.num_datagrams == num_fragments );
+
+    int i;
+    for ( i = 0; i < capture.num_datagrams; ++i )
+    {
+        check( reliable_peek_datagram( capture.datagram_data[i], capture.datagram_bytes[i], &info ) == RELIABLE_OK );
+        check( info.type == RELIABLE_DATAGRAM_FRAGMENT );
+        check( info.sequence == fragmented_sequence );
+        check( info.fragment_id == i );
+        check( info.num_fragments == num_fragments );
+        check( info.has_ack == ( i == 0 ) );
+        check( info.header_bytes >= RELIABLE_FRAGMENT_HEADER_BYTES );
+        check( info.header_bytes <= RELIABLE_FRAGMENT_HEADER_BYTES + RELIABLE_MAX_PACKET_HEADER_BYTES );
+    }
+
+    // fragment id out of range, and a truncated fragment header
+
+    capture.datagram_data[0][3] = (uint8_t) num_fragments;
+    check( reliable_peek_datagram( capture.datagram_data[0], capture.datagram_bytes[0], &info ) == RELIABLE_ERROR );
+    check( reliable_peek_datagram( capture.datagram_data[1], RELIABLE_FRAGMENT_HEADER_BYTES - 1, &info ) == RELIABLE_ERROR );
+
+    for ( i = 0; i < capture.num_datagrams; ++i )
+    {
+        free( capture.datagram_data[i] );
+    }
+
+    reliable_endpoint_destroy( endpoint );
+}
+
+void test_fragment_pool()
+{
+    double time = 100.0;
+
+    struct test_context_t context;
+    test_default_context( &context );
+
+    struct test_counting_allocate_context_t counting_alloc_context;
+    memset( &counting_alloc_context, 0, sizeof( counting_alloc_context ) );
+
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
+
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
+
+    sender_config.fragment_above = 500;
+    receiver_config.fragment_above = 500;
+
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function_validate;
+
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function_validate;
+    receiver_config.fragment_reassembly_max_bytes = 2 * receiver_config.max_fragments * receiver_config.fragment_size;
+    receiver_config.allocator_context = &counting_alloc_context;
+    receiver_config.allocate_function = &test_counting_allocate_function;
+    receiver_config.free_function = &test_counting_free_function;
+
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+    // the last fragment of many packets that never complete. only two are reassembled at a time, the rest are dropped
+
+    int i;
+    for ( i = 0; i < 10; ++i )
+    {
+        uint8_t fragment_data[RELIABLE_FRAGMENT_HEADER_BYTES + 16];
+        memset( fragment_data, 0, sizeof( fragment_data ) );
+        uint8_t * p = fragment_data;
+        reliable_write_uint8( &p, 1 );
+        reliable_write_uint16( &p, (uint16_t) ( 1000 + i ) );
+        reliable_write_uint8( &p, 1 );
+        reliable_write_uint8( &p, 1 );
+        reliable_endpoint_receive_packet( context.receiver, fragment_data, sizeof( fragment_data ) );
     }
 
-    // calculate received bandwidth
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_RECEIVED] == 2 );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_REASSEMBLY_FULL] == 8 );
+
+    reliable_endpoint_reset( context.receiver );
+
+    // once the pool is warm, reassembly doesn't allocate
+
+    int num_fragmented_packets = 0;
+    int num_allocations = 0;
+
+    for ( i = 0; i < 64; ++i )
     {
-        uint32_t base_sequence = ( endpoint->received_packets->sequence - endpoint->config.received_packets_buffer_size + 1 ) + 0xFFFF;
-        int i;
-        int bytes_sent = 0;
-        double start_time = FLT_MAX;
-        double finish_time = 0.0;
-        int num_samples = endpoint->config.received_packets_buffer_size / 2;
-        for ( i = 0; i < num_samples; ++i )
-        {
-            uint16_t sequence = (uint16_t) ( base_sequence + i );
-            struct reliable_received_packet_data_t * received_packet_data = (struct reliable_received_packet_data_t*) 
-                reliable_sequence_buffer_find( endpoint->received_packets, sequence );
-            if ( !received_packet_data )
-            {
-                continue;
-            }
-            bytes_sent += received_packet_data->packet_bytes;
-            if ( received_packet_data->time < start_time )
-            {
-                start_time = received_packet_data->time;
-            }
-            if ( received_packet_data->time > finish_time )
-            {
-                finish_time = received_packet_data->time;
-            }
-        }
-        if ( start_time != FLT_MAX && finish_time != 0.0 )
+        uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+        uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
+        int packet_bytes = generate_packet_data( sequence, packet_data );
+
+        reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+
+        if ( packet_bytes > sender_config.fragment_above )
         {
-            float received_bandwidth_kbps = (float) ( ( (double) bytes_sent ) / ( finish_time - start_time ) * 8.0f / 1000.0f );
-            if ( fabs( endpoint->received_bandwidth_kbps - received_bandwidth_kbps ) > 0.00001 )
+            if ( num_fragmented_packets++ == 0 )
             {
-                endpoint->received_bandwidth_kbps += ( received_bandwidth_kbps - endpoint->received_bandwidth_kbps ) * endpoint->config.bandwidth_smoothing_factor;
-            }
-            else
-            {
-                endpoint->received_bandwidth_kbps = received_bandwidth_kbps;
+                num_allocations = counting_alloc_context.num_allocations;
             }
         }
+
+        reliable_endpoint_update( context.sender, time );
+        reliable_endpoint_update( context.receiver, time );
+
+        time += 0.1;
     }
 
-    // calculate acked bandwidth
+    check( num_fragmented_packets > 1 );
+    check( counting_alloc_context.num_allocations == num_allocations );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 64 );
+
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
+
+    check( counting_alloc_context.num_allocations == counting_alloc_context.num_frees );
+}
+
+void test_fragment_bitmap()
+{
+    // a packet with fragments in every word of the fragment bitmap, received in reverse order with duplicates
+
+    struct test_capture_context_t capture;
+    memset( &capture, 0, sizeof( capture ) );
+
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.max_packet_size = TEST_MAX_PACKET_BYTES;
+    config.fragment_above = 16;
+    config.fragment_size = 16;
+    config.max_fragments = 256;
+    config.context = &capture;
+    config.transmit_packet_function = &test_transmit_packet_function_capture;
+    config.process_packet_function = &test_process_packet_function_validate;
+
+    struct reliable_endpoint_t * sender = reliable_endpoint_create( &config, 100.0 );
+    struct reliable_endpoint_t * receiver = reliable_endpoint_create( &config, 100.0 );
+
+    uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+    int packet_bytes = 0;
+
+    while ( packet_bytes <= 192 * config.fragment_size )
     {
-        uint32_t base_sequence = ( endpoint->sent_packets->sequence - endpoint->config.sent_packets_buffer_size + 1 ) + 0xFFFF;
         int i;
-        int bytes_sent = 0;
-        double start_time = FLT_MAX;
-        double finish_time = 0.0;
-        int num_samples = endpoint->config.sent_packets_buffer_size / 2;
-        for ( i = 0; i < num_samples; ++i )
+        for ( i = 0; i < capture.num_datagrams; ++i )
         {
-            uint16_t sequence = (uint16_t) ( base_sequence + i );
-            struct reliable_sent_packet_data_t * sent_packet_data = (struct reliable_sent_packet_data_t*) 
-                reliable_sequence_buffer_find( endpoint->sent_packets, sequence );
-            if ( !sent_packet_data || !sent_packet_data->acked )
-            {
-                continue;
-            }
-            bytes_sent += sent_packet_data->packet_bytes;
-            if ( sent_packet_data->time < start_time )
-            {
-                start_time = sent_packet_data->time;
-            }
-            if ( sent_packet_data->time > finish_time )
-            {
-                finish_time = sent_packet_data->time;
-            }
+            free( capture.datagram_data[i] );
         }
-        if ( start_time != FLT_MAX && finish_time != 0.0 )
+        capture.num_datagrams = 0;
+
+        uint16_t sequence = reliable_endpoint_next_packet_sequence( sender );
+        packet_bytes = generate_packet_data( sequence, packet_data );
+        reliable_endpoint_send_packet( sender, packet_data, packet_bytes );
+    }
+
+    int num_fragments = capture.num_datagrams;
+    check( num_fragments > 192 );
+
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( receiver );
+
+    int i;
+    for ( i = num_fragments - 1; i >= 0; --i )
+    {
+        reliable_endpoint_receive_packet( receiver, capture.datagram_data[i], capture.datagram_bytes[i] );
+        if ( i % 50 == 0 && i > 0 )
         {
-            float acked_bandwidth_kbps = (float) ( ( (double) bytes_sent ) / ( finish_time - start_time ) * 8.0f / 1000.0f );
-            if ( fabs( endpoint->acked_bandwidth_kbps - acked_bandwidth_kbps ) > 0.00001 )
-            {
-                endpoint->acked_bandwidth_kbps += ( acked_bandwidth_kbps - endpoint->acked_bandwidth_kbps ) * endpoint->config.bandwidth_smoothing_factor;
-            }
-            else
-            {
-                endpoint->acked_bandwidth_kbps = acked_bandwidth_kbps;
-            }
+            reliable_endpoint_receive_packet( receiver, capture.datagram_data[i], capture.datagram_bytes[i] );
         }
+        check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == (uint64_t) ( i == 0 ) );
     }
-}
 
-float reliable_endpoint_rtt( struct reliable_endpoint_t * endpoint )
-{
-    reliable_assert( endpoint );
-    return endpoint->rtt;
-}
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_RECEIVED] == (uint64_t) num_fragments );
 
-float reliable_endpoint_packet_loss( struct reliable_endpoint_t * endpoint )
-{
-    reliable_assert( endpoint );
-    return endpoint->packet_loss;
-}
+    for ( i = 0; i < capture.num_datagrams; ++i )
+    {
+        free( capture.datagram_data[i] );
+    }
 
-void reliable_endpoint_bandwidth( struct reliable_endpoint_t * endpoint, float * sent_bandwidth_kbps, float * received_bandwidth_kbps, float * acked_bandwidth_kbps )
-{
-    reliable_assert( endpoint );
-    reliable_assert( sent_bandwidth_kbps );
-    reliable_assert( acked_bandwidth_kbps );
-    reliable_assert( received_bandwidth_kbps );
-    *sent_bandwidth_kbps = endpoint->sent_bandwidth_kbps;
-    *received_bandwidth_kbps = endpoint->received_bandwidth_kbps;
-    *acked_bandwidth_kbps = endpoint->acked_bandwidth_kbps;
+    reliable_endpoint_destroy( sender );
+    reliable_endpoint_destroy( receiver );
 }
 
-RELIABLE_CONST uint64_t * reliable_endpoint_counters( struct reliable_endpoint_t * endpoint )
+void test_fragment_reassembly_timeout()
 {
-    reliable_assert( endpoint );
-    return endpoint->counters;
-}
+    double time = 100.0;
 
-void reliable_copy_string( char * dest, RELIABLE_CONST char * source, size_t dest_size )
-{
-    reliable_assert( dest );
-    reliable_assert( source );
-    reliable_assert( dest_size >= 1 );
-    memset( dest, 0, dest_size );
-    for ( size_t i = 0; i < dest_size - 1; i++ )
+    struct test_capture_context_t capture;
+    memset( &capture, 0, sizeof( capture ) );
+
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.fragment_above = 500;
+    config.fragment_size = 500;
+    config.fragment_reassembly_timeout = 1.0f;
+    config.context = &capture;
+    config.transmit_packet_function = &test_transmit_packet_function_capture;
+    config.process_packet_function = &test_process_packet_function_validate;
+
+    struct reliable_endpoint_t * sender = reliable_endpoint_create( &config, time );
+    struct reliable_endpoint_t * receiver = reliable_endpoint_create( &config, time );
+
+    // send a packet with 8 fragments, and deliver all of them except the last
+
+    uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+    generate_packet_data_with_size( 0, packet_data, 8 * config.fragment_size - 100 );
+    reliable_endpoint_send_packet( sender, packet_data, 8 * config.fragment_size - 100 );
+    check( capture.num_datagrams == 8 );
+
+    int i;
+    for ( i = 0; i < 7; ++i )
     {
-        if ( source[i] == '\0' )
-            break;
-        dest[i] = source[i];
+        reliable_endpoint_receive_packet( receiver, capture.datagram_data[i], capture.datagram_bytes[i] );
     }
-}
 
-// ---------------------------------------------------------------
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( receiver );
 
-#if RELIABLE_ENABLE_TESTS
+    time += 0.5;
+    reliable_endpoint_update( receiver, time );
 
-#include <stdio.h>
-#include <stdlib.h>
-#include <memory.h>
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTED_PACKETS_EXPIRED] == 0 );
+    check( receiver->fragment_pool.bytes_in_use > 0 );
 
-static void check_handler( RELIABLE_CONST char * condition, 
-                           RELIABLE_CONST char * function,
-                           RELIABLE_CONST char * file,
-                           int line )
-{
-    printf( "check failed: ( %s ), function %s, file %s, line %d\n", condition, function, file, line );
-#ifdef RELIABLE_DEBUG
-    #if defined( __GNUC__ )
-        __builtin_trap();
-    #elif defined( _MSC_VER )
-        __debugbreak();
-    #endif
-#endif
-    exit( 1 );
+    // once the timeout passes the partial packet is evicted and its buffer goes back to the pool
+
+    time += 0.6;
+    reliable_endpoint_update( receiver, time );
+
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTED_PACKETS_EXPIRED] == 1 );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENT_BYTES_EXPIRED] == (uint64_t) ( 7 * config.fragment_size ) );
+    check( receiver->fragment_pool.bytes_in_use == 0 );
+
+    // the last fragment arriving late starts a new reassembly, so the packet is never completed
+
+    reliable_endpoint_receive_packet( receiver, capture.datagram_data[7], capture.datagram_bytes[7] );
+
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 0 );
+
+    time += 1.1;
+    reliable_endpoint_update( receiver, time );
+
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTED_PACKETS_EXPIRED] == 2 );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENT_BYTES_EXPIRED] == (uint64_t) ( 7 * config.fragment_size + capture.datagram_bytes[7] - RELIABLE_FRAGMENT_HEADER_BYTES ) );
+
+    for ( i = 0; i < capture.num_datagrams; ++i )
+    {
+        free( capture.datagram_data[i] );
+    }
+
+    reliable_endpoint_destroy( sender );
+    reliable_endpoint_destroy( receiver );
 }
 
-#define check( condition )                                                                                      \
-do                                                                                                              \
-{                                                                                                               \
-    if ( !(condition) )                                                                                         \
-    {                                                                                                           \
-        check_handler( #condition, (RELIABLE_CONST char*) __FUNCTION__, __FILE__, __LINE__ );                   \
-    }                                                                                                           \
-} while(0)
+static int test_num_packets_processed;
 
-static void test_endian()
+static int test_process_packet_function_count( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
 {
-    uint32_t value = 0x11223344;
+    (void) context;
+    (void) id;
+    (void) sequence;
+    validate_packet_data( packet_data, packet_bytes );
+    test_num_packets_processed++;
+    return 1;
+}
 
-    char * bytes = (char*) &value;
+void test_packets_duplicate()
+{
+    // every datagram is delivered twice, one at a time or both copies in one batch. without the duplicate filter each packet is processed twice
 
-#if RELIABLE_LITTLE_ENDIAN
+    int pass;
+    for ( pass = 0; pass < 4; ++pass )
+    {
+        int drop_duplicate_packets = pass & 1;
+        int batch = pass >> 1;
 
-    check( bytes[0] == 0x44 );
-    check( bytes[1] == 0x33 );
-    check( bytes[2] == 0x22 );
-    check( bytes[3] == 0x11 );
+        struct test_capture_context_t capture;
+        memset( &capture, 0, sizeof( capture ) );
 
-#else // #if RELIABLE_LITTLE_ENDIAN
+        struct reliable_config_t config;
+        reliable_default_config( &config );
+        config.fragment_above = 500;
+        config.drop_duplicate_packets = drop_duplicate_packets;
+        config.context = &capture;
+        config.transmit_packet_function = &test_transmit_packet_function_capture;
+        config.process_packet_function = &test_process_packet_function_count;
 
-    check( bytes[3] == 0x44 );
-    check( bytes[2] == 0x33 );
-    check( bytes[1] == 0x22 );
-    check( bytes[0] == 0x11 );
+        struct reliable_endpoint_t * sender = reliable_endpoint_create( &config, 100.0 );
+        struct reliable_endpoint_t * receiver = reliable_endpoint_create( &config, 100.0 );
+
+        test_num_packets_processed = 0;
+
+        const int num_packets = 16;
+
+        int i, j;
+        for ( i = 0; i < num_packets; ++i )
+        {
+            uint8_t packet_data[TEST_MAX_PACKET_BYTES];
+            uint16_t sequence = reliable_endpoint_next_packet_sequence( sender );
+            int packet_bytes = generate_packet_data( sequence, packet_data );
+            reliable_endpoint_send_packet( sender, packet_data, packet_bytes );
+
+            if ( batch )
+            {
+                uint8_t * datagram_data[2*TEST_CAPTURE_MAX_DATAGRAMS];
+                int datagram_bytes[2*TEST_CAPTURE_MAX_DATAGRAMS];
+                for ( j = 0; j < 2 * capture.num_datagrams; ++j )
+                {
+                    datagram_data[j] = capture.datagram_data[j % capture.num_datagrams];
+                    datagram_bytes[j] = capture.datagram_bytes[j % capture.num_datagrams];
+                }
+                reliable_endpoint_receive_packets( receiver, datagram_data, datagram_bytes, 2 * capture.num_datagrams );
+            }
+            else
+            {
+                for ( j = 0; j < 2; ++j )
+                {
+                    int k;
+                    for ( k = 0; k < capture.num_datagrams; ++k )
+                    {
+                        reliable_endpoint_receive_packet( receiver, capture.datagram_data[k], capture.datagram_bytes[k] );
+                    }
+                }
+            }
+
+            for ( j = 0; j < capture.num_datagrams; ++j )
+            {
+                free( capture.datagram_data[j] );
+            }
+            capture.num_datagrams = 0;
+        }
 
-#endif // #if RELIABLE_LITTLE_ENDIAN
-}
+        RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( receiver );
 
-struct test_sequence_data_t
-{
-    uint16_t sequence;
-};
+        if ( drop_duplicate_packets )
+        {
+            check( test_num_packets_processed == num_packets );
+            check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_DUPLICATE] == (uint64_t) num_packets );
+        }
+        else
+        {
+            check( test_num_packets_processed == 2 * num_packets );
+            check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_DUPLICATE] == 0 );
+        }
 
-#define TEST_SEQUENCE_BUFFER_SIZE 256
+        reliable_endpoint_destroy( sender );
+        reliable_endpoint_destroy( receiver );
+    }
+}
 
-static void test_sequence_buffer()
+void test_acks_incremental()
 {
-    struct reliable_sequence_buffer_t * sequence_buffer = reliable_sequence_buffer_create( TEST_SEQUENCE_BUFFER_SIZE, 
-                                                                                           sizeof( struct test_sequence_data_t ), 
-                                                                                           NULL, 
-                                                                                           NULL, 
-                                                                                           NULL );
+    double time = 100.0;
 
-    check( sequence_buffer );
-    check( sequence_buffer->sequence == 0 );
-    check( sequence_buffer->num_entries == TEST_SEQUENCE_BUFFER_SIZE );
-    check( sequence_buffer->entry_stride == sizeof( struct test_sequence_data_t ) );
+    struct test_context_t context;
+    test_default_context( &context );
 
-    int i;
-    for ( i = 0; i < TEST_SEQUENCE_BUFFER_SIZE; ++i )
-    {
-        check( reliable_sequence_buffer_find( sequence_buffer, ((uint16_t)i) ) == NULL );
-    }                                                                      
+    struct reliable_config_t sender_config;
+    struct reliable_config_t receiver_config;
 
-    for ( i = 0; i <= TEST_SEQUENCE_BUFFER_SIZE*4; ++i )
-    {
-        struct test_sequence_data_t * entry = (struct test_sequence_data_t*) reliable_sequence_buffer_insert( sequence_buffer, ((uint16_t)i) );
-        check( entry );
-        entry->sequence = (uint16_t) i;
-        check( sequence_buffer->sequence == i + 1 );
-    }
+    reliable_default_config( &sender_config );
+    reliable_default_config( &receiver_config );
 
-    for ( i = 0; i <= TEST_SEQUENCE_BUFFER_SIZE; ++i )
-    {
-        struct test_sequence_data_t * entry = (struct test_sequence_data_t*) reliable_sequence_buffer_insert( sequence_buffer, ((uint16_t)i) );
-        check( entry == NULL );
-    }    
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+    sender_config.context = &context;
+    sender_config.id = 0;
+    sender_config.ack_buffer_size = 4;
+    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.process_packet_function = &test_process_packet_function;
 
-    int index = TEST_SEQUENCE_BUFFER_SIZE * 4;
-    for ( i = 0; i < TEST_SEQUENCE_BUFFER_SIZE; ++i )
-    {
-        struct test_sequence_data_t * entry = (struct test_sequence_data_t*) reliable_sequence_buffer_find( sequence_buffer, (uint16_t) index );
-        check( entry );
-        check( entry->sequence == (uint32_t) index );
-        index--;
-    }
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+    receiver_config.context = &context;
+    receiver_config.id = 1;
+    receiver_config.transmit_packet_function = &test_transmit_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function;
 
-    reliable_sequence_buffer_reset( sequence_buffer );
+    context.sender = reliable_endpoint_create( &sender_config, time );
+    context.receiver = reliable_endpoint_create( &receiver_config, time );
 
-    check( sequence_buffer );
-    check( sequence_buffer->sequence == 0 );
-    check( sequence_buffer->num_entries == TEST_SEQUENCE_BUFFER_SIZE );
-    check( sequence_buffer->entry_stride == sizeof( struct test_sequence_data_t ) );
+    uint8_t packet_data[8];
+    memset( packet_data, 0, sizeof( packet_data ) );
 
-    for ( i = 0; i < TEST_SEQUENCE_BUFFER_SIZE; ++i )
+    int i;
+    for ( i = 0; i < 10; ++i )
     {
-        check( reliable_sequence_buffer_find( sequence_buffer, (uint16_t) i ) == NULL );
+        reliable_endpoint_send_packet( context.sender, packet_data, sizeof( packet_data ) );
     }
 
-    reliable_sequence_buffer_destroy( sequence_buffer );
-}
-
-static void test_generate_ack_bits()
-{
-    struct reliable_sequence_buffer_t * sequence_buffer = reliable_sequence_buffer_create( TEST_SEQUENCE_BUFFER_SIZE, 
-                                                                                           sizeof( struct test_sequence_data_t ), 
-                                                                                           NULL, 
-                                                                                           NULL, 
-                                                                                           NULL );
+    // the sender's ack buffer only has room for 4 acks. the acks that don't fit are dropped from it, but the packets are still acked
 
-    uint16_t ack = 0;
-    uint32_t ack_bits = 0xFFFFFFFF;
+    RELIABLE_CONST uint64_t * sender_counters = reliable_endpoint_counters( context.sender );
 
-    reliable_sequence_buffer_generate_ack_bits( sequence_buffer, &ack, &ack_bits );
-    check( ack == 0xFFFF );
-    check( ack_bits == 0 );
+    reliable_endpoint_send_packet( context.receiver, packet_data, sizeof( packet_data ) );
 
-    int i;
-    for ( i = 0; i <= TEST_SEQUENCE_BUFFER_SIZE; ++i )
-    {
-        reliable_sequence_buffer_insert( sequence_buffer, (uint16_t) i );
-    }
+    int num_acks;
+    reliable_endpoint_get_acks( context.sender, &num_acks );
+    check( num_acks == 4 );
+    reliable_endpoint_clear_acks( context.sender );
 
-    reliable_sequence_buffer_generate_ack_bits( sequence_buffer, &ack, &ack_bits );
-    check( ack == TEST_SEQUENCE_BUFFER_SIZE );
-    check( ack_bits == 0xFFFFFFFF );
+    check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED] == 10 );
+    check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_ACKS_OVERFLOW] == 6 );
 
-    reliable_sequence_buffer_reset( sequence_buffer );
+    // once everything is applied, repeated acks do nothing
 
-    uint16_t input_acks[] = { 1, 5, 9, 11 };
-    int input_num_acks = sizeof( input_acks ) / sizeof( uint16_t );
-    for ( i = 0; i < input_num_acks; ++i )
+    for ( i = 0; i < 2; ++i )
     {
-        reliable_sequence_buffer_insert( sequence_buffer, input_acks[i] );
+        reliable_endpoint_send_packet( context.receiver, packet_data, sizeof( packet_data ) );
     }
 
-    reliable_sequence_buffer_generate_ack_bits( sequence_buffer, &ack, &ack_bits );
-
-    check( ack == 11 );
-    check( ack_bits == ( 1 | (1<<(11-9)) | (1<<(11-5)) | (1<<(11-1)) ) );
+    reliable_endpoint_get_acks( context.sender, &num_acks );
+    check( num_acks == 0 );
+    check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED] == 10 );
+    check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_ACKS_OVERFLOW] == 6 );
+    check( context.sender->applied_ack == 9 );
+    check( context.sender->applied_ack_bits[0] == 0x3FF );
+    check( context.sender->applied_ack_bits[1] == 0 );
 
-    reliable_sequence_buffer_destroy( sequence_buffer );
+    reliable_endpoint_destroy( context.sender );
+    reliable_endpoint_destroy( context.receiver );
 }
 
-static void test_packet_header()
-{
-    uint16_t write_sequence;
-    uint16_t write_ack;
-    uint32_t write_ack_bits;
-
-    uint16_t read_sequence;
-    uint16_t read_ack;
-    uint32_t read_ack_bits;
+#define TEST_ACK_FUNCTION_NUM_PACKETS 40
 
-    uint8_t packet_data[RELIABLE_MAX_PACKET_HEADER_BYTES];
+static int test_num_ack_function_calls;
+static uint16_t test_ack_function_sequence[TEST_ACK_FUNCTION_NUM_PACKETS];
+static double test_ack_function_send_time[TEST_ACK_FUNCTION_NUM_PACKETS];
+static float test_ack_function_rtt[TEST_ACK_FUNCTION_NUM_PACKETS];
 
-    // worst case, sequence and ack are far apart, no packets acked.
+static void test_ack_function( void * context, uint64_t id, uint16_t sequence, double send_time, float rtt )
+{
+    (void) context;
+    check( id == 0 );
+    check( test_num_ack_function_calls < TEST_ACK_FUNCTION_NUM_PACKETS );
+    test_ack_function_sequence[test_num_ack_function_calls] = sequence;
+    test_ack_function_send_time[test_num_ack_function_calls] = send_time;
+    test_ack_function_rtt[test_num_ack_function_calls] = rtt;
+    test_num_ack_function_calls++;
+}
 
-    write_sequence = 10000;
-    write_ack = 100;
-    write_ack_bits = 0;
+void test_acks_function()
+{
+    // with the ack function set every ack is reported inline, and the ack buffer size doesn't matter.
+    // without it, acks that don't fit in the ack buffer are dropped from it and counted as overflow, once each, 
+    // but the packets are still acked for rtt and packet loss.
 
-    int bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, write_ack_bits );
+    int use_ack_function;
+    for ( use_ack_function = 0; use_ack_function <= 1; ++use_ack_function )
+    {
+        double time = 100.0;
 
-    check( bytes_written == RELIABLE_MAX_PACKET_HEADER_BYTES );
+        struct test_context_t context;
+        test_default_context( &context );
 
-    int bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits );
+        struct reliable_config_t sender_config;
+        struct reliable_config_t receiver_config;
 
-    check( bytes_read == bytes_written );
+        reliable_default_config( &sender_config );
+        reliable_default_config( &receiver_config );
 
-    check( read_sequence == write_sequence );
-    check( read_ack == write_ack );
-    check( read_ack_bits == write_ack_bits );
+        reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+        sender_config.context = &context;
+        sender_config.id = 0;
+        sender_config.ack_buffer_size = 4;
+        sender_config.transmit_packet_function = &test_transmit_packet_function;
+        sender_config.process_packet_function = &test_process_packet_function;
+        sender_config.ack_function = use_ack_function ? &test_ack_function : NULL;
 
-    // rare case. sequence and ack are far apart, significant # of acks are missing
+        reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+        receiver_config.context = &context;
+        receiver_config.id = 1;
+        receiver_config.transmit_packet_function = &test_transmit_packet_function;
+        receiver_config.process_packet_function = &test_process_packet_function;
 
-    write_sequence = 10000;
-    write_ack = 100;
-    write_ack_bits = 0xFEFEFFFE;
+        context.sender = reliable_endpoint_create( &sender_config, time );
+        context.receiver = reliable_endpoint_create( &receiver_config, time );
 
-    bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, write_ack_bits );
+        test_num_ack_function_calls = 0;
 
-    check( bytes_written == 1 + 2 + 2 + 3 );
+        uint8_t packet_data[8];
+        memset( packet_data, 0, sizeof( packet_data ) );
 
-    bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits );
+        int i;
+        for ( i = 0; i < TEST_ACK_FUNCTION_NUM_PACKETS; ++i )
+        {
+            reliable_endpoint_send_packet( context.sender, packet_data, sizeof( packet_data ) );
 
-    check( bytes_read == bytes_written );
+            time += 0.05;
+            reliable_endpoint_update( context.sender, time );
+            reliable_endpoint_update( context.receiver, time );
 
-    check( read_sequence == write_sequence );
-    check( read_ack == write_ack );
-    check( read_ack_bits == write_ack_bits );
+            reliable_endpoint_send_packet( context.receiver, packet_data, sizeof( packet_data ) );
+        }
 
-    // common case under packet loss. sequence and ack are close together, some acks are missing
+        RELIABLE_CONST uint64_t * sender_counters = reliable_endpoint_counters( context.sender );
 
-    write_sequence = 200;
-    write_ack = 100;
-    write_ack_bits = 0xFFFEFFFF;
+        int num_acks;
+        reliable_endpoint_get_acks( context.sender, &num_acks );
 
-    bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, write_ack_bits );
+        if ( use_ack_function )
+        {
+            check( num_acks == 0 );
+            check( test_num_ack_function_calls == TEST_ACK_FUNCTION_NUM_PACKETS );
+            check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED] == TEST_ACK_FUNCTION_NUM_PACKETS );
+            check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_ACKS_OVERFLOW] == 0 );
 
-    check( bytes_written == 1 + 2 + 1 + 1 );
+            for ( i = 0; i < TEST_ACK_FUNCTION_NUM_PACKETS; ++i )
+            {
+                check( test_ack_function_sequence[i] == (uint16_t) i );
+                check( fabs( test_ack_function_send_time[i] - ( 100.0 + i * 0.05 ) ) < 0.001 );
+                check( fabs( test_ack_function_rtt[i] - 50.0f ) < 1.0f );
+            }
+        }
+        else
+        {
+            check( num_acks == 4 );
+            check( test_num_ack_function_calls == 0 );
+            check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED] == TEST_ACK_FUNCTION_NUM_PACKETS );
+            check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_ACKS_OVERFLOW] == TEST_ACK_FUNCTION_NUM_PACKETS - 4 );
+        }
 
-    bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits );
+        check( reliable_endpoint_packet_loss( context.sender ) < 5.0f );
 
-    check( bytes_read == bytes_written );
+        reliable_endpoint_destroy( context.sender );
+        reliable_endpoint_destroy( context.receiver );
+    }
+}
 
-    check( read_sequence == write_sequence );
-    check( read_ack == write_ack );
-    check( read_ack_bits == write_ack_bits );
+void test_sequence_buffer_index()
+{
+    // power of two buffers index with a mask, other sizes with modulo. both must agree on which entries exist across the wrap
 
-    // ideal case. no packet loss.
+    int sizes[] = { 256, 100 };
 
-    write_sequence = 200;
-    write_ack = 100;
-    write_ack_bits = 0xFFFFFFFF;
+    int j;
+    for ( j = 0; j < 2; ++j )
+    {
+        struct reliable_sequence_buffer_t * sequence_buffer = reliable_sequence_buffer_create( sizes[j], 
+                                                                                               sizeof( struct test_sequence_data_t ), 
+                                                                                               RELIABLE_SEQUENCE_BUFFER_LAYOUT_SEPARATE, 
+                                                                                               NULL, 
+                                                                                               NULL, 
+                                                                                               NULL );
 
-    bytes_written = reliable_write_packet_header( packet_data, write_sequence, write_ack, write_ack_bits );
+        check( sequence_buffer->index_mask == ( j == 0 ? 255U : 0U ) );
 
-    check( bytes_written == 1 + 2 + 1 );
+        int i;
+        for ( i = 65530; i <= 65535; ++i )
+        {
+            struct test_sequence_data_t * entry = (struct test_sequence_data_t*) reliable_sequence_buffer_insert( sequence_buffer, (uint16_t) i );
+            check( entry );
+            entry->sequence = (uint16_t) i;
+        }
 
-    bytes_read = reliable_read_packet_header( "test_packet_header", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits );
+        struct test_sequence_data_t * entry = (struct test_sequence_data_t*) reliable_sequence_buffer_insert( sequence_buffer, 5 );
+        check( entry );
+        entry->sequence = 5;
 
-    check( bytes_read == bytes_written );
+        for ( i = 65530; i <= 65535; ++i )
+        {
+            entry = (struct test_sequence_data_t*) reliable_sequence_buffer_find( sequence_buffer, (uint16_t) i );
+            check( entry );
+            check( entry->sequence == (uint16_t) i );
+        }
 
-    check( read_sequence == write_sequence );
-    check( read_ack == write_ack );
-    check( read_ack_bits == write_ack_bits );
-}
+        for ( i = 0; i < 5; ++i )
+        {
+            check( reliable_sequence_buffer_find( sequence_buffer, (uint16_t) i ) == NULL );
+        }
 
-struct test_context_t
-{
-    int drop;
-    int allow_packets;
-    struct reliable_endpoint_t * sender;
-    struct reliable_endpoint_t * receiver;
-};
+        entry = (struct test_sequence_data_t*) reliable_sequence_buffer_find( sequence_buffer, 5 );
+        check( entry );
+        check( entry->sequence == 5 );
 
-void test_default_context( struct test_context_t * context )
-{
-    memset( context, 0, sizeof( *context ) );
-    context->allow_packets = -1;
+        reliable_sequence_buffer_destroy( sequence_buffer );
+    }
 }
 
-static void test_transmit_packet_function( void * _context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+void test_sequence_buffer_interleaved()
 {
-    (void) sequence;
+    struct reliable_sequence_buffer_t * sequence_buffer = reliable_sequence_buffer_create( TEST_SEQUENCE_BUFFER_SIZE, 
+                                                                                           sizeof( struct test_sequence_data_t ), 
+                                                                                           RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED, 
+                                                                                           NULL, 
+                                                                                           NULL, 
+                                                                                           NULL );
 
-    struct test_context_t * context = (struct test_context_t*) _context;
+    check( sequence_buffer->entry_stride == RELIABLE_SEQUENCE_BUFFER_SLOT_BYTES( sizeof( struct test_sequence_data_t ) ) );
+    check( sequence_buffer->entry_data == ( (uint8_t*) sequence_buffer->entry_sequence ) + RELIABLE_SEQUENCE_BUFFER_TAG_BYTES );
 
-    if ( context->drop )
+    int i;
+    for ( i = 0; i < TEST_SEQUENCE_BUFFER_SIZE; ++i )
     {
-        return;
+        check( reliable_sequence_buffer_find( sequence_buffer, (uint16_t) i ) == NULL );
     }
 
-    if ( context->allow_packets >= 0 )
+    for ( i = 0; i < TEST_SEQUENCE_BUFFER_SIZE * 4; ++i )
     {
-        if ( context->allow_packets == 0 )
-        {
-            return;
-        }
-
-        context->allow_packets--;
+        struct test_sequence_data_t * entry = (struct test_sequence_data_t*) reliable_sequence_buffer_insert( sequence_buffer, (uint16_t) i );
+        check( entry );
+        entry->sequence = (uint16_t) i;
     }
 
-    if ( id == 0 )
+    for ( i = 0; i < TEST_SEQUENCE_BUFFER_SIZE * 4; ++i )
     {
-        reliable_endpoint_receive_packet( context->receiver, packet_data, packet_bytes );
-    }
-    else if ( id == 1 )
-    {
-        reliable_endpoint_receive_packet( context->sender, packet_data, packet_bytes );
+        struct test_sequence_data_t * entry = (struct test_sequence_data_t*) reliable_sequence_buffer_find( sequence_buffer, (uint16_t) i );
+        if ( i < TEST_SEQUENCE_BUFFER_SIZE * 3 )
+        {
+            check( entry == NULL );
+        }
+        else
+        {
+            check( entry );
+            check( entry->sequence == (uint16_t) i );
+            check( reliable_sequence_buffer_exists( sequence_buffer, (uint16_t) i ) );
+        }
     }
-}
 
-static int test_process_packet_function( void * _context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
-{
-    struct test_context_t * context = (struct test_context_t*) _context;
+    reliable_sequence_buffer_remove( sequence_buffer, TEST_SEQUENCE_BUFFER_SIZE * 4 - 1 );
+    check( reliable_sequence_buffer_find( sequence_buffer, TEST_SEQUENCE_BUFFER_SIZE * 4 - 1 ) == NULL );
+    check( reliable_sequence_buffer_find( sequence_buffer, TEST_SEQUENCE_BUFFER_SIZE * 4 - 2 ) != NULL );
 
-    (void) context;
-    (void) id;
-    (void) sequence;
-    (void) packet_data;
-    (void) packet_bytes;
+    reliable_sequence_buffer_reset( sequence_buffer );
+
+    for ( i = 0; i < TEST_SEQUENCE_BUFFER_SIZE; ++i )
+    {
+        check( reliable_sequence_buffer_at_index( sequence_buffer, i ) == NULL );
+    }
 
-    return 1;
-}
+    reliable_sequence_buffer_destroy( sequence_buffer );
 
-#define TEST_ACKS_NUM_ITERATIONS 256
+    // endpoints with different layouts interoperate, since the layout is local to each endpoint
 
-static void test_acks()
-{
     double time = 100.0;
 
     struct test_context_t context;
     test_default_context( &context );
-    
+
     struct reliable_config_t sender_config;
     struct reliable_config_t receiver_config;
 
@@ -1839,6 +6307,8 @@ static void test_acks()
     sender_config.id = 0;
     sender_config.transmit_packet_function = &test_transmit_packet_function;
     sender_config.process_packet_function = &test_process_packet_function;
+    sender_config.sent_packets_buffer_layout = RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED;
+    sender_config.received_packets_buffer_layout = RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED;
 
     receiver_config.context = &context;
     receiver_config.id = 1;
@@ -1848,9 +6318,6 @@ static void test_acks()
     context.sender = reliable_endpoint_create( &sender_config, time );
     context.receiver = reliable_endpoint_create( &receiver_config, time );
 
-    double delta_time = 0.01;
-
-    int i;
     for ( i = 0; i < TEST_ACKS_NUM_ITERATIONS; ++i )
     {
         uint8_t dummy_packet[8];
@@ -1862,514 +6329,710 @@ static void test_acks()
         reliable_endpoint_update( context.sender, time );
         reliable_endpoint_update( context.receiver, time );
 
-        time += delta_time;
+        time += 0.01;
     }
 
-    uint8_t sender_acked_packet[TEST_ACKS_NUM_ITERATIONS];
-    memset( sender_acked_packet, 0, sizeof( sender_acked_packet ) );
-    int sender_num_acks;
-    uint16_t * sender_acks = reliable_endpoint_get_acks( context.sender, &sender_num_acks );
-    for ( i = 0; i < sender_num_acks; ++i )
-    {
-        if ( sender_acks[i] < TEST_ACKS_NUM_ITERATIONS )
-        {
-            sender_acked_packet[sender_acks[i]] = 1;
-        }
-    }
-    for ( i = 0; i < TEST_ACKS_NUM_ITERATIONS / 2; ++i )
-    {
-        check( sender_acked_packet[i] == 1 );
-    }
+    RELIABLE_CONST uint64_t * sender_counters = reliable_endpoint_counters( context.sender );
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
 
-    uint8_t receiver_acked_packet[TEST_ACKS_NUM_ITERATIONS];
-    memset( receiver_acked_packet, 0, sizeof( receiver_acked_packet ) );
-    int receiver_num_acks;
-    uint16_t * receiver_acks = reliable_endpoint_get_acks( context.receiver, &receiver_num_acks );
-    for ( i = 0; i < receiver_num_acks; ++i )
-    {
-        if ( receiver_acks[i] < TEST_ACKS_NUM_ITERATIONS )
-            receiver_acked_packet[receiver_acks[i]] = 1;
-    }
-    for ( i = 0; i < TEST_ACKS_NUM_ITERATIONS / 2; ++i )
-    {
-        check( receiver_acked_packet[i] == 1 );
-    }
+    check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED] == TEST_ACKS_NUM_ITERATIONS );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED] == TEST_ACKS_NUM_ITERATIONS - 1 );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == TEST_ACKS_NUM_ITERATIONS );
 
     reliable_endpoint_destroy( context.sender );
     reliable_endpoint_destroy( context.receiver );
 }
 
-static void test_acks_packet_loss()
+static int test_num_sequence_buffer_cleanups;
+
+static void test_sequence_buffer_cleanup_function( void * data, void * allocator_context, void (*free_function)(void*,void*) )
+{
+    (void) allocator_context;
+    (void) free_function;
+    struct test_sequence_data_t * entry = (struct test_sequence_data_t*) data;
+    check( entry->sequence != 0xFFFF );
+    entry->sequence = 0xFFFF;
+    test_num_sequence_buffer_cleanups++;
+}
+
+void test_sequence_buffer_remove_entries()
+{
+    // removes only clean up occupied entries, for both layouts. the power of two size also crosses the 65536 wrap.
+    // sizes that are not a power of two alias across the wrap, so that size stays clear of it until the last part
+
+    int sizes[] = { 256, 100 };
+    int base_sequence[] = { 65500, 1000 };
+    int advance_sequence[] = { 252, 32 };
+
+    int layout, j;
+    for ( layout = RELIABLE_SEQUENCE_BUFFER_LAYOUT_SEPARATE; layout <= RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED; ++layout )
+    {
+        for ( j = 0; j < 2; ++j )
+        {
+            struct reliable_sequence_buffer_t * sequence_buffer = reliable_sequence_buffer_create( sizes[j], 
+                                                                                                   sizeof( struct test_sequence_data_t ), 
+                                                                                                   layout, 
+                                                                                                   NULL, 
+                                                                                                   NULL, 
+                                                                                                   NULL );
+
+            int base = base_sequence[j];
+
+            reliable_sequence_buffer_advance( sequence_buffer, (uint16_t) ( base / 2 ) );
+            reliable_sequence_buffer_advance( sequence_buffer, (uint16_t) ( base - 1 ) );
+
+            // every third sequence from base to base + 35
+
+            int i;
+            int num_inserted = 0;
+            for ( i = base; i <= base + 35; i += 3 )
+            {
+                struct test_sequence_data_t * entry = (struct test_sequence_data_t*) 
+                    reliable_sequence_buffer_insert_with_cleanup( sequence_buffer, (uint16_t) i, test_sequence_buffer_cleanup_function );
+                check( entry );
+                entry->sequence = (uint16_t) i;
+                num_inserted++;
+            }
+
+            // advancing to base + 60 only removes sequences after the last insert, which are all empty
+
+            test_num_sequence_buffer_cleanups = 0;
+            reliable_sequence_buffer_advance_with_cleanup( sequence_buffer, (uint16_t) ( base + 60 ), test_sequence_buffer_cleanup_function );
+            check( test_num_sequence_buffer_cleanups == 0 );
+
+            for ( i = base; i <= base + 35; i += 3 )
+            {
+                check( reliable_sequence_buffer_exists( sequence_buffer, (uint16_t) i ) );
+            }
+
+            // removing one entry cleans it up once, and later removes skip it
+
+            reliable_sequence_buffer_remove_with_cleanup( sequence_buffer, (uint16_t) base, test_sequence_buffer_cleanup_function );
+            check( test_num_sequence_buffer_cleanups == 1 );
+            check( !reliable_sequence_buffer_exists( sequence_buffer, (uint16_t) base ) );
+
+            // jumping further than the buffer size removes everything that is left
+
+            reliable_sequence_buffer_advance_with_cleanup( sequence_buffer, (uint16_t) ( base + 2000 ), test_sequence_buffer_cleanup_function );
+            check( test_num_sequence_buffer_cleanups == num_inserted );
+
+            for ( i = 0; i < sequence_buffer->num_entries; ++i )
+            {
+                check( reliable_sequence_buffer_at_index( sequence_buffer, i ) == NULL );
+            }
+
+            // a partial advance across the wrap without a cleanup function. step the buffer up to the wrap first
+
+            reliable_sequence_buffer_reset( sequence_buffer );
+            reliable_sequence_buffer_advance( sequence_buffer, (uint16_t) 30000 );
+            reliable_sequence_buffer_advance( sequence_buffer, (uint16_t) 60000 );
+            reliable_sequence_buffer_advance( sequence_buffer, (uint16_t) 65520 );
+
+            struct test_sequence_data_t * entry = (struct test_sequence_data_t*) reliable_sequence_buffer_insert( sequence_buffer, (uint16_t) 65530 );
+            check( entry );
+            entry = (struct test_sequence_data_t*) reliable_sequence_buffer_insert( sequence_buffer, (uint16_t) 65535 );
+            check( entry );
+            entry = (struct test_sequence_data_t*) reliable_sequence_buffer_insert( sequence_buffer, (uint16_t) 3 );
+            check( entry );
+
+            check( reliable_sequence_buffer_exists( sequence_buffer, (uint16_t) 65530 ) );
+            check( reliable_sequence_buffer_exists( sequence_buffer, (uint16_t) 65535 ) );
+            check( reliable_sequence_buffer_exists( sequence_buffer, (uint16_t) 3 ) );
+
+            // evicts the entry holding 65530, but not the entries holding 65535 and 3
+
+            reliable_sequence_buffer_advance( sequence_buffer, (uint16_t) advance_sequence[j] );
+
+            check( !reliable_sequence_buffer_exists( sequence_buffer, (uint16_t) 65530 ) );
+            check( reliable_sequence_buffer_exists( sequence_buffer, (uint16_t) 65535 ) );
+            check( reliable_sequence_buffer_exists( sequence_buffer, (uint16_t) 3 ) );
+
+            reliable_sequence_buffer_destroy( sequence_buffer );
+        }
+    }
+}
+
+void test_received_bits()
 {
+    // the received bits must match the received packets buffer over the whole window, through packet loss and long gaps
+
     double time = 100.0;
 
     struct test_context_t context;
     test_default_context( &context );
-    
+
     struct reliable_config_t sender_config;
     struct reliable_config_t receiver_config;
 
     reliable_default_config( &sender_config );
     reliable_default_config( &receiver_config );
 
+    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
     sender_config.context = &context;
     sender_config.id = 0;
     sender_config.transmit_packet_function = &test_transmit_packet_function;
     sender_config.process_packet_function = &test_process_packet_function;
 
+    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
     receiver_config.context = &context;
     receiver_config.id = 1;
+    receiver_config.received_packets_buffer_size = 512;
     receiver_config.transmit_packet_function = &test_transmit_packet_function;
     receiver_config.process_packet_function = &test_process_packet_function;
 
     context.sender = reliable_endpoint_create( &sender_config, time );
     context.receiver = reliable_endpoint_create( &receiver_config, time );
 
-    const double delta_time = 0.1f;
+    uint8_t packet_data[8];
+    memset( packet_data, 0, sizeof( packet_data ) );
 
     int i;
-    for ( i = 0; i < TEST_ACKS_NUM_ITERATIONS; ++i )
+    for ( i = 0; i < 2000; ++i )
     {
-        uint8_t dummy_packet[8];
-        memset( dummy_packet, 0, sizeof( dummy_packet ) );
-
-        context.drop = ( i % 2 );
+        // random loss, plus outages of 100 and 300 packets
 
-        reliable_endpoint_send_packet( context.sender, dummy_packet, sizeof( dummy_packet ) );
-        reliable_endpoint_send_packet( context.receiver, dummy_packet, sizeof( dummy_packet ) );
+        context.drop = ( rand() % 3 ) == 0 || ( i >= 500 && i < 600 ) || ( i >= 1000 && i < 1300 );
 
-        reliable_endpoint_update( context.sender, time );
-        reliable_endpoint_update( context.receiver, time );
+        reliable_endpoint_send_packet( context.sender, packet_data, sizeof( packet_data ) );
 
-        time += delta_time;
-    }
+        uint16_t ack = context.receiver->ack;
+        check( ack == (uint16_t) ( context.receiver->received_packets->sequence - 1 ) );
 
-    uint8_t sender_acked_packet[TEST_ACKS_NUM_ITERATIONS];
-    memset( sender_acked_packet, 0, sizeof( sender_acked_packet ) );
-    int sender_num_acks;
-    uint16_t * sender_acks = reliable_endpoint_get_acks( context.sender, &sender_num_acks );
-    for ( i = 0; i < sender_num_acks; ++i )
-    {
-        if ( sender_acks[i] < TEST_ACKS_NUM_ITERATIONS )
+        int offset;
+        for ( offset = 0; offset < RELIABLE_MAX_ACK_WINDOW_BITS; ++offset )
         {
-            sender_acked_packet[sender_acks[i]] = 1;
+            uint16_t sequence = ack - (uint16_t) offset;
+            int received = ( context.receiver->received_bits[offset >> 6] >> ( offset & 63 ) ) & 1;
+            check( received == reliable_sequence_buffer_exists( context.receiver->received_packets, sequence ) );
+            check( received == reliable_endpoint_has_received( context.receiver, sequence ) );
         }
-    }
-    for ( i = 0; i < TEST_ACKS_NUM_ITERATIONS / 2; ++i )
-    {
-        check( sender_acked_packet[i] == (i+1) % 2 );
-    }
 
-    uint8_t receiver_acked_packet[TEST_ACKS_NUM_ITERATIONS];
-    memset( receiver_acked_packet, 0, sizeof( receiver_acked_packet ) );
-    int receiver_num_acks;
-    uint16_t * receiver_acks = reliable_endpoint_get_acks( context.sender, &receiver_num_acks );
-    for ( i = 0; i < receiver_num_acks; ++i )
-    {
-        if ( receiver_acks[i] < TEST_ACKS_NUM_ITERATIONS )
-        {
-            receiver_acked_packet[receiver_acks[i]] = 1;
-        }
-    }
-    for ( i = 0; i < TEST_ACKS_NUM_ITERATIONS / 2; ++i )
-    {
-        check( receiver_acked_packet[i] == (i+1) % 2 );
+        uint64_t ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+        uint32_t expected_ack_bits;
+        uint16_t expected_ack;
+        reliable_endpoint_generate_ack_bits( context.receiver, &ack, ack_bits );
+        reliable_sequence_buffer_generate_ack_bits( context.receiver->received_packets, &expected_ack, &expected_ack_bits );
+        check( ack == expected_ack );
+        check( ack_bits[0] == expected_ack_bits );
     }
 
     reliable_endpoint_destroy( context.sender );
     reliable_endpoint_destroy( context.receiver );
 }
 
-#define TEST_MAX_PACKET_BYTES (4*1024)
-
-static void generate_packet_data_with_size( uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+void test_packet_header_window()
 {
-    reliable_assert( packet_bytes >= 2 );
-    reliable_assert( packet_bytes <= TEST_MAX_PACKET_BYTES );
+    uint8_t packet_data[RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES];
 
-    packet_data[0] = (uint8_t) ( sequence & 0xFF );
-    packet_data[1] = (uint8_t) ( (sequence>>8) & 0xFF );
-    int i;
-    for ( i = 2; i < packet_bytes; ++i )
-    {
-        packet_data[i] = (uint8_t) ( ( (int)i + sequence ) % 256 );
-    }
-}
+    uint64_t write_ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+    uint64_t read_ack_bits[RELIABLE_ACK_WINDOW_WORDS];
 
-static int generate_packet_data( uint16_t sequence, uint8_t * packet_data )
-{
-    int packet_bytes = ( ( (int)sequence * 1023 ) % ( TEST_MAX_PACKET_BYTES - 2 ) ) + 2;
-    generate_packet_data_with_size( sequence, packet_data, packet_bytes );
-    return packet_bytes;
-}
+    uint16_t read_sequence;
+    uint16_t read_ack;
+    int read_ack_window_bits;
 
-static void validate_packet_data( uint8_t * packet_data, int packet_bytes )
-{
-    reliable_assert( packet_bytes >= 2 );
-    reliable_assert( packet_bytes <= TEST_MAX_PACKET_BYTES );
-    uint16_t sequence = 0;
-    sequence |= (uint16_t) packet_data[0];
-    sequence |= ( (uint16_t) packet_data[1] ) << 8;
-    check( packet_bytes == ( ( (int)sequence * 1023 ) % ( TEST_MAX_PACKET_BYTES - 2 ) ) + 2 );
-    int i;
-    for ( i = 2; i < packet_bytes; ++i )
+    int ack_window_bits;
+    for ( ack_window_bits = 64; ack_window_bits <= RELIABLE_MAX_ACK_WINDOW_BITS; ack_window_bits *= 2 )
     {
-        check( packet_data[i] == (uint8_t) ( ( (int)i + sequence ) % 256 ) );
+        int num_words = ack_window_bits / 64;
+
+        // worst case, sequence and ack are far apart, no packets acked
+
+        memset( write_ack_bits, 0, sizeof( write_ack_bits ) );
+
+        int bytes_written = reliable_write_packet_header_window( packet_data, 10000, 100, write_ack_bits, ack_window_bits );
+
+        check( bytes_written == 1 + 2 + 2 + num_words + num_words * 8 );
+        check( bytes_written == RELIABLE_MAX_PACKET_HEADER_BYTES_FOR_ACK_WINDOW( ack_window_bits ) );
+
+        int bytes_read = reliable_read_packet_header_window( "test_packet_header_window", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, &read_ack_window_bits );
+
+        check( bytes_read == bytes_written );
+        check( read_sequence == 10000 );
+        check( read_ack == 100 );
+        check( read_ack_window_bits == ack_window_bits );
+        check( memcmp( read_ack_bits, write_ack_bits, sizeof( read_ack_bits ) ) == 0 );
+
+        // ideal case, every packet in the window acked
+
+        int i;
+        for ( i = 0; i < num_words; ++i )
+        {
+            write_ack_bits[i] = ~0ULL;
+        }
+
+        bytes_written = reliable_write_packet_header_window( packet_data, 200, 100, write_ack_bits, ack_window_bits );
+
+        check( bytes_written == 1 + 2 + 1 + num_words );
+
+        bytes_read = reliable_read_packet_header_window( "test_packet_header_window", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, &read_ack_window_bits );
+
+        check( bytes_read == bytes_written );
+        check( read_sequence == 200 );
+        check( read_ack == 100 );
+        check( memcmp( read_ack_bits, write_ack_bits, sizeof( read_ack_bits ) ) == 0 );
+
+        // a burst of loss in the middle of the window
+
+        write_ack_bits[num_words-1] = 0xFFFFFFFF0000FFFFULL;
+
+        bytes_written = reliable_write_packet_header_window( packet_data, 200, 100, write_ack_bits, ack_window_bits );
+
+        check( bytes_written == 1 + 2 + 1 + num_words + 2 );
+
+        bytes_read = reliable_read_packet_header_window( "test_packet_header_window", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, &read_ack_window_bits );
+
+        check( bytes_read == bytes_written );
+        check( memcmp( read_ack_bits, write_ack_bits, sizeof( read_ack_bits ) ) == 0 );
+
+        // truncated headers are rejected
+
+        check( reliable_read_packet_header_window( "test_packet_header_window", packet_data, bytes_written - 1, &read_sequence, &read_ack, read_ack_bits, &read_ack_window_bits ) < 0 );
+
+        // the legacy reader sees the most recent 32 bits
+
+        uint32_t read_ack_bits_32 = 0;
+        bytes_read = reliable_read_packet_header( "test_packet_header_window", packet_data, bytes_written, &read_sequence, &read_ack, &read_ack_bits_32 );
+        check( bytes_read == bytes_written );
+        check( read_ack_bits_32 == (uint32_t) write_ack_bits[0] );
     }
+
+    memset( write_ack_bits, 0, sizeof( write_ack_bits ) );
+    check( reliable_write_packet_header_window( packet_data, 10000, 100, write_ack_bits, 32 ) == RELIABLE_MAX_PACKET_HEADER_BYTES );
+    check( reliable_write_packet_header_window( packet_data, 10000, 100, write_ack_bits, RELIABLE_MAX_ACK_WINDOW_BITS ) == RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES );
 }
 
-static int test_process_packet_function_validate( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+void test_packet_header_ranges()
 {
-    reliable_assert( packet_data );
-    reliable_assert( packet_bytes > 0 );
-    reliable_assert( packet_bytes <= TEST_MAX_PACKET_BYTES );
+    uint8_t packet_data[RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES];
 
-    (void) context;
-    (void) id;
-    (void) sequence;
+    uint64_t write_ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+    uint64_t read_ack_bits[RELIABLE_ACK_WINDOW_WORDS];
 
-    validate_packet_data( packet_data, packet_bytes );
+    uint16_t read_sequence;
+    uint16_t read_ack;
+    int read_ack_window_bits;
 
-    return 1;
-}
+    // every packet in the window received is a single range
 
-static int generate_packet_data_large( uint8_t* packet_data )
-{
-    int data_bytes = TEST_MAX_PACKET_BYTES - 2;
-    reliable_assert( data_bytes >= 2) ;
-    reliable_assert( data_bytes <= (1 << 16) );
+    memset( write_ack_bits, 0xFF, sizeof( write_ack_bits ) );
+
+    int bytes_written = reliable_write_packet_header_ranges( packet_data, 200, 100, write_ack_bits, 256 );
+
+    check( bytes_written == 1 + 2 + 1 + 1 + 2 );
+    check( ( packet_data[0] >> 6 ) == RELIABLE_PACKET_HEADER_ACK_RANGES );
+
+    int bytes_read = reliable_read_packet_header_window( "test_packet_header_ranges", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, &read_ack_window_bits );
+
+    check( bytes_read == bytes_written );
+    check( read_sequence == 200 );
+    check( read_ack == 100 );
+    check( read_ack_window_bits == 256 );
+    check( memcmp( read_ack_bits, write_ack_bits, sizeof( read_ack_bits ) ) == 0 );
+
+    // a burst of loss in the middle of the window is two ranges, much smaller than the bitfield
+
+    memset( write_ack_bits, 0, sizeof( write_ack_bits ) );
+    reliable_ack_window_set_range( write_ack_bits, 0, 100 );
+    reliable_ack_window_set_range( write_ack_bits, 150, 256 );
+
+    bytes_written = reliable_write_packet_header_ranges( packet_data, 10000, 100, write_ack_bits, 256 );
+
+    check( bytes_written == 1 + 2 + 2 + 2 + 2 );
+    check( bytes_written < reliable_packet_header_window_bytes( 10000, 100, write_ack_bits, 256 ) );
+
+    bytes_read = reliable_read_packet_header_window( "test_packet_header_ranges", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, &read_ack_window_bits );
+
+    check( bytes_read == bytes_written );
+    check( read_sequence == 10000 );
+    check( read_ack == 100 );
+    check( memcmp( read_ack_bits, write_ack_bits, sizeof( read_ack_bits ) ) == 0 );
+
+    // truncated headers are rejected
+
+    check( reliable_read_packet_header_window( "test_packet_header_ranges", packet_data, bytes_written - 1, &read_sequence, &read_ack, read_ack_bits, &read_ack_window_bits ) < 0 );
+
+    // no packets received is no ranges
+
+    memset( write_ack_bits, 0, sizeof( write_ack_bits ) );
+
+    bytes_written = reliable_write_packet_header_ranges( packet_data, 200, 100, write_ack_bits, 256 );
+
+    check( bytes_written == 1 + 2 + 1 );
+
+    bytes_read = reliable_read_packet_header_window( "test_packet_header_ranges", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, &read_ack_window_bits );
+
+    check( bytes_read == bytes_written );
+    check( memcmp( read_ack_bits, write_ack_bits, sizeof( read_ack_bits ) ) == 0 );
+
+    // scattered loss falls back to the bitfield, and so does a window that is all received in 32 bits
 
-    packet_data[0] = (uint8_t) (data_bytes & 0xFF);
-    packet_data[1] = (uint8_t) ( (data_bytes >> 8) & 0xFF );
     int i;
-    for ( i = 2; i < data_bytes; ++i )
+    for ( i = 0; i < RELIABLE_ACK_WINDOW_WORDS; ++i )
     {
-        packet_data[i] = (uint8_t) ( i % 256 );
+        write_ack_bits[i] = 0x5555555555555555ULL;
     }
-    return data_bytes + 2;
-}
 
-static int test_process_packet_function_validate_large( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
-{
-    reliable_assert( packet_data );
-    reliable_assert( packet_bytes >= 2 );
-    reliable_assert( packet_bytes <= TEST_MAX_PACKET_BYTES );
+    bytes_written = reliable_write_packet_header_ranges( packet_data, 200, 100, write_ack_bits, 256 );
 
-    (void) context;
-    (void) id;
-    (void) sequence;
+    check( ( packet_data[0] >> 6 ) == RELIABLE_PACKET_HEADER_ACK_WIDE );
+    check( bytes_written == reliable_packet_header_window_bytes( 200, 100, write_ack_bits, 256 ) );
 
-    uint16_t data_bytes = 0;
-    data_bytes |= (uint16_t) packet_data[0];
-    data_bytes |= ( (uint16_t) packet_data[1] ) << 8;
-    check( packet_bytes == data_bytes + 2 );
-    int i;
-    for ( i = 2; i < data_bytes; ++i )
+    bytes_read = reliable_read_packet_header_window( "test_packet_header_ranges", packet_data, bytes_written, &read_sequence, &read_ack, read_ack_bits, &read_ack_window_bits );
+
+    check( bytes_read == bytes_written );
+    check( memcmp( read_ack_bits, write_ack_bits, sizeof( read_ack_bits ) ) == 0 );
+
+    memset( write_ack_bits, 0, sizeof( write_ack_bits ) );
+    write_ack_bits[0] = 0xFFFFFFFF;
+
+    bytes_written = reliable_write_packet_header_ranges( packet_data, 200, 100, write_ack_bits, 32 );
+
+    check( ( packet_data[0] >> 6 ) == RELIABLE_PACKET_HEADER_ACK_BITS );
+    check( bytes_written == 1 + 2 + 1 );
+
+    // the bitfield size matches what is written, for every window size
+
+    int ack_window_bits;
+    for ( ack_window_bits = 32; ack_window_bits <= RELIABLE_MAX_ACK_WINDOW_BITS; ack_window_bits *= 2 )
     {
-        check( packet_data[i] == (uint8_t) ( i  % 256 ) );
+        for ( i = 0; i < 100; ++i )
+        {
+            int j;
+            for ( j = 0; j < RELIABLE_ACK_WINDOW_WORDS; ++j )
+            {
+                write_ack_bits[j] = ( (uint64_t) rand() << 40 ) ^ ( (uint64_t) rand() << 20 ) ^ (uint64_t) rand();
+                write_ack_bits[j] |= ( (uint64_t) rand() << 40 ) ^ ( (uint64_t) rand() << 20 ) ^ (uint64_t) rand();
+            }
+
+            bytes_written = reliable_write_packet_header_window( packet_data, 200, (uint16_t) ( 200 - i * 3 ), write_ack_bits, ack_window_bits );
+            check( bytes_written == reliable_packet_header_window_bytes( 200, (uint16_t) ( 200 - i * 3 ), write_ack_bits, ack_window_bits ) );
+        }
     }
 
-    return 1;
+    // invalid ranges are rejected
+
+    uint8_t * p = packet_data;
+    reliable_write_uint8( &p, ( RELIABLE_PACKET_HEADER_ACK_RANGES << 6 ) | (1<<5) | ( 1 << 1 ) );
+    reliable_write_uint16( &p, 200 );
+    reliable_write_uint8( &p, 100 );
+    reliable_write_varint( &p, 0 );
+    reliable_write_varint( &p, 0 );
+
+    check( reliable_read_packet_header_window( "test_packet_header_ranges", packet_data, (int) ( p - packet_data ), &read_sequence, &read_ack, read_ack_bits, &read_ack_window_bits ) < 0 );
+
+    p = packet_data;
+    reliable_write_uint8( &p, ( RELIABLE_PACKET_HEADER_ACK_RANGES << 6 ) | (1<<5) | ( 2 << 1 ) );
+    reliable_write_uint16( &p, 200 );
+    reliable_write_uint8( &p, 100 );
+    reliable_write_varint( &p, 0 );
+    reliable_write_varint( &p, 200 );
+    reliable_write_varint( &p, 10 );
+    reliable_write_varint( &p, 100 );
+
+    check( reliable_read_packet_header_window( "test_packet_header_ranges", packet_data, (int) ( p - packet_data ), &read_sequence, &read_ack, read_ack_bits, &read_ack_window_bits ) < 0 );
 }
 
-void test_packets()
+void test_ack_window()
 {
     double time = 100.0;
 
-    struct test_context_t context;
-    test_default_context( &context );
-    
-    struct reliable_config_t sender_config;
-    struct reliable_config_t receiver_config;
+    uint8_t packet_data[2048];
+    memset( packet_data, 0, sizeof( packet_data ) );
 
-    reliable_default_config( &sender_config );
-    reliable_default_config( &receiver_config );
+    // each window size, with the ack bitfield and with ack ranges
 
-    sender_config.fragment_above = 500;
-    receiver_config.fragment_above = 500;
+    int pass;
+    for ( pass = 0; pass < 8; ++pass )
+    {
+        int ack_window_bits = 32 << ( pass % 4 );
 
-    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
-    sender_config.context = &context;
-    sender_config.id = 0;
-    sender_config.transmit_packet_function = &test_transmit_packet_function;
-    sender_config.process_packet_function = &test_process_packet_function_validate;
+        struct test_context_t context;
+        test_default_context( &context );
 
-    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
-    receiver_config.context = &context;
-    receiver_config.id = 1;
-    receiver_config.transmit_packet_function = &test_transmit_packet_function;
-    receiver_config.process_packet_function = &test_process_packet_function_validate;
+        struct reliable_config_t sender_config;
+        struct reliable_config_t receiver_config;
 
-    context.sender = reliable_endpoint_create( &sender_config, time );
-    context.receiver = reliable_endpoint_create( &receiver_config, time );
+        reliable_default_config( &sender_config );
+        reliable_default_config( &receiver_config );
 
-    double delta_time = 0.1;
+        reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
+        sender_config.context = &context;
+        sender_config.id = 0;
+        sender_config.transmit_packet_function = &test_transmit_packet_function;
+        sender_config.process_packet_function = &test_process_packet_function;
 
-    int i;
-    for ( i = 0; i < 16; ++i )
-    {
+        reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
+        receiver_config.context = &context;
+        receiver_config.id = 1;
+        receiver_config.ack_window_bits = ack_window_bits;
+        receiver_config.ack_encoding = ( pass < 4 ) ? RELIABLE_ACK_ENCODING_BITFIELD : RELIABLE_ACK_ENCODING_RANGES;
+        receiver_config.transmit_packet_function = &test_transmit_packet_function;
+        receiver_config.process_packet_function = &test_process_packet_function;
+
+        context.sender = reliable_endpoint_create( &sender_config, time );
+        context.receiver = reliable_endpoint_create( &receiver_config, time );
+
+        RELIABLE_CONST uint64_t * sender_counters = reliable_endpoint_counters( context.sender );
+
+        uint64_t expected_acks = ack_window_bits < 100 ? ack_window_bits : 100;
+
+        // the receiver gets 100 packets before it sends anything back, so only the packets inside its ack window are acked
+
+        int i;
+        for ( i = 0; i < 100; ++i )
         {
-            uint8_t packet_data[TEST_MAX_PACKET_BYTES];
-            uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
-            int packet_bytes = generate_packet_data( sequence, packet_data );
-            reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+            reliable_endpoint_send_packet( context.sender, packet_data, 8 );
         }
 
+        reliable_endpoint_send_packet( context.receiver, packet_data, 8 );
+
+        check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED] == expected_acks );
+
+        reliable_endpoint_clear_acks( context.sender );
+
+        // the ack window is carried in the first fragment of fragmented packets too
+
+        for ( i = 0; i < 100; ++i )
         {
-            uint8_t packet_data[TEST_MAX_PACKET_BYTES];
-            uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
-            int packet_bytes = generate_packet_data( sequence, packet_data );
-            reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+            reliable_endpoint_send_packet( context.sender, packet_data, 8 );
         }
 
-        reliable_endpoint_update( context.sender, time );
-        reliable_endpoint_update( context.receiver, time );
+        reliable_endpoint_send_packet( context.receiver, packet_data, sizeof( packet_data ) );
+
+        check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED] == expected_acks * 2 );
 
         reliable_endpoint_clear_acks( context.sender );
-        reliable_endpoint_clear_acks( context.receiver );
 
-        time += delta_time;
-    }
+        // the packet builder reserves room for the header of the receiver's window, not the widest header
 
-    reliable_endpoint_destroy( context.sender );
-    reliable_endpoint_destroy( context.receiver );
+        for ( i = 0; i < 100; ++i )
+        {
+            reliable_endpoint_send_packet( context.sender, packet_data, 8 );
+        }
+
+        uint8_t * builder_data = reliable_endpoint_begin_packet( context.receiver, 8 );
+        check( builder_data );
+        check( builder_data - context.receiver->transmit_packet_data == RELIABLE_MAX_PACKET_HEADER_BYTES_FOR_ACK_WINDOW( ack_window_bits ) );
+        memset( builder_data, 0, 8 );
+        reliable_endpoint_commit_packet( context.receiver, 8 );
+
+        check( sender_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_ACKED] == expected_acks * 3 );
+
+        reliable_endpoint_destroy( context.sender );
+        reliable_endpoint_destroy( context.receiver );
+    }
 }
 
-void test_large_packets()
+void test_fragment_pacing_send_order()
 {
     double time = 100.0;
 
-    struct test_context_t context;
-    test_default_context( &context );
+    struct test_capture_context_t capture;
+    memset( &capture, 0, sizeof( capture ) );
 
-    struct reliable_config_t sender_config;
-    struct reliable_config_t receiver_config;
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    reliable_copy_string( config.name, "sender", sizeof( config.name ) );
+    config.context = &capture;
+    config.fragment_pacing_kbps = 1000.0f;
+    config.transmit_packet_function = &test_transmit_packet_function_capture;
+    config.process_packet_function = &test_process_packet_function;
 
-    reliable_default_config( &sender_config );
-    reliable_default_config( &receiver_config );
+    struct reliable_endpoint_t * endpoint = reliable_endpoint_create( &config, time );
 
-    sender_config.max_packet_size = TEST_MAX_PACKET_BYTES;
-    receiver_config.max_packet_size = TEST_MAX_PACKET_BYTES;
+    // regular packets before a paced fragmented packet in the same call must reach the wire first
 
-    sender_config.fragment_above = TEST_MAX_PACKET_BYTES;
-    receiver_config.fragment_above = TEST_MAX_PACKET_BYTES;
+    uint8_t small_packet[100];
+    uint8_t large_packet[4*1024];
+    memset( small_packet, 0, sizeof( small_packet ) );
+    memset( large_packet, 0, sizeof( large_packet ) );
 
-    reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
-    sender_config.context = &context;
-    sender_config.id = 0;
-    sender_config.transmit_packet_function = &test_transmit_packet_function;
-    sender_config.process_packet_function = &test_process_packet_function_validate_large;
+    uint8_t * packet_data[] = { small_packet, small_packet, large_packet, small_packet };
+    int packet_bytes[] = { sizeof( small_packet ), sizeof( small_packet ), sizeof( large_packet ), sizeof( small_packet ) };
 
-    reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
-    receiver_config.context = &context;
-    receiver_config.id = 1;
-    receiver_config.transmit_packet_function = &test_transmit_packet_function;
-    receiver_config.process_packet_function = &test_process_packet_function_validate_large;
+    reliable_endpoint_send_packets( endpoint, packet_data, packet_bytes, 4 );
 
-    context.sender = reliable_endpoint_create( &sender_config, time );
-    context.receiver = reliable_endpoint_create( &receiver_config, time );
+    check( capture.num_datagrams == 4 );
 
+    int i;
+    for ( i = 0; i < capture.num_datagrams; ++i )
     {
-        uint8_t packet_data[TEST_MAX_PACKET_BYTES];
-        int packet_bytes = generate_packet_data_large( packet_data );
-        check( packet_bytes == TEST_MAX_PACKET_BYTES );
-        reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+        struct reliable_datagram_info_t info;
+        check( reliable_peek_datagram( capture.datagram_data[i], capture.datagram_bytes[i], &info ) );
+        check( info.sequence == i );
+        check( info.type == ( i == 2 ? RELIABLE_DATAGRAM_FRAGMENT : RELIABLE_DATAGRAM_PACKET ) );
+        free( capture.datagram_data[i] );
     }
 
-    reliable_endpoint_update( context.sender, time );
-    reliable_endpoint_update( context.receiver, time );
+    reliable_endpoint_destroy( endpoint );
+}
 
-    reliable_endpoint_clear_acks( context.sender );
-    reliable_endpoint_clear_acks( context.receiver );
+void test_packets_receive_batch_stale()
+{
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    reliable_copy_string( config.name, "receiver", sizeof( config.name ) );
+    config.transmit_packet_function = &test_transmit_packet_function;
+    config.process_packet_function = &test_process_packet_function;
 
-    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
-    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_TOO_LARGE_TO_RECEIVE] == 0 );
-    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 1 );
+    struct reliable_endpoint_t * endpoint = reliable_endpoint_create( &config, 100.0 );
 
-    reliable_endpoint_destroy( context.sender );
-    reliable_endpoint_destroy( context.receiver );
+    // a batch with a recent packet followed by one that is too old once the recent packet is recorded
+
+    uint16_t sequences[] = { 10, 1000, 20 };
+
+    uint8_t packet_data[3][64];
+    int packet_bytes[3];
+    uint8_t * packets[3];
+
+    int i;
+    for ( i = 0; i < 3; ++i )
+    {
+        packet_bytes[i] = reliable_write_packet_header( packet_data[i], sequences[i], 0, 0 );
+        memset( packet_data[i] + packet_bytes[i], 0, 16 );
+        packet_bytes[i] += 16;
+        packets[i] = packet_data[i];
+    }
+
+    reliable_endpoint_receive_packet( endpoint, packets[0], packet_bytes[0] );
+    reliable_endpoint_receive_packets( endpoint, packets + 1, packet_bytes + 1, 2 );
+
+    RELIABLE_CONST uint64_t * counters = reliable_endpoint_counters( endpoint );
+    check( counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == 3 );
+    check( counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_STALE] == 1 );
+
+    uint16_t ack;
+    uint64_t ack_bits[RELIABLE_ACK_WINDOW_WORDS];
+    reliable_endpoint_generate_ack_bits( endpoint, &ack, ack_bits );
+    check( ack == 1000 );
+    check( ack_bits[0] == 1 );
+
+    reliable_endpoint_destroy( endpoint );
 }
 
-void test_sequence_buffer_rollover()
+void test_packets_deferred_batch()
 {
-    double time = 100.0;
+    struct test_capture_context_t capture;
+    memset( &capture, 0, sizeof( capture ) );
 
-    struct test_context_t context;
-    test_default_context( &context );
-    
     struct reliable_config_t sender_config;
     struct reliable_config_t receiver_config;
 
     reliable_default_config( &sender_config );
     reliable_default_config( &receiver_config );
 
-    sender_config.fragment_above = 500;
-    receiver_config.fragment_above = 500;
-
     reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
-    sender_config.context = &context;
-    sender_config.id = 0;
-    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.context = &capture;
+    sender_config.transmit_packet_function = &test_transmit_packet_function_capture;
     sender_config.process_packet_function = &test_process_packet_function;
 
     reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
-    receiver_config.context = &context;
-    receiver_config.id = 1;
     receiver_config.transmit_packet_function = &test_transmit_packet_function;
-    receiver_config.process_packet_function = &test_process_packet_function;
-
-    context.sender = reliable_endpoint_create( &sender_config, time );
-    context.receiver = reliable_endpoint_create( &receiver_config, time );
+    receiver_config.process_packet_function = &test_process_packet_function_defer;
 
-    int num_packets_sent = 0;
-    int i;
-    for (i = 0; i <= 32767; ++i)
-    {
-        uint8_t packet_data[16];
-        int packet_bytes = sizeof( packet_data ) / sizeof( uint8_t );
-        reliable_endpoint_next_packet_sequence( context.sender );
-        reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
+    struct reliable_endpoint_t * sender = reliable_endpoint_create( &sender_config, 100.0 );
+    struct reliable_endpoint_t * receiver = reliable_endpoint_create( &receiver_config, 100.0 );
 
-        ++num_packets_sent;
-    }
+    test_num_deferred_packets = 0;
 
     uint8_t packet_data[TEST_MAX_PACKET_BYTES];
-    int packet_bytes = sizeof( packet_data ) / sizeof( uint8_t );
-    reliable_endpoint_next_packet_sequence( context.sender );
-    reliable_endpoint_send_packet( context.sender, packet_data, packet_bytes );
-    ++num_packets_sent;
+    uint16_t sequence = reliable_endpoint_next_packet_sequence( sender );
+    int packet_bytes = generate_packet_data( sequence, packet_data );
+    reliable_endpoint_send_packet( sender, packet_data, packet_bytes );
 
-    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( context.receiver );
+    check( capture.num_datagrams == 1 );
 
-    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_RECEIVED] == (uint16_t) num_packets_sent );
-    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID] == 0 );
+    // two copies of one packet in a batch are both passed to the application, but the packet is only deferred once
 
-    reliable_endpoint_destroy( context.sender );
-    reliable_endpoint_destroy( context.receiver );
-}
+    capture.datagram_data[1] = capture.datagram_data[0];
+    capture.datagram_bytes[1] = capture.datagram_bytes[0];
 
-#define ARRAY_LENGTH(x) (sizeof(x) / sizeof((x)[0]))
+    reliable_endpoint_receive_packets( receiver, capture.datagram_data, capture.datagram_bytes, 2 );
 
-struct test_tracking_allocate_context_t
-{
-    void* active_allocations[1024];
-};
+    RELIABLE_CONST uint64_t * receiver_counters = reliable_endpoint_counters( receiver );
 
-void * test_tracking_allocate_function( void * context, size_t bytes )
-{
-    struct test_tracking_allocate_context_t* tracking_context = (struct test_tracking_allocate_context_t*)context;
-    void * allocation = malloc( bytes );
-    int tracking_index;
-    for ( tracking_index = 0; tracking_index < (int) ARRAY_LENGTH(tracking_context->active_allocations); ++tracking_index )
-    {
-        if ( tracking_context->active_allocations[tracking_index] == NULL )
-        {
-            break;
-        }
-    }
+    check( test_num_deferred_packets == 2 );
+    check( receiver_counters[RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_DEFERRED] == 1 );
 
-    reliable_assert(tracking_index < (int) ARRAY_LENGTH(tracking_context->active_allocations));
-    tracking_context->active_allocations[tracking_index] = allocation;
-    return allocation;
-}
+    reliable_endpoint_commit_received( receiver, sequence, 1 );
 
-void test_tracking_free_function( void * context, void * pointer )
-{
-    struct test_tracking_allocate_context_t* tracking_context = (struct test_tracking_allocate_context_t*)context;
-    int tracking_index;
-    for ( tracking_index = 0; tracking_index < (int) ARRAY_LENGTH(tracking_context->active_allocations); ++tracking_index )
-    {
-        if ( tracking_context->active_allocations[tracking_index] == pointer )
-        {
-            break;
-        }
-    }
+    check( reliable_sequence_buffer_exists( receiver->received_packets, sequence ) );
+    check( !reliable_sequence_buffer_exists( receiver->deferred_packets, sequence ) );
 
-    reliable_assert( tracking_index < (int) ARRAY_LENGTH(tracking_context->active_allocations) );
-    tracking_context->active_allocations[tracking_index] = NULL;
-    free( pointer );
+    free( capture.datagram_data[0] );
+
+    reliable_endpoint_destroy( sender );
+    reliable_endpoint_destroy( receiver );
 }
 
-void test_fragment_cleanup()
+#define TEST_RECEIVE_ORDER_MAX_PACKETS 8
+
+static int test_num_received_in_order;
+static uint16_t test_received_order[TEST_RECEIVE_ORDER_MAX_PACKETS];
+
+static int test_process_packet_function_order( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
 {
-    double time = 100.0;
+    (void) context;
+    (void) id;
+    (void) packet_data;
+    (void) packet_bytes;
+    check( test_num_received_in_order < TEST_RECEIVE_ORDER_MAX_PACKETS );
+    test_received_order[test_num_received_in_order++] = sequence;
+    return 1;
+}
 
-    struct test_context_t context;
-    test_default_context( &context );
+void test_packets_receive_batch_order()
+{
+    struct test_capture_context_t capture;
+    memset( &capture, 0, sizeof( capture ) );
 
-    struct test_tracking_allocate_context_t tracking_alloc_context;
-    memset( &tracking_alloc_context, 0, sizeof( tracking_alloc_context ) );
-    
     struct reliable_config_t sender_config;
     struct reliable_config_t receiver_config;
 
     reliable_default_config( &sender_config );
     reliable_default_config( &receiver_config );
 
-    receiver_config.allocator_context = &tracking_alloc_context;
-    receiver_config.allocate_function = &test_tracking_allocate_function;
-    receiver_config.free_function = &test_tracking_free_function;
-    receiver_config.fragment_reassembly_buffer_size = 4;
-
     reliable_copy_string( sender_config.name, "sender", sizeof( sender_config.name ) );
-    sender_config.context = &context;
-    sender_config.id = 0;
-    sender_config.transmit_packet_function = &test_transmit_packet_function;
+    sender_config.context = &capture;
+    sender_config.transmit_packet_function = &test_transmit_packet_function_capture;
     sender_config.process_packet_function = &test_process_packet_function;
 
     reliable_copy_string( receiver_config.name, "receiver", sizeof( receiver_config.name ) );
-    receiver_config.context = &context;
-    receiver_config.id = 1;
     receiver_config.transmit_packet_function = &test_transmit_packet_function;
-    receiver_config.process_packet_function = &test_process_packet_function;
+    receiver_config.process_packet_function = &test_process_packet_function_order;
 
-    context.sender = reliable_endpoint_create( &sender_config, time );
-    context.receiver = reliable_endpoint_create( &receiver_config, time );
+    struct reliable_endpoint_t * sender = reliable_endpoint_create( &sender_config, 100.0 );
+    struct reliable_endpoint_t * receiver = reliable_endpoint_create( &receiver_config, 100.0 );
 
-    double delta_time = 0.1;
+    // regular packets around a fragmented packet, all received in one batch, are processed in the order they arrived
 
-    int packet_sizes[] = {
-        sender_config.fragment_size + sender_config.fragment_size/2,
-        10,
-        10,
-        10,
-        10,
-    };
+    uint8_t small_packet[100];
+    uint8_t large_packet[4*1024];
+    memset( small_packet, 0, sizeof( small_packet ) );
+    memset( large_packet, 0, sizeof( large_packet ) );
 
-    // Make sure we're sending more than receiver_config.fragment_reassembly_buffer_size packets, so the buffer wraps around.
-    reliable_assert( (int) ARRAY_LENGTH( packet_sizes ) > receiver_config.fragment_reassembly_buffer_size );
+    reliable_endpoint_send_packet( sender, small_packet, sizeof( small_packet ) );
+    reliable_endpoint_send_packet( sender, small_packet, sizeof( small_packet ) );
+    reliable_endpoint_send_packet( sender, large_packet, sizeof( large_packet ) );
+    reliable_endpoint_send_packet( sender, small_packet, sizeof( small_packet ) );
 
-    int i;
-    for ( i = 0; i < (int) ARRAY_LENGTH( packet_sizes ); ++i )
-    {
-        // Only allow one packet per transmit, so that our fragmented packets are only partially
-        // delivered.
-        context.allow_packets = 1;
-        {
-            uint8_t packet_data[TEST_MAX_PACKET_BYTES];
-            uint16_t sequence = reliable_endpoint_next_packet_sequence( context.sender );
-            generate_packet_data_with_size( sequence, packet_data, packet_sizes[i] );
-            reliable_endpoint_send_packet( context.sender, packet_data, packet_sizes[i]);
-        }
+    check( capture.num_datagrams == 7 );
 
-        reliable_endpoint_update( context.sender, time );
-        reliable_endpoint_update( context.receiver, time );
+    test_num_received_in_order = 0;
 
-        reliable_endpoint_clear_acks( context.sender );
-        reliable_endpoint_clear_acks( context.receiver );
+    test_deliver_captured_datagrams( &capture, receiver, 1 );
 
-        time += delta_time;
-    }
+    check( test_num_received_in_order == 4 );
 
-    reliable_endpoint_destroy( context.sender );
-    reliable_endpoint_destroy( context.receiver );
-    
-    // Make sure that there is no memory that hasn't been freed.
-    int tracking_index;
-    for ( tracking_index = 0; tracking_index < (int) ARRAY_LENGTH(tracking_alloc_context.active_allocations); ++tracking_index )
+    int i;
+    for ( i = 0; i < test_num_received_in_order; ++i )
     {
-        check( tracking_alloc_context.active_allocations[tracking_index] == NULL );
+        check( test_received_order[i] == (uint16_t) i );
     }
+
+    reliable_endpoint_destroy( sender );
+    reliable_endpoint_destroy( receiver );
 }
 
 #define RUN_TEST( test_function )                                           \
@@ -2394,6 +7057,35 @@ void reliable_test()
         RUN_TEST( test_large_packets );
         RUN_TEST( test_sequence_buffer_rollover );
         RUN_TEST( test_fragment_cleanup );
+        RUN_TEST( test_packets_headroom );
+        RUN_TEST( test_packets_iov );
+        RUN_TEST( test_packets_batch );
+        RUN_TEST( test_packets_gso );
+        RUN_TEST( test_packets_builder );
+        RUN_TEST( test_received_bits_reset );
+        RUN_TEST( test_fragment_pacing );
+        RUN_TEST( test_fragment_retained );
+        RUN_TEST( test_packets_receive_batch );
+        RUN_TEST( test_packets_deferred );
+        RUN_TEST( test_peek_datagram );
+        RUN_TEST( test_fragment_pool );
+        RUN_TEST( test_fragment_bitmap );
+        RUN_TEST( test_fragment_reassembly_timeout );
+        RUN_TEST( test_packets_duplicate );
+        RUN_TEST( test_acks_incremental );
+        RUN_TEST( test_acks_function );
+        RUN_TEST( test_sequence_buffer_index );
+        RUN_TEST( test_sequence_buffer_interleaved );
+        RUN_TEST( test_sequence_buffer_remove_entries );
+        RUN_TEST( test_received_bits );
+        RUN_TEST( test_packet_header_window );
+        RUN_TEST( test_ack_window );
+        RUN_TEST( test_packet_header_ranges );
+        RUN_TEST( test_packets_gso_many_fragments );
+        RUN_TEST( test_fragment_pacing_send_order );
+        RUN_TEST( test_packets_receive_batch_stale );
+        RUN_TEST( test_packets_deferred_batch );
+        RUN_TEST( test_packets_receive_batch_order );
     }
 }
 
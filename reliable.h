@@ -65,11 +65,27 @@
 #define RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_SENT                        7
 #define RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_RECEIVED                    8
 #define RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_INVALID                     9
-#define RELIABLE_ENDPOINT_NUM_COUNTERS                                      10
+#define RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_QUEUED                      10
+#define RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_DEFERRED                      11
+#define RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTS_REASSEMBLY_FULL             12
+#define RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENTED_PACKETS_EXPIRED            13
+#define RELIABLE_ENDPOINT_COUNTER_NUM_FRAGMENT_BYTES_EXPIRED                14
+#define RELIABLE_ENDPOINT_COUNTER_NUM_PACKETS_DUPLICATE                     15
+#define RELIABLE_ENDPOINT_COUNTER_NUM_ACKS_OVERFLOW                         16
+#define RELIABLE_ENDPOINT_NUM_COUNTERS                                      17
 
 #define RELIABLE_MAX_PACKET_HEADER_BYTES 9
+#define RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES 41
+#define RELIABLE_MAX_PACKET_HEADER_BYTES_FOR_ACK_WINDOW( ack_window_bits ) ( (ack_window_bits) <= 32 ? RELIABLE_MAX_PACKET_HEADER_BYTES : 5 + ( (ack_window_bits) / 64 ) * 9 )
 #define RELIABLE_FRAGMENT_HEADER_BYTES 5
 
+#define RELIABLE_MAX_BATCH_DATAGRAMS 64
+
+#define RELIABLE_MAX_GSO_SEGMENTS 64
+#define RELIABLE_MAX_GSO_BYTES 65507
+
+#define RELIABLE_MAX_ACK_WINDOW_BITS 256
+
 #define RELIABLE_LOG_LEVEL_NONE     0
 #define RELIABLE_LOG_LEVEL_ERROR    1
 #define RELIABLE_LOG_LEVEL_INFO     2
@@ -78,6 +94,18 @@
 #define RELIABLE_OK         1
 #define RELIABLE_ERROR      0
 
+#define RELIABLE_PACKET_RETAINED 2
+#define RELIABLE_PACKET_DEFERRED 3
+
+#define RELIABLE_DATAGRAM_PACKET    0
+#define RELIABLE_DATAGRAM_FRAGMENT  1
+
+#define RELIABLE_SEQUENCE_BUFFER_LAYOUT_SEPARATE        0
+#define RELIABLE_SEQUENCE_BUFFER_LAYOUT_INTERLEAVED     1
+
+#define RELIABLE_ACK_ENCODING_BITFIELD                  0
+#define RELIABLE_ACK_ENCODING_RANGES                    1
+
 #ifdef __cplusplus
 #define RELIABLE_CONST const
 extern "C" {
@@ -93,6 +121,26 @@ int reliable_init(void);
 
 void reliable_term(void);
 
+struct reliable_iovec_t
+{
+    uint8_t * data;
+    int bytes;
+};
+
+struct reliable_datagram_info_t
+{
+    int type;
+    uint16_t sequence;
+    int has_ack;
+    uint16_t ack;
+    uint32_t ack_bits;
+    int ack_window_bits;
+    uint64_t ack_window[RELIABLE_MAX_ACK_WINDOW_BITS/64];
+    int fragment_id;
+    int num_fragments;
+    int header_bytes;
+};
+
 struct reliable_config_t
 {
     char name[256];
@@ -115,6 +163,23 @@ struct reliable_config_t
     void * allocator_context;
     void * (*allocate_function)(void*,size_t);
     void (*free_function)(void*,void*);
+    void (*transmit_packet_iov_function)(void*,uint64_t,uint16_t,struct reliable_iovec_t*,int);
+    void (*transmit_packets_function)(void*,uint64_t,uint16_t*,struct reliable_iovec_t*,int);
+    void (*transmit_packet_gso_function)(void*,uint64_t,uint16_t,uint8_t*,int,int);
+    float fragment_pacing_kbps;
+    int fragment_pacing_bytes_per_rtt;
+    int fragment_pacing_queue_size;
+    int (*process_reassembled_packet_function)(void*,uint64_t,uint16_t,uint8_t*,int);
+    void (*process_packets_function)(void*,uint64_t,uint16_t*,uint8_t**,int*,int*,int);
+    int fragment_reassembly_max_bytes;
+    int fragment_reassembly_pool_size;
+    float fragment_reassembly_timeout;
+    int drop_duplicate_packets;
+    void (*ack_function)(void*,uint64_t,uint16_t,double,float);
+    int sent_packets_buffer_layout;
+    int received_packets_buffer_layout;
+    int ack_window_bits;
+    int ack_encoding;
 };
 
 void reliable_default_config( struct reliable_config_t * config );
@@ -125,8 +190,20 @@ uint16_t reliable_endpoint_next_packet_sequence( struct reliable_endpoint_t * en
 
 void reliable_endpoint_send_packet( struct reliable_endpoint_t * endpoint, uint8_t * packet_data, int packet_bytes );
 
+void reliable_endpoint_send_packet_with_headroom( struct reliable_endpoint_t * endpoint, uint8_t * packet_data, int packet_bytes );
+
+void reliable_endpoint_send_packets( struct reliable_endpoint_t * endpoint, uint8_t ** packet_data, int * packet_bytes, int num_packets );
+
+uint8_t * reliable_endpoint_begin_packet( struct reliable_endpoint_t * endpoint, int max_bytes );
+
+void reliable_endpoint_commit_packet( struct reliable_endpoint_t * endpoint, int packet_bytes );
+
 void reliable_endpoint_receive_packet( struct reliable_endpoint_t * endpoint, uint8_t * packet_data, int packet_bytes );
 
+void reliable_endpoint_receive_packets( struct reliable_endpoint_t * endpoint, uint8_t ** packet_data, int * packet_bytes, int num_packets );
+
+void reliable_endpoint_commit_received( struct reliable_endpoint_t * endpoint, uint16_t sequence, int ok );
+
 void reliable_endpoint_free_packet( struct reliable_endpoint_t * endpoint, void * packet );
 
 uint16_t * reliable_endpoint_get_acks( struct reliable_endpoint_t * endpoint, int * num_acks );
@@ -145,8 +222,12 @@ void reliable_endpoint_bandwidth( struct reliable_endpoint_t * endpoint, float *
 
 RELIABLE_CONST uint64_t * reliable_endpoint_counters( struct reliable_endpoint_t * endpoint );
 
+int reliable_endpoint_num_queued_fragments( struct reliable_endpoint_t * endpoint );
+
 void reliable_endpoint_destroy( struct reliable_endpoint_t * endpoint );
 
+int reliable_peek_datagram( uint8_t * packet_data, int packet_bytes, struct reliable_datagram_info_t * info );
+
 void reliable_log_level( int level );
 
 void reliable_set_printf_function( int (*function)( RELIABLE_CONST char *, ... ) );
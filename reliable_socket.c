@@ -0,0 +1,1058 @@
+/*
+    reliable
+
+    Copyright © 2017 - 2024, Mas Bandwidth LLC
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer 
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived 
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif // #ifndef _GNU_SOURCE
+
+#include "reliable_socket.h"
+
+#if !defined( __linux__ )
+#error reliable_socket requires linux (sendmmsg and recvmmsg)
+#endif // #if !defined( __linux__ )
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifndef RELIABLE_SOCKET_ENABLE_IO_URING
+#define RELIABLE_SOCKET_ENABLE_IO_URING 1
+#endif // #ifndef RELIABLE_SOCKET_ENABLE_IO_URING
+
+#if RELIABLE_SOCKET_ENABLE_IO_URING
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif // #if RELIABLE_SOCKET_ENABLE_IO_URING
+
+void reliable_printf( int level, RELIABLE_CONST char * format, ... );
+
+void * reliable_default_allocate_function( void * context, size_t bytes );
+
+void reliable_default_free_function( void * context, void * pointer );
+
+struct reliable_socket_endpoint_t
+{
+    struct reliable_endpoint_t * endpoint;
+    uint32_t address;
+    uint16_t port;
+};
+
+#if RELIABLE_SOCKET_ENABLE_IO_URING
+
+struct reliable_socket_uring_t
+{
+    int fd;
+    void * sq_ring;
+    size_t sq_ring_bytes;
+    void * cq_ring;
+    size_t cq_ring_bytes;
+    struct io_uring_sqe * sqes;
+    size_t sqes_bytes;
+    uint32_t * sq_head;
+    uint32_t * sq_tail;
+    uint32_t * sq_array;
+    uint32_t sq_mask;
+    uint32_t sq_local_tail;
+    uint32_t * cq_head;
+    uint32_t * cq_tail;
+    uint32_t cq_mask;
+    struct io_uring_cqe * cqes;
+};
+
+#endif // #if RELIABLE_SOCKET_ENABLE_IO_URING
+
+struct reliable_socket_t
+{
+    struct reliable_socket_config_t config;
+    int handle;
+    uint16_t port;
+    struct reliable_socket_endpoint_t * endpoints;
+    int address_table_size;
+    int * address_table;
+    int num_queued_datagrams;
+    uint8_t * send_data;
+    struct mmsghdr * send_messages;
+    struct iovec * send_iov;
+    struct sockaddr_in * send_addresses;
+    uint8_t * receive_data;
+    struct mmsghdr * receive_messages;
+    struct iovec * receive_iov;
+    struct sockaddr_in * receive_addresses;
+#if RELIABLE_SOCKET_ENABLE_IO_URING
+    struct reliable_socket_uring_t send_ring;
+    struct reliable_socket_uring_t receive_ring;
+    struct io_uring_buf_ring * receive_buffer_ring;
+    size_t receive_buffer_ring_bytes;
+    uint8_t * receive_buffer_data;
+    int receive_buffer_bytes;
+    int num_receive_buffers;
+    uint16_t receive_buffer_tail;
+    int receive_armed;
+    struct msghdr receive_message;
+#endif // #if RELIABLE_SOCKET_ENABLE_IO_URING
+    uint64_t counters[RELIABLE_SOCKET_NUM_COUNTERS];
+};
+
+void reliable_socket_default_config( struct reliable_socket_config_t * config )
+{
+    reliable_assert( config );
+    memset( config, 0, sizeof( struct reliable_socket_config_t ) );
+    config->address = 0;
+    config->port = 0;
+    config->backend = RELIABLE_SOCKET_BACKEND_MMSG;
+    config->max_endpoints = 256;
+    config->max_datagram_bytes = 1500;
+    config->send_queue_size = 256;
+    config->receive_ring_size = 256;
+    config->send_buffer_size = 4 * 1024 * 1024;
+    config->receive_buffer_size = 4 * 1024 * 1024;
+}
+
+static uint32_t reliable_socket_address_hash( uint32_t address, uint16_t port )
+{
+    uint64_t key = ( ( (uint64_t) address ) << 16 ) | port;
+    key *= 0x9E3779B97F4A7C15ULL;
+    return (uint32_t) ( key >> 32 );
+}
+
+static void reliable_socket_build_address_table( struct reliable_socket_t * socket )
+{
+    int i;
+    for ( i = 0; i < socket->address_table_size; ++i )
+    {
+        socket->address_table[i] = -1;
+    }
+
+    for ( i = 0; i < socket->config.max_endpoints; ++i )
+    {
+        struct reliable_socket_endpoint_t * entry = socket->endpoints + i;
+        if ( !entry->endpoint )
+            continue;
+        int index = (int) ( reliable_socket_address_hash( entry->address, entry->port ) & ( socket->address_table_size - 1 ) );
+        while ( socket->address_table[index] != -1 )
+        {
+            index = ( index + 1 ) & ( socket->address_table_size - 1 );
+        }
+        socket->address_table[index] = i;
+    }
+}
+
+static int reliable_socket_find_endpoint( struct reliable_socket_t * socket, uint32_t address, uint16_t port )
+{
+    int index = (int) ( reliable_socket_address_hash( address, port ) & ( socket->address_table_size - 1 ) );
+    while ( 1 )
+    {
+        int endpoint_index = socket->address_table[index];
+        if ( endpoint_index == -1 )
+            return -1;
+        struct reliable_socket_endpoint_t * entry = socket->endpoints + endpoint_index;
+        if ( entry->address == address && entry->port == port )
+            return endpoint_index;
+        index = ( index + 1 ) & ( socket->address_table_size - 1 );
+    }
+}
+
+#if RELIABLE_SOCKET_ENABLE_IO_URING
+
+// io_uring is driven through raw syscalls, so there is no dependency on liburing
+
+static int reliable_socket_uring_create( struct reliable_socket_uring_t * ring, int entries )
+{
+    memset( ring, 0, sizeof( struct reliable_socket_uring_t ) );
+
+    struct io_uring_params params;
+    memset( &params, 0, sizeof( params ) );
+
+    ring->fd = (int) syscall( __NR_io_uring_setup, entries, &params );
+    if ( ring->fd < 0 )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "io_uring_setup failed (%s)\n", strerror( errno ) );
+        return RELIABLE_ERROR;
+    }
+
+    ring->sq_ring_bytes = params.sq_off.array + params.sq_entries * sizeof( uint32_t );
+    ring->cq_ring_bytes = params.cq_off.cqes + params.cq_entries * sizeof( struct io_uring_cqe );
+    ring->sqes_bytes = params.sq_entries * sizeof( struct io_uring_sqe );
+
+    if ( params.features & IORING_FEAT_SINGLE_MMAP )
+    {
+        if ( ring->cq_ring_bytes > ring->sq_ring_bytes )
+            ring->sq_ring_bytes = ring->cq_ring_bytes;
+        ring->cq_ring_bytes = 0;
+    }
+
+    ring->sq_ring = mmap( NULL, ring->sq_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING );
+    ring->cq_ring = ring->cq_ring_bytes ? mmap( NULL, ring->cq_ring_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING ) : ring->sq_ring;
+    ring->sqes = (struct io_uring_sqe*) mmap( NULL, ring->sqes_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES );
+
+    if ( ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED || ring->sqes == MAP_FAILED )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "failed to map io_uring (%s)\n", strerror( errno ) );
+        if ( ring->sq_ring != MAP_FAILED )
+            munmap( ring->sq_ring, ring->sq_ring_bytes );
+        if ( ring->cq_ring_bytes && ring->cq_ring != MAP_FAILED )
+            munmap( ring->cq_ring, ring->cq_ring_bytes );
+        if ( ring->sqes != MAP_FAILED )
+            munmap( ring->sqes, ring->sqes_bytes );
+        close( ring->fd );
+        memset( ring, 0, sizeof( struct reliable_socket_uring_t ) );
+        return RELIABLE_ERROR;
+    }
+
+    uint8_t * sq_ring = (uint8_t*) ring->sq_ring;
+    uint8_t * cq_ring = (uint8_t*) ring->cq_ring;
+
+    ring->sq_head = (uint32_t*) ( sq_ring + params.sq_off.head );
+    ring->sq_tail = (uint32_t*) ( sq_ring + params.sq_off.tail );
+    ring->sq_array = (uint32_t*) ( sq_ring + params.sq_off.array );
+    ring->sq_mask = *(uint32_t*) ( sq_ring + params.sq_off.ring_mask );
+    ring->sq_local_tail = *ring->sq_tail;
+    ring->cq_head = (uint32_t*) ( cq_ring + params.cq_off.head );
+    ring->cq_tail = (uint32_t*) ( cq_ring + params.cq_off.tail );
+    ring->cq_mask = *(uint32_t*) ( cq_ring + params.cq_off.ring_mask );
+    ring->cqes = (struct io_uring_cqe*) ( cq_ring + params.cq_off.cqes );
+
+    return RELIABLE_OK;
+}
+
+static void reliable_socket_uring_destroy( struct reliable_socket_uring_t * ring )
+{
+    if ( ring->sq_ring == NULL )
+        return;
+    munmap( ring->sqes, ring->sqes_bytes );
+    if ( ring->cq_ring_bytes )
+        munmap( ring->cq_ring, ring->cq_ring_bytes );
+    munmap( ring->sq_ring, ring->sq_ring_bytes );
+    close( ring->fd );
+    memset( ring, 0, sizeof( struct reliable_socket_uring_t ) );
+}
+
+static struct io_uring_sqe * reliable_socket_uring_get_sqe( struct reliable_socket_uring_t * ring )
+{
+    uint32_t head = __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE );
+    if ( ring->sq_local_tail - head > ring->sq_mask )
+        return NULL;
+    uint32_t index = ring->sq_local_tail & ring->sq_mask;
+    struct io_uring_sqe * sqe = ring->sqes + index;
+    memset( sqe, 0, sizeof( struct io_uring_sqe ) );
+    ring->sq_array[index] = index;
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+static int reliable_socket_uring_enter( struct reliable_socket_uring_t * ring, int min_complete )
+{
+    __atomic_store_n( ring->sq_tail, ring->sq_local_tail, __ATOMIC_RELEASE );
+    uint32_t to_submit = ring->sq_local_tail - __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE );
+    return (int) syscall( __NR_io_uring_enter, ring->fd, to_submit, min_complete, IORING_ENTER_GETEVENTS, NULL, 0 );
+}
+
+static int reliable_socket_uring_has_pending_submissions( struct reliable_socket_uring_t * ring )
+{
+    return ring->sq_local_tail != __atomic_load_n( ring->sq_head, __ATOMIC_ACQUIRE );
+}
+
+static struct io_uring_cqe * reliable_socket_uring_peek_cqe( struct reliable_socket_uring_t * ring )
+{
+    uint32_t head = *ring->cq_head;
+    if ( head == __atomic_load_n( ring->cq_tail, __ATOMIC_ACQUIRE ) )
+        return NULL;
+    return ring->cqes + ( head & ring->cq_mask );
+}
+
+static void reliable_socket_uring_cqe_seen( struct reliable_socket_uring_t * ring )
+{
+    __atomic_store_n( ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE );
+}
+
+static void reliable_socket_recycle_receive_buffer( struct reliable_socket_t * socket, uint16_t buffer_id )
+{
+    struct io_uring_buf * buffer = &socket->receive_buffer_ring->bufs[socket->receive_buffer_tail & ( socket->num_receive_buffers - 1 )];
+    buffer->addr = (uint64_t) (uintptr_t) ( socket->receive_buffer_data + buffer_id * socket->receive_buffer_bytes );
+    buffer->len = socket->receive_buffer_bytes;
+    buffer->bid = buffer_id;
+    socket->receive_buffer_tail++;
+}
+
+static void reliable_socket_publish_receive_buffers( struct reliable_socket_t * socket )
+{
+    __atomic_store_n( &socket->receive_buffer_ring->tail, socket->receive_buffer_tail, __ATOMIC_RELEASE );
+}
+
+static void reliable_socket_destroy_io_uring( struct reliable_socket_t * socket )
+{
+    reliable_socket_uring_destroy( &socket->send_ring );
+    reliable_socket_uring_destroy( &socket->receive_ring );
+
+    if ( socket->receive_buffer_ring )
+    {
+        munmap( socket->receive_buffer_ring, socket->receive_buffer_ring_bytes );
+        socket->receive_buffer_ring = NULL;
+    }
+
+    if ( socket->receive_buffer_data )
+    {
+        socket->config.free_function( socket->config.allocator_context, socket->receive_buffer_data );
+        socket->receive_buffer_data = NULL;
+    }
+}
+
+static int reliable_socket_create_io_uring( struct reliable_socket_t * socket )
+{
+    // each provided receive buffer holds the recvmsg header, the source address and a datagram of up to max_datagram_bytes.
+    // buffer sizes are rounded up to 8 bytes, so the header and address at the start of each buffer stay aligned
+
+    socket->num_receive_buffers = 1;
+    while ( socket->num_receive_buffers < socket->config.receive_ring_size && socket->num_receive_buffers < 32768 )
+    {
+        socket->num_receive_buffers *= 2;
+    }
+
+    socket->receive_buffer_bytes = ( (int) ( sizeof( struct io_uring_recvmsg_out ) + sizeof( struct sockaddr_in ) ) + socket->config.max_datagram_bytes + 7 ) & ~7;
+
+    if ( reliable_socket_uring_create( &socket->send_ring, socket->config.send_queue_size ) != RELIABLE_OK ||
+         reliable_socket_uring_create( &socket->receive_ring, socket->num_receive_buffers ) != RELIABLE_OK )
+    {
+        reliable_socket_destroy_io_uring( socket );
+        return RELIABLE_ERROR;
+    }
+
+    socket->receive_buffer_ring_bytes = socket->num_receive_buffers * sizeof( struct io_uring_buf );
+    void * buffer_ring = mmap( NULL, socket->receive_buffer_ring_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+    if ( buffer_ring == MAP_FAILED )
+    {
+        reliable_socket_destroy_io_uring( socket );
+        return RELIABLE_ERROR;
+    }
+
+    socket->receive_buffer_ring = (struct io_uring_buf_ring*) buffer_ring;
+
+    struct io_uring_buf_reg buffer_registration;
+    memset( &buffer_registration, 0, sizeof( buffer_registration ) );
+    buffer_registration.ring_addr = (uint64_t) (uintptr_t) buffer_ring;
+    buffer_registration.ring_entries = socket->num_receive_buffers;
+    buffer_registration.bgid = 0;
+
+    if ( syscall( __NR_io_uring_register, socket->receive_ring.fd, IORING_REGISTER_PBUF_RING, &buffer_registration, 1 ) < 0 )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "failed to register io_uring receive buffers (%s)\n", strerror( errno ) );
+        reliable_socket_destroy_io_uring( socket );
+        return RELIABLE_ERROR;
+    }
+
+    socket->receive_buffer_data = (uint8_t*) socket->config.allocate_function( socket->config.allocator_context, socket->num_receive_buffers * socket->receive_buffer_bytes );
+
+    reliable_assert( socket->receive_buffer_data );
+
+    int i;
+    for ( i = 0; i < socket->num_receive_buffers; ++i )
+    {
+        reliable_socket_recycle_receive_buffer( socket, (uint16_t) i );
+    }
+
+    reliable_socket_publish_receive_buffers( socket );
+
+    memset( &socket->receive_message, 0, sizeof( socket->receive_message ) );
+    socket->receive_message.msg_namelen = sizeof( struct sockaddr_in );
+
+    return RELIABLE_OK;
+}
+
+static void reliable_socket_arm_receive( struct reliable_socket_t * socket )
+{
+    // one multishot recvmsg keeps posting a completion per datagram until it runs out of provided buffers
+
+    struct io_uring_sqe * sqe = reliable_socket_uring_get_sqe( &socket->receive_ring );
+    if ( !sqe )
+        return;
+
+    sqe->opcode = IORING_OP_RECVMSG;
+    sqe->fd = socket->handle;
+    sqe->addr = (uint64_t) (uintptr_t) &socket->receive_message;
+    sqe->len = 1;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = 0;
+
+    socket->receive_armed = 1;
+}
+
+#endif // #if RELIABLE_SOCKET_ENABLE_IO_URING
+
+struct reliable_socket_t * reliable_socket_create( struct reliable_socket_config_t * config )
+{
+    reliable_assert( config );
+    reliable_assert( config->max_endpoints > 0 );
+    reliable_assert( config->max_datagram_bytes > 0 );
+    reliable_assert( config->send_queue_size > 0 );
+    reliable_assert( config->receive_ring_size > 0 );
+
+    void * allocator_context = config->allocator_context;
+    void * (*allocate_function)(void*,size_t) = config->allocate_function;
+    void (*free_function)(void*,void*) = config->free_function;
+
+    if ( allocate_function == NULL )
+    {
+        allocate_function = reliable_default_allocate_function;
+    }
+
+    if ( free_function == NULL )
+    {
+        free_function = reliable_default_free_function;
+    }
+
+    int handle = socket( AF_INET, SOCK_DGRAM, IPPROTO_UDP );
+    if ( handle < 0 )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "error: failed to create socket (%s)\n", strerror( errno ) );
+        return NULL;
+    }
+
+    if ( config->send_buffer_size > 0 )
+    {
+        setsockopt( handle, SOL_SOCKET, SO_SNDBUF, &config->send_buffer_size, sizeof( int ) );
+    }
+
+    if ( config->receive_buffer_size > 0 )
+    {
+        setsockopt( handle, SOL_SOCKET, SO_RCVBUF, &config->receive_buffer_size, sizeof( int ) );
+    }
+
+    struct sockaddr_in bind_address;
+    memset( &bind_address, 0, sizeof( bind_address ) );
+    bind_address.sin_family = AF_INET;
+    bind_address.sin_addr.s_addr = htonl( config->address );
+    bind_address.sin_port = htons( config->port );
+
+    if ( bind( handle, (struct sockaddr*) &bind_address, sizeof( bind_address ) ) < 0 )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "error: failed to bind socket (%s)\n", strerror( errno ) );
+        close( handle );
+        return NULL;
+    }
+
+    socklen_t bind_address_length = sizeof( bind_address );
+    if ( getsockname( handle, (struct sockaddr*) &bind_address, &bind_address_length ) < 0 )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "error: failed to get socket port (%s)\n", strerror( errno ) );
+        close( handle );
+        return NULL;
+    }
+
+    if ( fcntl( handle, F_SETFL, O_NONBLOCK ) < 0 )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "error: failed to make socket non-blocking (%s)\n", strerror( errno ) );
+        close( handle );
+        return NULL;
+    }
+
+    struct reliable_socket_t * socket = (struct reliable_socket_t*) allocate_function( allocator_context, sizeof( struct reliable_socket_t ) );
+
+    reliable_assert( socket );
+
+    memset( socket, 0, sizeof( struct reliable_socket_t ) );
+
+    socket->config = *config;
+    socket->config.allocate_function = allocate_function;
+    socket->config.free_function = free_function;
+    socket->handle = handle;
+    socket->port = ntohs( bind_address.sin_port );
+
+    socket->address_table_size = 1;
+    while ( socket->address_table_size < config->max_endpoints * 2 )
+    {
+        socket->address_table_size *= 2;
+    }
+
+    socket->endpoints = (struct reliable_socket_endpoint_t*) allocate_function( allocator_context, config->max_endpoints * sizeof( struct reliable_socket_endpoint_t ) );
+    socket->address_table = (int*) allocate_function( allocator_context, socket->address_table_size * sizeof( int ) );
+
+    socket->send_data = (uint8_t*) allocate_function( allocator_context, config->send_queue_size * config->max_datagram_bytes );
+    socket->send_messages = (struct mmsghdr*) allocate_function( allocator_context, config->send_queue_size * sizeof( struct mmsghdr ) );
+    socket->send_iov = (struct iovec*) allocate_function( allocator_context, config->send_queue_size * sizeof( struct iovec ) );
+    socket->send_addresses = (struct sockaddr_in*) allocate_function( allocator_context, config->send_queue_size * sizeof( struct sockaddr_in ) );
+
+    socket->receive_data = (uint8_t*) allocate_function( allocator_context, config->receive_ring_size * config->max_datagram_bytes );
+    socket->receive_messages = (struct mmsghdr*) allocate_function( allocator_context, config->receive_ring_size * sizeof( struct mmsghdr ) );
+    socket->receive_iov = (struct iovec*) allocate_function( allocator_context, config->receive_ring_size * sizeof( struct iovec ) );
+    socket->receive_addresses = (struct sockaddr_in*) allocate_function( allocator_context, config->receive_ring_size * sizeof( struct sockaddr_in ) );
+
+    reliable_assert( socket->endpoints );
+    reliable_assert( socket->address_table );
+    reliable_assert( socket->send_data );
+    reliable_assert( socket->send_messages );
+    reliable_assert( socket->send_iov );
+    reliable_assert( socket->send_addresses );
+    reliable_assert( socket->receive_data );
+    reliable_assert( socket->receive_messages );
+    reliable_assert( socket->receive_iov );
+    reliable_assert( socket->receive_addresses );
+
+    memset( socket->endpoints, 0, config->max_endpoints * sizeof( struct reliable_socket_endpoint_t ) );
+    memset( socket->send_messages, 0, config->send_queue_size * sizeof( struct mmsghdr ) );
+    memset( socket->send_addresses, 0, config->send_queue_size * sizeof( struct sockaddr_in ) );
+    memset( socket->receive_messages, 0, config->receive_ring_size * sizeof( struct mmsghdr ) );
+
+    int i;
+    for ( i = 0; i < config->send_queue_size; ++i )
+    {
+        socket->send_iov[i].iov_base = socket->send_data + i * config->max_datagram_bytes;
+        socket->send_iov[i].iov_len = 0;
+        socket->send_messages[i].msg_hdr.msg_name = socket->send_addresses + i;
+        socket->send_messages[i].msg_hdr.msg_namelen = sizeof( struct sockaddr_in );
+        socket->send_messages[i].msg_hdr.msg_iov = socket->send_iov + i;
+        socket->send_messages[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    reliable_socket_build_address_table( socket );
+
+    if ( socket->config.backend == RELIABLE_SOCKET_BACKEND_IO_URING )
+    {
+#if RELIABLE_SOCKET_ENABLE_IO_URING
+        if ( reliable_socket_create_io_uring( socket ) != RELIABLE_OK )
+#endif // #if RELIABLE_SOCKET_ENABLE_IO_URING
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_INFO, "io_uring is not available. falling back to sendmmsg/recvmmsg\n" );
+            socket->config.backend = RELIABLE_SOCKET_BACKEND_MMSG;
+        }
+    }
+
+    return socket;
+}
+
+void reliable_socket_destroy( struct reliable_socket_t * socket )
+{
+    reliable_assert( socket );
+
+#if RELIABLE_SOCKET_ENABLE_IO_URING
+    reliable_socket_destroy_io_uring( socket );
+#endif // #if RELIABLE_SOCKET_ENABLE_IO_URING
+
+    close( socket->handle );
+
+    void * allocator_context = socket->config.allocator_context;
+    void (*free_function)(void*,void*) = socket->config.free_function;
+
+    free_function( allocator_context, socket->endpoints );
+    free_function( allocator_context, socket->address_table );
+    free_function( allocator_context, socket->send_data );
+    free_function( allocator_context, socket->send_messages );
+    free_function( allocator_context, socket->send_iov );
+    free_function( allocator_context, socket->send_addresses );
+    free_function( allocator_context, socket->receive_data );
+    free_function( allocator_context, socket->receive_messages );
+    free_function( allocator_context, socket->receive_iov );
+    free_function( allocator_context, socket->receive_addresses );
+    free_function( allocator_context, socket );
+}
+
+uint16_t reliable_socket_port( struct reliable_socket_t * socket )
+{
+    reliable_assert( socket );
+    return socket->port;
+}
+
+int reliable_socket_backend( struct reliable_socket_t * socket )
+{
+    reliable_assert( socket );
+    return socket->config.backend;
+}
+
+int reliable_socket_add_endpoint( struct reliable_socket_t * socket, uint64_t id, struct reliable_endpoint_t * endpoint, uint32_t address, uint16_t port )
+{
+    reliable_assert( socket );
+    reliable_assert( endpoint );
+
+    if ( id >= (uint64_t) socket->config.max_endpoints )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "error: endpoint id %" PRIu64 " is out of range. max endpoints is %d\n", id, socket->config.max_endpoints );
+        return RELIABLE_ERROR;
+    }
+
+    if ( reliable_socket_find_endpoint( socket, address, port ) != -1 )
+    {
+        reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "error: address is already used by another endpoint\n" );
+        return RELIABLE_ERROR;
+    }
+
+    struct reliable_socket_endpoint_t * entry = socket->endpoints + id;
+    entry->endpoint = endpoint;
+    entry->address = address;
+    entry->port = port;
+
+    reliable_socket_build_address_table( socket );
+
+    return RELIABLE_OK;
+}
+
+void reliable_socket_remove_endpoint( struct reliable_socket_t * socket, uint64_t id )
+{
+    reliable_assert( socket );
+    reliable_assert( id < (uint64_t) socket->config.max_endpoints );
+    memset( socket->endpoints + id, 0, sizeof( struct reliable_socket_endpoint_t ) );
+    reliable_socket_build_address_table( socket );
+}
+
+static uint8_t * reliable_socket_queue_datagram( struct reliable_socket_t * socket, uint64_t id, int packet_bytes )
+{
+    if ( id >= (uint64_t) socket->config.max_endpoints || socket->endpoints[id].endpoint == NULL )
+    {
+        socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_DROPPED]++;
+        return NULL;
+    }
+
+    if ( packet_bytes > socket->config.max_datagram_bytes )
+    {
+        socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_TOO_LARGE]++;
+        return NULL;
+    }
+
+    if ( socket->num_queued_datagrams == socket->config.send_queue_size )
+    {
+        reliable_socket_send_packets( socket );
+    }
+
+    int index = socket->num_queued_datagrams++;
+
+    struct reliable_socket_endpoint_t * entry = socket->endpoints + id;
+    struct sockaddr_in * address = socket->send_addresses + index;
+    address->sin_family = AF_INET;
+    address->sin_addr.s_addr = htonl( entry->address );
+    address->sin_port = htons( entry->port );
+
+    socket->send_iov[index].iov_len = packet_bytes;
+
+    return (uint8_t*) socket->send_iov[index].iov_base;
+}
+
+void reliable_socket_transmit_packet( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) sequence;
+
+    struct reliable_socket_t * socket = (struct reliable_socket_t*) context;
+
+    reliable_assert( socket );
+
+    uint8_t * datagram = reliable_socket_queue_datagram( socket, id, packet_bytes );
+    if ( datagram )
+    {
+        memcpy( datagram, packet_data, packet_bytes );
+    }
+}
+
+void reliable_socket_transmit_packets( void * context, uint64_t id, uint16_t * sequences, struct reliable_iovec_t * iov, int num_datagrams )
+{
+    (void) sequences;
+
+    struct reliable_socket_t * socket = (struct reliable_socket_t*) context;
+
+    reliable_assert( socket );
+
+    int i;
+    for ( i = 0; i < num_datagrams; ++i )
+    {
+        struct reliable_iovec_t * datagram_iov = iov + i*2;
+        uint8_t * datagram = reliable_socket_queue_datagram( socket, id, datagram_iov[0].bytes + datagram_iov[1].bytes );
+        if ( datagram )
+        {
+            memcpy( datagram, datagram_iov[0].data, datagram_iov[0].bytes );
+            memcpy( datagram + datagram_iov[0].bytes, datagram_iov[1].data, datagram_iov[1].bytes );
+        }
+    }
+}
+
+static void reliable_socket_send_packets_basic( struct reliable_socket_t * socket )
+{
+    int i;
+    for ( i = 0; i < socket->num_queued_datagrams; ++i )
+    {
+        int result = (int) sendto( socket->handle, socket->send_iov[i].iov_base, socket->send_iov[i].iov_len, 0, (struct sockaddr*) ( socket->send_addresses + i ), sizeof( struct sockaddr_in ) );
+
+        socket->counters[RELIABLE_SOCKET_COUNTER_NUM_SEND_SYSCALLS]++;
+
+        if ( result < 0 )
+        {
+            if ( errno == EINTR )
+            {
+                i--;
+                continue;
+            }
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "sendto failed (%s)\n", strerror( errno ) );
+            socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_DROPPED]++;
+            continue;
+        }
+
+        socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_SENT]++;
+    }
+}
+
+static void reliable_socket_send_packets_mmsg( struct reliable_socket_t * socket )
+{
+    int num_sent = 0;
+
+    while ( num_sent < socket->num_queued_datagrams )
+    {
+        int result = sendmmsg( socket->handle, socket->send_messages + num_sent, socket->num_queued_datagrams - num_sent, 0 );
+
+        socket->counters[RELIABLE_SOCKET_COUNTER_NUM_SEND_SYSCALLS]++;
+
+        if ( result < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+
+            // the socket send buffer is full or the datagram could not be sent. skip it, this is UDP
+
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "sendmmsg failed (%s)\n", strerror( errno ) );
+            socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_DROPPED]++;
+            num_sent++;
+            continue;
+        }
+
+        socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_SENT] += result;
+        num_sent += result;
+    }
+}
+
+#if RELIABLE_SOCKET_ENABLE_IO_URING
+
+static void reliable_socket_send_packets_io_uring( struct reliable_socket_t * socket )
+{
+    // submit one sendmsg per queued datagram and wait for all of them to complete in a single io_uring_enter.
+    // MSG_DONTWAIT makes a full socket send buffer fail the datagram instead of parking it, same as sendmmsg.
+
+    int num_datagrams = socket->num_queued_datagrams;
+
+    int i;
+    for ( i = 0; i < num_datagrams; ++i )
+    {
+        struct io_uring_sqe * sqe = reliable_socket_uring_get_sqe( &socket->send_ring );
+
+        reliable_assert( sqe );
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = socket->handle;
+        sqe->addr = (uint64_t) (uintptr_t) &socket->send_messages[i].msg_hdr;
+        sqe->len = 1;
+        sqe->msg_flags = MSG_DONTWAIT;
+        sqe->user_data = i;
+    }
+
+    int num_completed = 0;
+
+    while ( num_completed < num_datagrams )
+    {
+        struct io_uring_cqe * cqe = reliable_socket_uring_peek_cqe( &socket->send_ring );
+
+        if ( !cqe )
+        {
+            int result = reliable_socket_uring_enter( &socket->send_ring, num_datagrams - num_completed );
+
+            socket->counters[RELIABLE_SOCKET_COUNTER_NUM_SEND_SYSCALLS]++;
+
+            if ( result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY )
+            {
+                // sends already submitted may still complete and point at the send slots. tear the send ring down
+                // so later flushes can't reuse those slots or count their completions, and send with sendmmsg instead
+
+                reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "error: io_uring_enter failed (%s). falling back to sendmmsg\n", strerror( errno ) );
+                socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_DROPPED] += num_datagrams - num_completed;
+                reliable_socket_uring_destroy( &socket->send_ring );
+                break;
+            }
+
+            continue;
+        }
+
+        if ( cqe->res < 0 )
+        {
+            reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "io_uring sendmsg failed (%s)\n", strerror( -cqe->res ) );
+            socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_DROPPED]++;
+        }
+        else
+        {
+            socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_SENT]++;
+        }
+
+        reliable_socket_uring_cqe_seen( &socket->send_ring );
+
+        num_completed++;
+    }
+}
+
+#endif // #if RELIABLE_SOCKET_ENABLE_IO_URING
+
+void reliable_socket_send_packets( struct reliable_socket_t * socket )
+{
+    reliable_assert( socket );
+
+    switch ( socket->config.backend )
+    {
+        case RELIABLE_SOCKET_BACKEND_BASIC:
+            reliable_socket_send_packets_basic( socket );
+            break;
+
+#if RELIABLE_SOCKET_ENABLE_IO_URING
+        case RELIABLE_SOCKET_BACKEND_IO_URING:
+            if ( socket->send_ring.sq_ring )
+                reliable_socket_send_packets_io_uring( socket );
+            else
+                reliable_socket_send_packets_mmsg( socket );
+            break;
+#endif // #if RELIABLE_SOCKET_ENABLE_IO_URING
+
+        default:
+            reliable_socket_send_packets_mmsg( socket );
+            break;
+    }
+
+    socket->num_queued_datagrams = 0;
+}
+
+static int reliable_socket_dispatch_datagram( struct reliable_socket_t * socket, struct sockaddr_in * address, uint8_t * datagram_data, int datagram_bytes )
+{
+    int endpoint_index = reliable_socket_find_endpoint( socket, ntohl( address->sin_addr.s_addr ), ntohs( address->sin_port ) );
+    if ( endpoint_index < 0 )
+    {
+        socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_UNKNOWN_ADDRESS]++;
+        return 0;
+    }
+
+    reliable_endpoint_receive_packet( socket->endpoints[endpoint_index].endpoint, datagram_data, datagram_bytes );
+
+    return 1;
+}
+
+static int reliable_socket_receive_packets_basic( struct reliable_socket_t * socket )
+{
+    int num_received = 0;
+
+    while ( 1 )
+    {
+        socklen_t address_length = sizeof( struct sockaddr_in );
+
+        int result = (int) recvfrom( socket->handle, socket->receive_data, socket->config.max_datagram_bytes, MSG_DONTWAIT | MSG_TRUNC, (struct sockaddr*) socket->receive_addresses, &address_length );
+
+        socket->counters[RELIABLE_SOCKET_COUNTER_NUM_RECEIVE_SYSCALLS]++;
+
+        if ( result < 0 )
+        {
+            if ( errno == EINTR )
+                continue;
+            break;
+        }
+
+        socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_RECEIVED]++;
+
+        if ( result > socket->config.max_datagram_bytes )
+        {
+            socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_TOO_LARGE]++;
+            continue;
+        }
+
+        num_received += reliable_socket_dispatch_datagram( socket, socket->receive_addresses, socket->receive_data, result );
+    }
+
+    return num_received;
+}
+
+static int reliable_socket_receive_packets_mmsg( struct reliable_socket_t * socket )
+{
+    int num_received = 0;
+
+    while ( 1 )
+    {
+        int i;
+        for ( i = 0; i < socket->config.receive_ring_size; ++i )
+        {
+            socket->receive_iov[i].iov_base = socket->receive_data + i * socket->config.max_datagram_bytes;
+            socket->receive_iov[i].iov_len = socket->config.max_datagram_bytes;
+            socket->receive_messages[i].msg_hdr.msg_name = socket->receive_addresses + i;
+            socket->receive_messages[i].msg_hdr.msg_namelen = sizeof( struct sockaddr_in );
+            socket->receive_messages[i].msg_hdr.msg_iov = socket->receive_iov + i;
+            socket->receive_messages[i].msg_hdr.msg_iovlen = 1;
+            socket->receive_messages[i].msg_hdr.msg_flags = 0;
+        }
+
+        int result = recvmmsg( socket->handle, socket->receive_messages, socket->config.receive_ring_size, MSG_DONTWAIT, NULL );
+
+        socket->counters[RELIABLE_SOCKET_COUNTER_NUM_RECEIVE_SYSCALLS]++;
+
+        if ( result <= 0 )
+        {
+            if ( result < 0 && errno == EINTR )
+                continue;
+            break;
+        }
+
+        socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_RECEIVED] += result;
+
+        for ( i = 0; i < result; ++i )
+        {
+            struct mmsghdr * message = socket->receive_messages + i;
+
+            if ( message->msg_hdr.msg_flags & MSG_TRUNC )
+            {
+                socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_TOO_LARGE]++;
+                continue;
+            }
+
+            num_received += reliable_socket_dispatch_datagram( socket, socket->receive_addresses + i, (uint8_t*) socket->receive_iov[i].iov_base, (int) message->msg_len );
+        }
+
+        if ( result < socket->config.receive_ring_size )
+            break;
+    }
+
+    return num_received;
+}
+
+#if RELIABLE_SOCKET_ENABLE_IO_URING
+
+static int reliable_socket_receive_packets_io_uring( struct reliable_socket_t * socket )
+{
+    // completions for the multishot recvmsg are posted as task work, so one io_uring_enter both re-arms the receive
+    // if needed and flushes every datagram that arrived since the last call into the completion queue.
+    // the multishot terminates when it runs out of provided buffers, so keep re-arming until the socket is drained.
+
+    int num_received = 0;
+
+    while ( 1 )
+    {
+        if ( !socket->receive_armed )
+        {
+            reliable_socket_arm_receive( socket );
+        }
+
+        if ( reliable_socket_uring_has_pending_submissions( &socket->receive_ring ) || reliable_socket_uring_peek_cqe( &socket->receive_ring ) == NULL )
+        {
+            int result = reliable_socket_uring_enter( &socket->receive_ring, 0 );
+
+            socket->counters[RELIABLE_SOCKET_COUNTER_NUM_RECEIVE_SYSCALLS]++;
+
+            if ( result < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY )
+            {
+                reliable_printf( RELIABLE_LOG_LEVEL_ERROR, "error: io_uring_enter failed (%s)\n", strerror( errno ) );
+                break;
+            }
+        }
+
+        int num_completions = 0;
+
+        struct io_uring_cqe * cqe;
+
+        while ( ( cqe = reliable_socket_uring_peek_cqe( &socket->receive_ring ) ) != NULL )
+        {
+            int result = cqe->res;
+            uint32_t flags = cqe->flags;
+
+            reliable_socket_uring_cqe_seen( &socket->receive_ring );
+
+            num_completions++;
+
+            if ( !( flags & IORING_CQE_F_MORE ) )
+            {
+                socket->receive_armed = 0;
+            }
+
+            if ( result < 0 )
+            {
+                if ( result == -ENOBUFS )
+                {
+                    socket->counters[RELIABLE_SOCKET_COUNTER_NUM_RECEIVE_BUFFERS_EXHAUSTED]++;
+                }
+                else
+                {
+                    reliable_printf( RELIABLE_LOG_LEVEL_DEBUG, "io_uring recvmsg failed (%s)\n", strerror( -result ) );
+                }
+                continue;
+            }
+
+            if ( !( flags & IORING_CQE_F_BUFFER ) )
+                continue;
+
+            uint16_t buffer_id = (uint16_t) ( flags >> IORING_CQE_BUFFER_SHIFT );
+
+            uint8_t * buffer = socket->receive_buffer_data + buffer_id * socket->receive_buffer_bytes;
+
+            struct io_uring_recvmsg_out * message = (struct io_uring_recvmsg_out*) buffer;
+
+            socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_RECEIVED]++;
+
+            if ( message->flags & MSG_TRUNC )
+            {
+                socket->counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_TOO_LARGE]++;
+            }
+            else
+            {
+                struct sockaddr_in * address = (struct sockaddr_in*) ( buffer + sizeof( struct io_uring_recvmsg_out ) );
+                uint8_t * datagram_data = buffer + sizeof( struct io_uring_recvmsg_out ) + sizeof( struct sockaddr_in );
+                num_received += reliable_socket_dispatch_datagram( socket, address, datagram_data, (int) message->payloadlen );
+            }
+
+            reliable_socket_recycle_receive_buffer( socket, buffer_id );
+        }
+
+        reliable_socket_publish_receive_buffers( socket );
+
+        if ( socket->receive_armed || num_completions == 0 )
+            break;
+    }
+
+    return num_received;
+}
+
+#endif // #if RELIABLE_SOCKET_ENABLE_IO_URING
+
+int reliable_socket_receive_packets( struct reliable_socket_t * socket )
+{
+    reliable_assert( socket );
+
+    switch ( socket->config.backend )
+    {
+        case RELIABLE_SOCKET_BACKEND_BASIC:
+            return reliable_socket_receive_packets_basic( socket );
+
+#if RELIABLE_SOCKET_ENABLE_IO_URING
+        case RELIABLE_SOCKET_BACKEND_IO_URING:
+            return reliable_socket_receive_packets_io_uring( socket );
+#endif // #if RELIABLE_SOCKET_ENABLE_IO_URING
+
+        default:
+            return reliable_socket_receive_packets_mmsg( socket );
+    }
+}
+
+RELIABLE_CONST uint64_t * reliable_socket_counters( struct reliable_socket_t * socket )
+{
+    reliable_assert( socket );
+    return socket->counters;
+}
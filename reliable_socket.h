@@ -0,0 +1,92 @@
+/*
+    reliable
+
+    Copyright © 2017 - 2024, Mas Bandwidth LLC
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer 
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived 
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef RELIABLE_SOCKET_H
+#define RELIABLE_SOCKET_H
+
+#include "reliable.h"
+
+#define RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_SENT                          0
+#define RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_RECEIVED                      1
+#define RELIABLE_SOCKET_COUNTER_NUM_SEND_SYSCALLS                           2
+#define RELIABLE_SOCKET_COUNTER_NUM_RECEIVE_SYSCALLS                        3
+#define RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_DROPPED                       4
+#define RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_TOO_LARGE                     5
+#define RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_UNKNOWN_ADDRESS               6
+#define RELIABLE_SOCKET_COUNTER_NUM_RECEIVE_BUFFERS_EXHAUSTED               7
+#define RELIABLE_SOCKET_NUM_COUNTERS                                        8
+
+#define RELIABLE_SOCKET_BACKEND_BASIC                                       0
+#define RELIABLE_SOCKET_BACKEND_MMSG                                        1
+#define RELIABLE_SOCKET_BACKEND_IO_URING                                    2
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct reliable_socket_config_t
+{
+    uint32_t address;
+    uint16_t port;
+    int backend;
+    int max_endpoints;
+    int max_datagram_bytes;
+    int send_queue_size;
+    int receive_ring_size;
+    int send_buffer_size;
+    int receive_buffer_size;
+    void * allocator_context;
+    void * (*allocate_function)(void*,size_t);
+    void (*free_function)(void*,void*);
+};
+
+void reliable_socket_default_config( struct reliable_socket_config_t * config );
+
+struct reliable_socket_t * reliable_socket_create( struct reliable_socket_config_t * config );
+
+void reliable_socket_destroy( struct reliable_socket_t * socket );
+
+uint16_t reliable_socket_port( struct reliable_socket_t * socket );
+
+int reliable_socket_backend( struct reliable_socket_t * socket );
+
+int reliable_socket_add_endpoint( struct reliable_socket_t * socket, uint64_t id, struct reliable_endpoint_t * endpoint, uint32_t address, uint16_t port );
+
+void reliable_socket_remove_endpoint( struct reliable_socket_t * socket, uint64_t id );
+
+void reliable_socket_transmit_packet( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes );
+
+void reliable_socket_transmit_packets( void * context, uint64_t id, uint16_t * sequences, struct reliable_iovec_t * iov, int num_datagrams );
+
+void reliable_socket_send_packets( struct reliable_socket_t * socket );
+
+int reliable_socket_receive_packets( struct reliable_socket_t * socket );
+
+RELIABLE_CONST uint64_t * reliable_socket_counters( struct reliable_socket_t * socket );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // #ifndef RELIABLE_SOCKET_H
@@ -173,12 +173,16 @@ void soak_initialize()
     client_config.id = 0;
     client_config.transmit_packet_function = &test_transmit_packet_function;
     client_config.process_packet_function = &test_process_packet_function;
+    client_config.ack_window_bits = 128;
+    client_config.ack_encoding = RELIABLE_ACK_ENCODING_RANGES;
 
     reliable_copy_string( server_config.name, "server", sizeof( server_config.name ) );
     server_config.context = &global_context;
     server_config.id = 1;
     server_config.transmit_packet_function = &test_transmit_packet_function;
     server_config.process_packet_function = &test_process_packet_function;
+    server_config.ack_window_bits = 256;
+    server_config.fragment_reassembly_timeout = 1.0f;
 
     global_context.client = reliable_endpoint_create( &client_config, global_time );
     global_context.server = reliable_endpoint_create( &server_config, global_time );
@@ -0,0 +1,258 @@
+/*
+    reliable
+
+    Copyright © 2017 - 2024, Mas Bandwidth LLC
+
+    Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+
+        1. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+
+        2. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer 
+           in the documentation and/or other materials provided with the distribution.
+
+        3. Neither the name of the copyright holder nor the names of its contributors may be used to endorse or promote products derived 
+           from this software without specific prior written permission.
+
+    THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, 
+    INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE 
+    DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, 
+    SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR 
+    SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, 
+    WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+    USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "reliable.h"
+#include "reliable_socket.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <signal.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define NUM_CLIENTS 16
+#define PACKETS_PER_UPDATE 64
+#define PACKET_BYTES 100
+
+static volatile int quit = 0;
+
+void interrupt_handler( int signal )
+{
+    (void) signal;
+    quit = 1;
+}
+
+static double get_time()
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return ts.tv_sec + ( (double) ts.tv_nsec ) / 1000000000.0;
+}
+
+static int process_packet( void * context, uint64_t id, uint16_t sequence, uint8_t * packet_data, int packet_bytes )
+{
+    (void) context;
+    (void) id;
+    (void) sequence;
+    (void) packet_data;
+    (void) packet_bytes;
+    return 1;
+}
+
+static const char * backend_name[] = { "basic", "mmsg", "io_uring" };
+
+static int run_backend( int backend, double duration )
+{
+    const uint32_t loopback_address = 0x7F000001;
+
+    double time = 0.0;
+
+    struct reliable_config_t config;
+    reliable_default_config( &config );
+    config.max_packet_size = 1024;
+    config.transmit_packet_function = &reliable_socket_transmit_packet;
+    config.transmit_packets_function = &reliable_socket_transmit_packets;
+    config.process_packet_function = &process_packet;
+
+    // one server socket with an endpoint per client, and one socket per client.
+    // socket buffers are sized for the largest datagram an endpoint will accept
+
+    struct reliable_socket_config_t socket_config;
+    reliable_socket_default_config( &socket_config );
+    socket_config.address = loopback_address;
+    socket_config.backend = backend;
+    socket_config.max_endpoints = NUM_CLIENTS;
+    socket_config.max_datagram_bytes = config.max_packet_size + RELIABLE_MAX_WIDE_PACKET_HEADER_BYTES + RELIABLE_FRAGMENT_HEADER_BYTES;
+
+    struct reliable_socket_t * server_socket = reliable_socket_create( &socket_config );
+    if ( !server_socket )
+    {
+        printf( "error: could not create server socket\n" );
+        return 1;
+    }
+
+    if ( reliable_socket_backend( server_socket ) != backend )
+    {
+        printf( "%s backend is not available\n\n", backend_name[backend] );
+        reliable_socket_destroy( server_socket );
+        return 0;
+    }
+
+    socket_config.max_endpoints = 1;
+
+    struct reliable_socket_t * client_socket[NUM_CLIENTS];
+    struct reliable_endpoint_t * client_endpoint[NUM_CLIENTS];
+    struct reliable_endpoint_t * server_endpoint[NUM_CLIENTS];
+
+    int i;
+    for ( i = 0; i < NUM_CLIENTS; ++i )
+    {
+        client_socket[i] = reliable_socket_create( &socket_config );
+        if ( !client_socket[i] )
+        {
+            printf( "error: could not create client socket\n" );
+            return 1;
+        }
+
+        snprintf( config.name, sizeof( config.name ), "client %d", i );
+        config.context = client_socket[i];
+        config.id = 0;
+        client_endpoint[i] = reliable_endpoint_create( &config, time );
+        reliable_socket_add_endpoint( client_socket[i], 0, client_endpoint[i], loopback_address, reliable_socket_port( server_socket ) );
+
+        snprintf( config.name, sizeof( config.name ), "server %d", i );
+        config.context = server_socket;
+        config.id = i;
+        server_endpoint[i] = reliable_endpoint_create( &config, time );
+        reliable_socket_add_endpoint( server_socket, i, server_endpoint[i], loopback_address, reliable_socket_port( client_socket[i] ) );
+    }
+
+    uint8_t packet_data[PACKET_BYTES];
+    memset( packet_data, 0, sizeof( packet_data ) );
+
+    uint8_t * batch_packet_data[PACKETS_PER_UPDATE];
+    int batch_packet_bytes[PACKETS_PER_UPDATE];
+    for ( i = 0; i < PACKETS_PER_UPDATE; ++i )
+    {
+        batch_packet_data[i] = packet_data;
+        batch_packet_bytes[i] = PACKET_BYTES;
+    }
+
+    printf( "%s: sending %d byte packets from %d clients for %.1f seconds...\n\n", backend_name[backend], PACKET_BYTES, NUM_CLIENTS, duration );
+
+    double start_time = get_time();
+
+    while ( !quit && get_time() - start_time < duration )
+    {
+        // each client sends a burst of packets to the server, the server sends one packet back to each client
+
+        for ( i = 0; i < NUM_CLIENTS; ++i )
+        {
+            reliable_endpoint_send_packets( client_endpoint[i], batch_packet_data, batch_packet_bytes, PACKETS_PER_UPDATE );
+            reliable_socket_send_packets( client_socket[i] );
+        }
+
+        reliable_socket_receive_packets( server_socket );
+
+        for ( i = 0; i < NUM_CLIENTS; ++i )
+        {
+            reliable_endpoint_send_packet( server_endpoint[i], packet_data, PACKET_BYTES );
+        }
+
+        reliable_socket_send_packets( server_socket );
+
+        time += 0.01;
+
+        for ( i = 0; i < NUM_CLIENTS; ++i )
+        {
+            reliable_socket_receive_packets( client_socket[i] );
+            reliable_endpoint_update( client_endpoint[i], time );
+            reliable_endpoint_update( server_endpoint[i], time );
+            reliable_endpoint_clear_acks( client_endpoint[i] );
+            reliable_endpoint_clear_acks( server_endpoint[i] );
+        }
+    }
+
+    double elapsed_time = get_time() - start_time;
+
+    RELIABLE_CONST uint64_t * server_counters = reliable_socket_counters( server_socket );
+
+    uint64_t num_datagrams_sent = server_counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_SENT];
+    uint64_t num_datagrams_received = server_counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_RECEIVED];
+    uint64_t num_send_syscalls = server_counters[RELIABLE_SOCKET_COUNTER_NUM_SEND_SYSCALLS];
+    uint64_t num_receive_syscalls = server_counters[RELIABLE_SOCKET_COUNTER_NUM_RECEIVE_SYSCALLS];
+    uint64_t num_datagrams_dropped = server_counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_DROPPED];
+
+    for ( i = 0; i < NUM_CLIENTS; ++i )
+    {
+        RELIABLE_CONST uint64_t * client_counters = reliable_socket_counters( client_socket[i] );
+        num_datagrams_sent += client_counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_SENT];
+        num_datagrams_received += client_counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_RECEIVED];
+        num_send_syscalls += client_counters[RELIABLE_SOCKET_COUNTER_NUM_SEND_SYSCALLS];
+        num_receive_syscalls += client_counters[RELIABLE_SOCKET_COUNTER_NUM_RECEIVE_SYSCALLS];
+        num_datagrams_dropped += client_counters[RELIABLE_SOCKET_COUNTER_NUM_DATAGRAMS_DROPPED];
+    }
+
+    printf( "datagrams sent:      %" PRIu64 " (%.0f per second, %.1f per syscall)\n", 
+        num_datagrams_sent, num_datagrams_sent / elapsed_time, num_send_syscalls ? ( (double) num_datagrams_sent ) / num_send_syscalls : 0.0 );
+    printf( "datagrams received:  %" PRIu64 " (%.0f per second, %.1f per syscall)\n", 
+        num_datagrams_received, num_datagrams_received / elapsed_time, num_receive_syscalls ? ( (double) num_datagrams_received ) / num_receive_syscalls : 0.0 );
+    printf( "datagrams dropped:   %" PRIu64 "\n", num_datagrams_dropped );
+    printf( "server rtt:          %.2fms\n", reliable_endpoint_rtt( server_endpoint[0] ) );
+    printf( "server packet loss:  %.2f%%\n\n", reliable_endpoint_packet_loss( server_endpoint[0] ) );
+
+    for ( i = 0; i < NUM_CLIENTS; ++i )
+    {
+        reliable_endpoint_destroy( client_endpoint[i] );
+        reliable_endpoint_destroy( server_endpoint[i] );
+        reliable_socket_destroy( client_socket[i] );
+    }
+
+    reliable_socket_destroy( server_socket );
+
+    return 0;
+}
+
+int main( int argc, char ** argv )
+{
+    double duration = 5.0;
+
+    if ( argc >= 2 )
+        duration = atof( argv[1] );
+
+    int first_backend = RELIABLE_SOCKET_BACKEND_BASIC;
+    int last_backend = RELIABLE_SOCKET_BACKEND_IO_URING;
+
+    if ( argc >= 3 )
+    {
+        int backend;
+        for ( backend = RELIABLE_SOCKET_BACKEND_BASIC; backend <= RELIABLE_SOCKET_BACKEND_IO_URING; ++backend )
+        {
+            if ( strcmp( argv[2], backend_name[backend] ) == 0 )
+            {
+                first_backend = backend;
+                last_backend = backend;
+            }
+        }
+    }
+
+    printf( "\n[socket]\n\n" );
+
+    reliable_init();
+
+    signal( SIGINT, interrupt_handler );
+
+    int result = 0;
+
+    int backend;
+    for ( backend = first_backend; backend <= last_backend && !quit && result == 0; ++backend )
+    {
+        result = run_backend( backend, duration );
+    }
+
+    reliable_term();
+
+    return result;
+}